@@ -133,7 +133,7 @@ static void
 get_user_information (AccountCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   GCancellable *cancellable;
 
   if (call->parent_handle == NULL)
@@ -142,8 +142,7 @@ get_user_information (AccountCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->request_path = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -189,6 +188,9 @@ get_user_information (AccountCall *call)
  *
  * Gets information about the user.
  *
+ * Requests without a parent window that are made while another one
+ * with the same @reason is in progress share its result.
+ *
  * When the request is done, @callback will be called. You can then
  * call xdp_portal_get_user_information_finish() to get the results.
  */
@@ -201,9 +203,27 @@ xdp_portal_get_user_information (XdpPortal *portal,
                                  gpointer data)
 {
   AccountCall *call = NULL;
+  GTask *task;
 
   g_return_if_fail (XDP_IS_PORTAL (portal));
 
+  task = g_task_new (portal, cancellable, callback, data);
+
+  if (parent == NULL)
+    {
+      g_autofree char *key = NULL;
+
+      key = g_strconcat ("account", reason ? ":" : NULL, reason, NULL);
+      task = _xdp_portal_join_flight (portal,
+                                      key,
+                                      task,
+                                      (GBoxedCopyFunc) g_variant_ref,
+                                      (GDestroyNotify) g_variant_unref,
+                                      NULL);
+      if (task == NULL)
+        return;
+    }
+
   call = g_new0 (AccountCall, 1);
   call->portal = g_object_ref (portal);
   if (parent)
@@ -211,7 +231,7 @@ xdp_portal_get_user_information (XdpPortal *portal,
   else
     call->parent_handle = g_strdup ("");
   call->reason = g_strdup (reason);
-  call->task = g_task_new (portal, cancellable, callback, data);
+  call->task = task;
 
   get_user_information (call);
 }
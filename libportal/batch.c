@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "portal-private.h"
+#include "utils-private.h"
+
+/**
+ * SECTION:batch
+ * @title: XdpBatch
+ * @short_description: run many portal operations together
+ *
+ * An XdpBatch collects independent portal operations, such as the
+ * calls an application makes at startup, starts them all at once and
+ * reports when the last one has finished. The total time is that of
+ * the slowest operation, instead of the sum of all of them.
+ *
+ * Operations are added with xdp_batch_add(), as a function that starts
+ * an asynchronous libportal call. The parent window of the batch is
+ * exported once and shared by all operations. Calls that do not wait
+ * for a reply, such as xdp_portal_add_notification(), can be added with
+ * xdp_batch_add_call(); the batch then also waits until they have been
+ * delivered.
+ *
+ * After the batch has finished, the result of each operation can be
+ * obtained with xdp_batch_get_result() and passed to the finish function
+ * of the call that the operation made.
+ */
+
+typedef struct {
+  XdpBatch *batch;
+  XdpBatchStartFunc start;
+  XdpBatchCallFunc call;
+  gpointer data;
+  GDestroyNotify destroy;
+  GAsyncResult *result;
+} BatchOperation;
+
+struct _XdpBatch {
+  GObject parent_instance;
+
+  XdpPortal *portal;
+  XdpParent *parent;
+  char *parent_handle;
+  GPtrArray *operations;
+  guint n_pending;
+  gboolean started;
+  GTask *task;
+};
+
+G_DEFINE_TYPE (XdpBatch, xdp_batch, G_TYPE_OBJECT)
+
+static void
+batch_operation_free (BatchOperation *op)
+{
+  if (op->destroy)
+    op->destroy (op->data);
+  g_clear_object (&op->result);
+  g_free (op);
+}
+
+static void
+xdp_batch_finalize (GObject *object)
+{
+  XdpBatch *batch = XDP_BATCH (object);
+
+  if (batch->parent)
+    {
+      if (batch->parent_handle)
+        batch->parent->unexport (batch->parent);
+      _xdp_parent_free (batch->parent);
+    }
+  g_free (batch->parent_handle);
+
+  g_ptr_array_unref (batch->operations);
+  g_object_unref (batch->portal);
+
+  G_OBJECT_CLASS (xdp_batch_parent_class)->finalize (object);
+}
+
+static void
+xdp_batch_class_init (XdpBatchClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = xdp_batch_finalize;
+}
+
+static void
+xdp_batch_init (XdpBatch *batch)
+{
+  batch->operations = g_ptr_array_new_with_free_func ((GDestroyNotify) batch_operation_free);
+}
+
+/**
+ * xdp_batch_new:
+ * @portal: a #XdpPortal
+ * @parent: (nullable): parent window information
+ *
+ * Creates a new #XdpBatch. The operations of the batch
+ * use @parent as their parent window.
+ *
+ * Returns: (transfer full): a newly created #XdpBatch
+ */
+XdpBatch *
+xdp_batch_new (XdpPortal *portal,
+               XdpParent *parent)
+{
+  XdpBatch *batch;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+
+  batch = g_object_new (XDP_TYPE_BATCH, NULL);
+  batch->portal = g_object_ref (portal);
+  if (parent)
+    batch->parent = _xdp_parent_copy (parent);
+
+  return batch;
+}
+
+static BatchOperation *
+batch_add (XdpBatch *batch)
+{
+  BatchOperation *op;
+
+  op = g_new0 (BatchOperation, 1);
+  op->batch = batch;
+  g_ptr_array_add (batch->operations, op);
+
+  return op;
+}
+
+/**
+ * xdp_batch_add:
+ * @batch: a #XdpBatch
+ * @start: (scope notified): function that starts the operation
+ * @data: (closure): data to pass to @start
+ * @destroy: (nullable): function to free @data
+ *
+ * Adds an operation to the batch. When the batch is run, @start
+ * is called with the portal, parent window and cancellable of the
+ * batch, and must start exactly one asynchronous call that reports
+ * to the given callback.
+ *
+ * Returns: the index of the operation, for xdp_batch_get_result()
+ */
+guint
+xdp_batch_add (XdpBatch          *batch,
+               XdpBatchStartFunc  start,
+               gpointer           data,
+               GDestroyNotify     destroy)
+{
+  BatchOperation *op;
+
+  g_return_val_if_fail (XDP_IS_BATCH (batch), 0);
+  g_return_val_if_fail (start != NULL, 0);
+  g_return_val_if_fail (!batch->started, 0);
+
+  op = batch_add (batch);
+  op->start = start;
+  op->data = data;
+  op->destroy = destroy;
+
+  return batch->operations->len - 1;
+}
+
+/**
+ * xdp_batch_add_call:
+ * @batch: a #XdpBatch
+ * @call: (scope notified): function that makes the call
+ * @data: (closure): data to pass to @call
+ * @destroy: (nullable): function to free @data
+ *
+ * Adds a call that does not wait for a reply to the batch, such as
+ * xdp_portal_remove_notification(). When the batch is run, @call is
+ * called with the portal of the batch. The batch finishes after the
+ * call has been delivered to the portal.
+ */
+void
+xdp_batch_add_call (XdpBatch         *batch,
+                    XdpBatchCallFunc  call,
+                    gpointer          data,
+                    GDestroyNotify    destroy)
+{
+  BatchOperation *op;
+
+  g_return_if_fail (XDP_IS_BATCH (batch));
+  g_return_if_fail (call != NULL);
+  g_return_if_fail (!batch->started);
+
+  op = batch_add (batch);
+  op->call = call;
+  op->data = data;
+  op->destroy = destroy;
+}
+
+static void
+batch_finish_operation (XdpBatch *batch)
+{
+  GTask *task;
+
+  if (--batch->n_pending > 0)
+    return;
+
+  task = g_steal_pointer (&batch->task);
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+static void
+operation_done (GObject *source,
+                GAsyncResult *result,
+                gpointer data)
+{
+  BatchOperation *op = data;
+
+  op->result = g_object_ref (result);
+  batch_finish_operation (op->batch);
+}
+
+static void
+flushed (GObject *source,
+         GAsyncResult *result,
+         gpointer data)
+{
+  XdpBatch *batch = data;
+  g_autoptr(GError) error = NULL;
+
+  if (!xdp_portal_flush_finish (XDP_PORTAL (source), result, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning ("Failed to flush batched calls: %s", error->message);
+
+  batch_finish_operation (batch);
+}
+
+static gboolean
+batch_parent_export (XdpParent *parent,
+                     XdpParentExported callback,
+                     gpointer data)
+{
+  XdpBatch *batch = XDP_BATCH (parent->object);
+
+  callback (parent, batch->parent_handle, data);
+  return TRUE;
+}
+
+static void
+batch_parent_unexport (XdpParent *parent)
+{
+  /* The batch owns the export */
+}
+
+static void
+start_operations (XdpBatch *batch)
+{
+  GCancellable *cancellable;
+  XdpParent parent = { 0, };
+  gboolean have_calls = FALSE;
+  guint i;
+
+  cancellable = g_task_get_cancellable (batch->task);
+
+  /* Operations copy this, and all copies hand out the exported handle */
+  parent.export = batch_parent_export;
+  parent.unexport = batch_parent_unexport;
+  parent.object = G_OBJECT (batch);
+
+  /* Keep the batch from finishing while operations are being started */
+  batch->n_pending = 1;
+
+  for (i = 0; i < batch->operations->len; i++)
+    {
+      BatchOperation *op = g_ptr_array_index (batch->operations, i);
+
+      if (op->call)
+        {
+          op->call (batch->portal, op->data);
+          have_calls = TRUE;
+        }
+      else
+        {
+          batch->n_pending++;
+          op->start (batch->portal,
+                     batch->parent ? &parent : NULL,
+                     cancellable,
+                     operation_done,
+                     op,
+                     op->data);
+        }
+    }
+
+  if (have_calls)
+    {
+      batch->n_pending++;
+      xdp_portal_flush (batch->portal, -1, cancellable, flushed, batch);
+    }
+
+  batch_finish_operation (batch);
+}
+
+static void
+parent_exported (XdpParent *parent,
+                 const char *handle,
+                 gpointer data)
+{
+  XdpBatch *batch = data;
+
+  batch->parent_handle = g_strdup (handle);
+  start_operations (batch);
+}
+
+/**
+ * xdp_batch_run:
+ * @batch: a #XdpBatch
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Starts all operations of the batch. @cancellable is passed
+ * to every operation. A batch can only be run once.
+ *
+ * When all operations are done, @callback will be called. You can then
+ * call xdp_batch_run_finish() to get the results.
+ */
+void
+xdp_batch_run (XdpBatch            *batch,
+               GCancellable        *cancellable,
+               GAsyncReadyCallback  callback,
+               gpointer             data)
+{
+  g_return_if_fail (XDP_IS_BATCH (batch));
+  g_return_if_fail (!batch->started);
+
+  batch->started = TRUE;
+  batch->task = g_task_new (batch, cancellable, callback, data);
+
+  if (batch->parent)
+    {
+      if (!batch->parent->export (batch->parent, parent_exported, batch))
+        {
+          g_warning ("Failed to export parent window, running batch without it");
+          _xdp_parent_free (batch->parent);
+          batch->parent = NULL;
+        }
+      else
+        return;
+    }
+
+  start_operations (batch);
+}
+
+/**
+ * xdp_batch_run_finish:
+ * @batch: a #XdpBatch
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes running the batch. The outcome of each operation is
+ * available with xdp_batch_get_result().
+ *
+ * Returns: %TRUE if all operations have finished, %FALSE if
+ *     the batch was cancelled
+ */
+gboolean
+xdp_batch_run_finish (XdpBatch      *batch,
+                      GAsyncResult  *result,
+                      GError       **error)
+{
+  g_return_val_if_fail (XDP_IS_BATCH (batch), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, batch), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * xdp_batch_get_result:
+ * @batch: a #XdpBatch
+ * @index: the index of an operation, as returned by xdp_batch_add()
+ *
+ * Returns the result of an operation of the batch. Pass it to the finish
+ * function of the call that the operation made, for example
+ * xdp_portal_get_user_information_finish().
+ *
+ * Returns: (transfer none) (nullable): the result of the operation,
+ *     or %NULL if it has not finished
+ */
+GAsyncResult *
+xdp_batch_get_result (XdpBatch *batch,
+                      guint     index)
+{
+  BatchOperation *op;
+
+  g_return_val_if_fail (XDP_IS_BATCH (batch), NULL);
+  g_return_val_if_fail (index < batch->operations->len, NULL);
+
+  op = g_ptr_array_index (batch->operations, index);
+  g_return_val_if_fail (op->start != NULL, NULL);
+
+  return op->result;
+}
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gunixfdlist.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include "portal-private.h"
+#include "session-private.h"
+
+/**
+ * SECTION:clipboard
+ * @title: Clipboard
+ * @short_description: share the clipboard with a remote desktop session
+ *
+ * These functions let a remote desktop session exchange clipboard
+ * contents with the compositor.
+ *
+ * Access to the clipboard has to be requested with
+ * xdp_session_request_clipboard() before the session is started.
+ * Whether it was granted can be checked afterwards with
+ * xdp_session_is_clipboard_enabled().
+ *
+ * To offer data, call xdp_session_set_selection() with the mime types
+ * that are available. When another application pastes, the
+ * #XdpSession::selection-transfer signal is emitted, and the data
+ * is provided with xdp_session_selection_write(). To paste, use
+ * xdp_session_selection_read() with one of the mime types announced
+ * by #XdpSession::selection-owner-changed.
+ *
+ * The data is streamed through file descriptors, so large selections
+ * are never held in memory as a whole.
+ *
+ * The underlying portal is org.freedesktop.portal.Clipboard.
+ */
+
+#define CLIPBOARD_INTERFACE "org.freedesktop.portal.Clipboard"
+
+static void
+clipboard_signal (GDBusConnection *bus,
+                  const char *sender_name,
+                  const char *object_path,
+                  const char *interface_name,
+                  const char *signal_name,
+                  GVariant *parameters,
+                  gpointer data)
+{
+  XdpSession *session = data;
+  const char *session_handle;
+
+  /* All clipboard signals carry the session handle first */
+  g_variant_get_child (parameters, 0, "&o", &session_handle);
+  if (g_strcmp0 (session_handle, session->id) != 0)
+    return;
+
+  if (g_str_equal (signal_name, "SelectionOwnerChanged"))
+    {
+      g_autoptr(GVariant) options = NULL;
+      g_autofree const char **mime_types = NULL;
+      gboolean session_is_owner = FALSE;
+
+      g_variant_get (parameters, "(&o@a{sv})", NULL, &options);
+      g_variant_lookup (options, "mime_types", "^a&s", &mime_types);
+      g_variant_lookup (options, "session_is_owner", "b", &session_is_owner);
+
+      g_signal_emit (session, _xdp_session_signals[SESSION_SELECTION_OWNER_CHANGED], 0, mime_types, session_is_owner);
+    }
+  else if (g_str_equal (signal_name, "SelectionTransfer"))
+    {
+      const char *mime_type;
+      guint32 serial;
+
+      g_variant_get (parameters, "(&o&su)", NULL, &mime_type, &serial);
+
+      g_signal_emit (session, _xdp_session_signals[SESSION_SELECTION_TRANSFER], 0, mime_type, serial);
+    }
+}
+
+void
+_xdp_session_subscribe_clipboard (XdpSession *session)
+{
+  if (session->clipboard_signal_id)
+    g_dbus_connection_signal_unsubscribe (session->portal->bus, session->clipboard_signal_id);
+
+  /* One subscription for all clipboard signals of this session */
+  session->clipboard_signal_id = g_dbus_connection_signal_subscribe (session->portal->bus,
+                                                                     PORTAL_BUS_NAME,
+                                                                     CLIPBOARD_INTERFACE,
+                                                                     NULL,
+                                                                     PORTAL_OBJECT_PATH,
+                                                                     NULL,
+                                                                     G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+                                                                     clipboard_signal,
+                                                                     session,
+                                                                     NULL);
+}
+
+void
+_xdp_session_request_clipboard (XdpSession *session)
+{
+  GVariantBuilder options;
+
+  _xdp_session_subscribe_clipboard (session);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_dbus_connection_call (session->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          CLIPBOARD_INTERFACE,
+                          "RequestClipboard",
+                          g_variant_new ("(oa{sv})", session->id, &options),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+/**
+ * xdp_session_request_clipboard:
+ * @session: a remote desktop #XdpSession in initial state
+ *
+ * Requests access to the clipboard for @session. This must be
+ * done before the session is started.
+ */
+void
+xdp_session_request_clipboard (XdpSession *session)
+{
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_REMOTE_DESKTOP &&
+                    session->state == XDP_SESSION_INITIAL);
+
+  session->clipboard_requested = TRUE;
+  _xdp_session_request_clipboard (session);
+}
+
+/**
+ * xdp_session_is_clipboard_enabled:
+ * @session: a #XdpSession
+ *
+ * Returns whether the clipboard can be used with @session.
+ *
+ * Unless the session is active, this function returns %FALSE.
+ *
+ * Returns: %TRUE if clipboard access was granted
+ */
+gboolean
+xdp_session_is_clipboard_enabled (XdpSession *session)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), FALSE);
+
+  return session->state == XDP_SESSION_ACTIVE && session->clipboard_enabled;
+}
+
+/**
+ * xdp_session_set_selection:
+ * @session: a #XdpSession
+ * @mime_types: (array zero-terminated=1): the mime types that are offered
+ *
+ * Takes ownership of the clipboard, offering data in the given
+ * mime types. The data is requested with the
+ * #XdpSession::selection-transfer signal.
+ */
+void
+xdp_session_set_selection (XdpSession *session,
+                           const char * const *mime_types)
+{
+  GVariantBuilder options;
+
+  g_return_if_fail (xdp_session_is_clipboard_enabled (session));
+  g_return_if_fail (mime_types != NULL);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "mime_types", g_variant_new_strv (mime_types, -1));
+  g_dbus_connection_call (session->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          CLIPBOARD_INTERFACE,
+                          "SetSelection",
+                          g_variant_new ("(oa{sv})", session->id, &options),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+/**
+ * xdp_session_selection_write_done:
+ * @session: a #XdpSession
+ * @serial: the serial from #XdpSession::selection-transfer
+ * @success: whether the data was written
+ *
+ * Tells the portal that a transfer is finished. This is done
+ * by xdp_session_selection_write(); applications only need to call
+ * it to decline a transfer.
+ */
+void
+xdp_session_selection_write_done (XdpSession *session,
+                                  guint serial,
+                                  gboolean success)
+{
+  g_return_if_fail (XDP_IS_SESSION (session));
+
+  g_dbus_connection_call (session->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          CLIPBOARD_INTERFACE,
+                          "SelectionWriteDone",
+                          g_variant_new ("(oub)", session->id, serial, success),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+typedef struct {
+  XdpSession *session;
+  guint serial;
+  GInputStream *source;
+  GTask *task;
+} WriteCall;
+
+static void
+write_call_free (WriteCall *call)
+{
+  g_object_unref (call->session);
+  g_object_unref (call->source);
+  g_object_unref (call->task);
+
+  g_free (call);
+}
+
+static void
+selection_spliced (GObject *source,
+                   GAsyncResult *result,
+                   gpointer data)
+{
+  WriteCall *call = data;
+  GError *error = NULL;
+  gssize written;
+
+  written = g_output_stream_splice_finish (G_OUTPUT_STREAM (source), result, &error);
+
+  xdp_session_selection_write_done (call->session, call->serial, written >= 0);
+
+  if (written < 0)
+    g_task_return_error (call->task, error);
+  else
+    g_task_return_boolean (call->task, TRUE);
+
+  write_call_free (call);
+}
+
+static void
+selection_write_opened (GObject *source,
+                        GAsyncResult *result,
+                        gpointer data)
+{
+  WriteCall *call = data;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GOutputStream) stream = NULL;
+  GError *error = NULL;
+  int fd_in;
+  int fd;
+
+  ret = g_dbus_connection_call_with_unix_fd_list_finish (G_DBUS_CONNECTION (source), &fd_list, result, &error);
+  if (ret == NULL)
+    {
+      g_task_return_error (call->task, error);
+      write_call_free (call);
+      return;
+    }
+
+  g_variant_get (ret, "(h)", &fd_in);
+  fd = g_unix_fd_list_get (fd_list, fd_in, &error);
+  if (fd == -1)
+    {
+      xdp_session_selection_write_done (call->session, call->serial, FALSE);
+      g_task_return_error (call->task, error);
+      write_call_free (call);
+      return;
+    }
+
+  /* The data goes straight from the source to the portal */
+  stream = g_unix_output_stream_new (fd, TRUE);
+  g_output_stream_splice_async (stream,
+                                call->source,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                G_PRIORITY_DEFAULT,
+                                g_task_get_cancellable (call->task),
+                                selection_spliced,
+                                call);
+}
+
+/**
+ * xdp_session_selection_write:
+ * @session: a #XdpSession
+ * @serial: the serial from #XdpSession::selection-transfer
+ * @source: the stream to read the data from
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Provides the data for a transfer that was requested with
+ * #XdpSession::selection-transfer. The contents of @source are copied
+ * to the portal as they are read, and @source is closed afterwards.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_session_selection_write_finish() to get the results.
+ */
+void
+xdp_session_selection_write (XdpSession *session,
+                             guint serial,
+                             GInputStream *source,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer data)
+{
+  WriteCall *call;
+
+  g_return_if_fail (xdp_session_is_clipboard_enabled (session));
+  g_return_if_fail (G_IS_INPUT_STREAM (source));
+
+  call = g_new0 (WriteCall, 1);
+  call->session = g_object_ref (session);
+  call->serial = serial;
+  call->source = g_object_ref (source);
+  call->task = g_task_new (session, cancellable, callback, data);
+
+  g_dbus_connection_call_with_unix_fd_list (session->portal->bus,
+                                            PORTAL_BUS_NAME,
+                                            PORTAL_OBJECT_PATH,
+                                            CLIPBOARD_INTERFACE,
+                                            "SelectionWrite",
+                                            g_variant_new ("(ou)", session->id, serial),
+                                            G_VARIANT_TYPE ("(h)"),
+                                            G_DBUS_CALL_FLAGS_NONE,
+                                            -1,
+                                            NULL,
+                                            cancellable,
+                                            selection_write_opened,
+                                            call);
+}
+
+/**
+ * xdp_session_selection_write_finish:
+ * @session: a #XdpSession
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the selection write request.
+ *
+ * Returns: %TRUE if the data was transferred
+ */
+gboolean
+xdp_session_selection_write_finish (XdpSession *session,
+                                    GAsyncResult *result,
+                                    GError **error)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, session), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+selection_read_opened (GObject *source,
+                       GAsyncResult *result,
+                       gpointer data)
+{
+  g_autoptr(GTask) task = data;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+  int fd_in;
+  int fd;
+
+  ret = g_dbus_connection_call_with_unix_fd_list_finish (G_DBUS_CONNECTION (source), &fd_list, result, &error);
+  if (ret == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_variant_get (ret, "(h)", &fd_in);
+  fd = g_unix_fd_list_get (fd_list, fd_in, &error);
+  if (fd == -1)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_task_return_pointer (task, g_unix_input_stream_new (fd, TRUE), g_object_unref);
+}
+
+/**
+ * xdp_session_selection_read:
+ * @session: a #XdpSession
+ * @mime_type: the mime type to read
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Requests the current clipboard contents in the given mime type.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_session_selection_read_finish() to get the results.
+ */
+void
+xdp_session_selection_read (XdpSession *session,
+                            const char *mime_type,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer data)
+{
+  g_return_if_fail (xdp_session_is_clipboard_enabled (session));
+  g_return_if_fail (mime_type != NULL);
+
+  g_dbus_connection_call_with_unix_fd_list (session->portal->bus,
+                                            PORTAL_BUS_NAME,
+                                            PORTAL_OBJECT_PATH,
+                                            CLIPBOARD_INTERFACE,
+                                            "SelectionRead",
+                                            g_variant_new ("(os)", session->id, mime_type),
+                                            G_VARIANT_TYPE ("(h)"),
+                                            G_DBUS_CALL_FLAGS_NONE,
+                                            -1,
+                                            NULL,
+                                            cancellable,
+                                            selection_read_opened,
+                                            g_task_new (session, cancellable, callback, data));
+}
+
+/**
+ * xdp_session_selection_read_finish:
+ * @session: a #XdpSession
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the selection read request, and returns a stream that
+ * produces the clipboard contents. The data is read from the
+ * clipboard owner as the stream is read; use g_output_stream_splice_async()
+ * to copy it somewhere without holding it in memory.
+ *
+ * Returns: (transfer full): a #GInputStream for the clipboard contents
+ */
+GInputStream *
+xdp_session_selection_read_finish (XdpSession *session,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, session), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "portal-private.h"
+
+#if XDP_HAS_SCREENSHOT_PROCESSING
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#endif
+
+/**
+ * SECTION:colorsample
+ * @title: Color sampling
+ * @short_description: read the colors of many points at once
+ *
+ * xdp_portal_pick_color() lets the user pick a single color, with one
+ * portal request per color. To extract a palette, take one screenshot
+ * with xdp_portal_take_screenshot() and pass it to
+ * xdp_portal_sample_colors(), which reads the color of any number of
+ * points or regions from it, as the average or median of their pixels.
+ *
+ * For a live preview that follows the pointer, such as an eyedropper,
+ * create a screencast session with xdp_portal_create_screencast_session()
+ * and consume its PipeWire stream, which can be opened with
+ * xdp_session_open_pipewire_remote(). Pass each frame, together with the
+ * pointer position that the stream reports, to xdp_sample_frame_colors().
+ * No portal request is made per sample.
+ */
+
+typedef struct {
+  const guchar *pixels;
+  int width;
+  int height;
+  int stride;
+  int bpp;
+  int red;
+  int blue;
+} Frame;
+
+/* Writes the color of the part of @region that lies inside the frame
+ * to @color. Returns %FALSE if no part of it does.
+ */
+static gboolean
+sample_region (const Frame *frame,
+               const XdpSampleRegion *region,
+               XdpColorSampleMode mode,
+               double color[3])
+{
+  int x0, y0, x1, y1;
+  int x, y, c;
+  guint64 n;
+
+  x0 = MAX (region->x, 0);
+  y0 = MAX (region->y, 0);
+  x1 = MIN (region->x + MAX (region->width, 1), frame->width);
+  y1 = MIN (region->y + MAX (region->height, 1), frame->height);
+
+  if (x0 >= x1 || y0 >= y1)
+    return FALSE;
+
+  n = (guint64) (x1 - x0) * (y1 - y0);
+
+  if (mode == XDP_COLOR_SAMPLE_MEDIAN)
+    {
+      guint64 histogram[3][256] = { { 0, } };
+      guint64 half = (n - 1) / 2;
+
+      for (y = y0; y < y1; y++)
+        {
+          const guchar *p = frame->pixels + (gsize) y * frame->stride + (gsize) x0 * frame->bpp;
+
+          for (x = x0; x < x1; x++, p += frame->bpp)
+            {
+              histogram[0][p[frame->red]]++;
+              histogram[1][p[1]]++;
+              histogram[2][p[frame->blue]]++;
+            }
+        }
+
+      /* The lower median of each channel */
+      for (c = 0; c < 3; c++)
+        {
+          guint64 seen = 0;
+          int v;
+
+          for (v = 0; v < 255; v++)
+            {
+              seen += histogram[c][v];
+              if (seen > half)
+                break;
+            }
+
+          color[c] = v / 255.0;
+        }
+    }
+  else
+    {
+      guint64 sum[3] = { 0, 0, 0 };
+
+      for (y = y0; y < y1; y++)
+        {
+          const guchar *p = frame->pixels + (gsize) y * frame->stride + (gsize) x0 * frame->bpp;
+
+          for (x = x0; x < x1; x++, p += frame->bpp)
+            {
+              sum[0] += p[frame->red];
+              sum[1] += p[1];
+              sum[2] += p[frame->blue];
+            }
+        }
+
+      for (c = 0; c < 3; c++)
+        color[c] = (double) sum[c] / n / 255.0;
+    }
+
+  return TRUE;
+}
+
+static GVariant *
+sample_frame (const Frame *frame,
+              const XdpSampleRegion *regions,
+              gsize n_regions,
+              XdpColorSampleMode mode,
+              GError **error)
+{
+  GVariantBuilder colors;
+  gsize i;
+
+  g_variant_builder_init (&colors, G_VARIANT_TYPE ("a(ddd)"));
+
+  for (i = 0; i < n_regions; i++)
+    {
+      double color[3];
+
+      if (!sample_region (frame, &regions[i], mode, color))
+        {
+          g_variant_builder_clear (&colors);
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                       "Region %" G_GSIZE_FORMAT " lies outside of the %dx%d image",
+                       i, frame->width, frame->height);
+          return NULL;
+        }
+
+      g_variant_builder_add (&colors, "(ddd)", color[0], color[1], color[2]);
+    }
+
+  return g_variant_builder_end (&colors);
+}
+
+/**
+ * xdp_sample_frame_colors:
+ * @pixels: (array): the pixels of the frame
+ * @width: the width of the frame
+ * @height: the height of the frame
+ * @stride: the number of bytes between the starts of two rows
+ * @format: the layout of the pixels
+ * @regions: (array length=n_regions): the regions to sample
+ * @n_regions: the number of elements in @regions
+ * @mode: how to combine the pixels of a region
+ * @error: return location for an error
+ *
+ * Reads the colors of regions of a video frame, such as a frame of
+ * a screencast stream. The frame is only read, so this can be called
+ * for every frame, in any thread.
+ *
+ * Parts of regions that lie outside of the frame are ignored. It is an
+ * error if a region lies entirely outside of it.
+ *
+ * Returns: (transfer floating): a GVariant of type a(ddd) with the
+ *     color of each region, containing red, green and blue components
+ *     in the range [0,1], or %NULL on error
+ */
+GVariant *
+xdp_sample_frame_colors (const guchar           *pixels,
+                         int                     width,
+                         int                     height,
+                         int                     stride,
+                         XdpFrameFormat          format,
+                         const XdpSampleRegion  *regions,
+                         gsize                   n_regions,
+                         XdpColorSampleMode      mode,
+                         GError                **error)
+{
+  Frame frame;
+
+  g_return_val_if_fail (pixels != NULL, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (stride >= width * 4, NULL);
+  g_return_val_if_fail (regions != NULL || n_regions == 0, NULL);
+
+  frame.pixels = pixels;
+  frame.width = width;
+  frame.height = height;
+  frame.stride = stride;
+  frame.bpp = 4;
+  frame.red = format == XDP_FRAME_FORMAT_BGRX ? 2 : 0;
+  frame.blue = format == XDP_FRAME_FORMAT_BGRX ? 0 : 2;
+
+  return sample_frame (&frame, regions, n_regions, mode, error);
+}
+
+#if XDP_HAS_SCREENSHOT_PROCESSING
+
+typedef struct {
+  char *path;
+  XdpSampleRegion *regions;
+  gsize n_regions;
+  XdpColorSampleMode mode;
+} SampleData;
+
+static void
+sample_data_free (SampleData *data)
+{
+  g_free (data->path);
+  g_free (data->regions);
+  g_free (data);
+}
+
+static void
+sample_thread (GTask        *task,
+               gpointer      source_object,
+               gpointer      task_data,
+               GCancellable *cancellable)
+{
+  SampleData *data = task_data;
+  g_autoptr(GdkPixbuf) pixbuf = NULL;
+  GVariant *colors;
+  GError *error = NULL;
+  Frame frame;
+
+  pixbuf = gdk_pixbuf_new_from_file (data->path, &error);
+  if (pixbuf == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  frame.pixels = gdk_pixbuf_read_pixels (pixbuf);
+  frame.width = gdk_pixbuf_get_width (pixbuf);
+  frame.height = gdk_pixbuf_get_height (pixbuf);
+  frame.stride = gdk_pixbuf_get_rowstride (pixbuf);
+  frame.bpp = gdk_pixbuf_get_n_channels (pixbuf);
+  frame.red = 0;
+  frame.blue = 2;
+
+  colors = sample_frame (&frame, data->regions, data->n_regions, data->mode, &error);
+  if (colors == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_task_return_pointer (task, g_variant_ref_sink (colors), (GDestroyNotify) g_variant_unref);
+}
+
+/**
+ * xdp_portal_sample_colors:
+ * @portal: a #XdpPortal
+ * @uri: the URI of a screenshot, as returned by xdp_portal_take_screenshot_finish()
+ * @regions: (array length=n_regions): the regions to sample
+ * @n_regions: the number of elements in @regions
+ * @mode: how to combine the pixels of a region
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Reads the colors of any number of points or regions of a screenshot.
+ * The image is decoded once, in a worker thread.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_sample_colors_finish() to get the results.
+ */
+void
+xdp_portal_sample_colors (XdpPortal              *portal,
+                          const char             *uri,
+                          const XdpSampleRegion  *regions,
+                          gsize                   n_regions,
+                          XdpColorSampleMode      mode,
+                          GCancellable           *cancellable,
+                          GAsyncReadyCallback     callback,
+                          gpointer                data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  SampleData *sample;
+  char *path;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (regions != NULL || n_regions == 0);
+
+  task = g_task_new (portal, cancellable, callback, data);
+
+  path = g_filename_from_uri (uri, NULL, &error);
+  if (path == NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  sample = g_new0 (SampleData, 1);
+  sample->path = path;
+  sample->regions = g_new (XdpSampleRegion, n_regions);
+  memcpy (sample->regions, regions, sizeof (XdpSampleRegion) * n_regions);
+  sample->n_regions = n_regions;
+  sample->mode = mode;
+  g_task_set_task_data (task, sample, (GDestroyNotify) sample_data_free);
+
+  g_task_run_in_thread (task, sample_thread);
+}
+
+/**
+ * xdp_portal_sample_colors_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes a color sampling request, and returns the result in the
+ * form of a GVariant of type a(ddd), with the color of each region in
+ * the same order as they were passed. Each color contains red, green
+ * and blue components in the range [0,1], like the result of
+ * xdp_portal_pick_color_finish().
+ *
+ * Returns: (transfer full): a GVariant containing the colors
+ */
+GVariant *
+xdp_portal_sample_colors_finish (XdpPortal     *portal,
+                                 GAsyncResult  *result,
+                                 GError       **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, portal), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+#endif /* XDP_HAS_SCREENSHOT_PROCESSING */
@@ -0,0 +1,561 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "portal-private.h"
+#include "utils-private.h"
+
+/**
+ * SECTION:dynamiclauncher
+ * @title: Dynamic launcher
+ * @short_description: install application launchers
+ *
+ * These functions let applications install launchers, such as
+ * desktop files for web applications, that show up like other
+ * applications on the system.
+ *
+ * Many launchers can be installed with one call to
+ * xdp_portal_install_launchers(). The launchers are prepared and
+ * installed in parallel, with a limit on the number of requests that
+ * are in flight at the same time, and the outcome is reported for
+ * each launcher.
+ *
+ * The portal expects icons inline in its requests. Icon files are
+ * memory-mapped instead of read into a buffer first. D-Bus still
+ * copies the icon data when it serializes the request.
+ *
+ * The underlying portal is org.freedesktop.portal.DynamicLauncher.
+ */
+
+#define DYNAMIC_LAUNCHER_INTERFACE "org.freedesktop.portal.DynamicLauncher"
+
+#define DEFAULT_MAX_CONCURRENT 4
+
+typedef struct {
+  gboolean success;
+  char *error;
+} ItemResult;
+
+typedef struct {
+  XdpPortal *portal;
+  XdpParent *parent;
+  char *parent_handle;
+  XdpLauncher *launchers;
+  ItemResult *results;
+  gsize n_launchers;
+  XdpLauncherInstallFlags flags;
+  guint max_concurrent;
+  gsize next;
+  guint n_running;
+  gsize n_done;
+  GTask *task;
+} InstallBatch;
+
+typedef struct {
+  InstallBatch *batch;
+  gsize index;
+  guint signal_id;
+  char *request_path;
+  gulong cancelled_id;
+} InstallItem;
+
+static void
+install_batch_free (InstallBatch *batch)
+{
+  gsize i;
+
+  if (batch->parent)
+    {
+      batch->parent->unexport (batch->parent);
+      _xdp_parent_free (batch->parent);
+    }
+  g_free (batch->parent_handle);
+
+  for (i = 0; i < batch->n_launchers; i++)
+    {
+      g_free ((char *) batch->launchers[i].name);
+      g_free ((char *) batch->launchers[i].icon_file);
+      g_free ((char *) batch->launchers[i].desktop_file_id);
+      g_free ((char *) batch->launchers[i].desktop_entry);
+      g_free ((char *) batch->launchers[i].target);
+      g_free (batch->results[i].error);
+    }
+  g_free (batch->launchers);
+  g_free (batch->results);
+
+  g_object_unref (batch->portal);
+  g_object_unref (batch->task);
+
+  g_free (batch);
+}
+
+static void start_items (InstallBatch *batch);
+
+static void
+set_result (InstallBatch *batch,
+            gsize index,
+            const GError *error)
+{
+  ItemResult *result = &batch->results[index];
+
+  result->success = error == NULL;
+  result->error = error ? g_strdup (error->message) : NULL;
+  batch->n_done++;
+}
+
+static void
+item_done (InstallItem *item,
+           const GError *error)
+{
+  InstallBatch *batch = item->batch;
+
+  if (item->signal_id)
+    g_dbus_connection_signal_unsubscribe (batch->portal->bus, item->signal_id);
+  if (item->cancelled_id)
+    g_signal_handler_disconnect (g_task_get_cancellable (batch->task), item->cancelled_id);
+
+  set_result (batch, item->index, error);
+  batch->n_running--;
+
+  g_free (item->request_path);
+  g_free (item);
+
+  start_items (batch);
+}
+
+static void
+installed (GObject *source,
+           GAsyncResult *result,
+           gpointer data)
+{
+  InstallItem *item = data;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GError) error = NULL;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  item_done (item, error);
+}
+
+static void
+install (InstallItem *item,
+         const char *token)
+{
+  InstallBatch *batch = item->batch;
+  const XdpLauncher *launcher = &batch->launchers[item->index];
+  GVariantBuilder options;
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_dbus_connection_call (batch->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          DYNAMIC_LAUNCHER_INTERFACE,
+                          "Install",
+                          g_variant_new ("(sssa{sv})",
+                                         token,
+                                         launcher->desktop_file_id,
+                                         launcher->desktop_entry,
+                                         &options),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          g_task_get_cancellable (batch->task),
+                          installed,
+                          item);
+}
+
+static void
+token_received (GObject *source,
+                GAsyncResult *result,
+                gpointer data)
+{
+  InstallItem *item = data;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GError) error = NULL;
+  const char *token;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  if (ret == NULL)
+    {
+      item_done (item, error);
+      return;
+    }
+
+  g_variant_get (ret, "(&s)", &token);
+  install (item, token);
+}
+
+static void
+install_prepared (GDBusConnection *bus,
+                  const char *sender_name,
+                  const char *object_path,
+                  const char *interface_name,
+                  const char *signal_name,
+                  GVariant *parameters,
+                  gpointer data)
+{
+  InstallItem *item = data;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GError) error = NULL;
+  guint32 response;
+  const char *token;
+
+  g_variant_get (parameters, "(u@a{sv})", &response, &ret);
+
+  if (response == 0 && !g_variant_lookup (ret, "token", "&s", &token))
+    response = 2;
+
+  if (response == 1)
+    g_set_error (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Install canceled");
+  else if (response == 2)
+    g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED, "Install failed");
+
+  if (error)
+    {
+      item_done (item, error);
+      return;
+    }
+
+  g_dbus_connection_signal_unsubscribe (item->batch->portal->bus, item->signal_id);
+  item->signal_id = 0;
+
+  install (item, token);
+}
+
+/* A failed call gets no Response, so the item is done here */
+static void
+prepare_install_done (GObject *source,
+                      GAsyncResult *result,
+                      gpointer data)
+{
+  InstallItem *item = data;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GError) error = NULL;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  if (ret == NULL)
+    item_done (item, error);
+}
+
+static void
+item_cancelled (GCancellable *cancellable,
+                gpointer data)
+{
+  InstallItem *item = data;
+
+  g_dbus_connection_call (item->batch->portal->bus,
+                          PORTAL_BUS_NAME,
+                          item->request_path,
+                          REQUEST_INTERFACE,
+                          "Close",
+                          NULL,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+static GVariant *
+load_icon (const char *file,
+           GError **error)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GIcon) icon = NULL;
+
+  /* This saves reading the file into a buffer. The mapping stays
+   * alive as long as the GVariant needs it, but the data is copied
+   * when the request is serialized.
+   */
+  mapped = g_mapped_file_new (file, FALSE, error);
+  if (mapped == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  icon = g_bytes_icon_new (bytes);
+
+  return g_icon_serialize (icon);
+}
+
+static void
+start_item (InstallBatch *batch,
+            gsize index)
+{
+  const XdpLauncher *launcher = &batch->launchers[index];
+  InstallItem *item;
+  GVariantBuilder options;
+  g_autoptr(GVariant) icon = NULL;
+  g_autoptr(GError) error = NULL;
+  const char *token;
+  GCancellable *cancellable;
+
+  cancellable = g_task_get_cancellable (batch->task);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, &error))
+    {
+      set_result (batch, index, error);
+      return;
+    }
+
+  icon = load_icon (launcher->icon_file, &error);
+  if (icon == NULL)
+    {
+      set_result (batch, index, error);
+      return;
+    }
+
+  item = g_new0 (InstallItem, 1);
+  item->batch = batch;
+  item->index = index;
+  batch->n_running++;
+
+  if ((batch->flags & XDP_LAUNCHER_INSTALL_FLAG_INTERACTIVE) == 0)
+    {
+      g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+      g_dbus_connection_call (batch->portal->bus,
+                              PORTAL_BUS_NAME,
+                              PORTAL_OBJECT_PATH,
+                              DYNAMIC_LAUNCHER_INTERFACE,
+                              "RequestInstallToken",
+                              g_variant_new ("(s@va{sv})",
+                                             launcher->name,
+                                             g_variant_new_variant (icon),
+                                             &options),
+                              G_VARIANT_TYPE ("(s)"),
+                              G_DBUS_CALL_FLAGS_NONE,
+                              -1,
+                              cancellable,
+                              token_received,
+                              item);
+      return;
+    }
+
+  item->request_path = _xdp_portal_new_handle (batch->portal, REQUEST_PATH_PREFIX, &token);
+  item->signal_id = g_dbus_connection_signal_subscribe (batch->portal->bus,
+                                                        PORTAL_BUS_NAME,
+                                                        REQUEST_INTERFACE,
+                                                        "Response",
+                                                        item->request_path,
+                                                        NULL,
+                                                        G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+                                                        install_prepared,
+                                                        item,
+                                                        NULL);
+
+  if (cancellable)
+    item->cancelled_id = g_signal_connect (cancellable, "cancelled", G_CALLBACK (item_cancelled), item);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
+  g_variant_builder_add (&options, "{sv}", "launcher_type",
+                         g_variant_new_uint32 (launcher->target ? 2 : 1));
+  if (launcher->target)
+    g_variant_builder_add (&options, "{sv}", "target", g_variant_new_string (launcher->target));
+
+  g_dbus_connection_call (batch->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          DYNAMIC_LAUNCHER_INTERFACE,
+                          "PrepareInstall",
+                          g_variant_new ("(ss@va{sv})",
+                                         batch->parent_handle,
+                                         launcher->name,
+                                         g_variant_new_variant (icon),
+                                         &options),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          cancellable,
+                          prepare_install_done,
+                          item);
+}
+
+static void
+start_items (InstallBatch *batch)
+{
+  GVariantBuilder results;
+  gsize i;
+
+  while (batch->n_running < batch->max_concurrent &&
+         batch->next < batch->n_launchers)
+    start_item (batch, batch->next++);
+
+  if (batch->n_done < batch->n_launchers)
+    return;
+
+  g_variant_builder_init (&results, G_VARIANT_TYPE ("a(sbs)"));
+  for (i = 0; i < batch->n_launchers; i++)
+    g_variant_builder_add (&results, "(sbs)",
+                           batch->launchers[i].desktop_file_id,
+                           batch->results[i].success,
+                           batch->results[i].error ? batch->results[i].error : "");
+
+  g_task_return_pointer (batch->task,
+                         g_variant_ref_sink (g_variant_builder_end (&results)),
+                         (GDestroyNotify) g_variant_unref);
+
+  install_batch_free (batch);
+}
+
+static void
+parent_exported (XdpParent *parent,
+                 const char *handle,
+                 gpointer data)
+{
+  InstallBatch *batch = data;
+  batch->parent_handle = g_strdup (handle);
+  start_items (batch);
+}
+
+/**
+ * xdp_portal_install_launchers:
+ * @portal: a #XdpPortal
+ * @parent: (nullable): parent window information
+ * @launchers: (array length=n_launchers): the launchers to install
+ * @n_launchers: the number of launchers
+ * @flags: options for this call
+ * @max_concurrent: the maximum number of launchers to process
+ *     at the same time, or 0 for a default
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Installs a number of launchers.
+ *
+ * With %XDP_LAUNCHER_INSTALL_FLAG_INTERACTIVE, the user is asked to
+ * confirm each launcher. Otherwise, the launchers are installed without
+ * asking, which the portal only allows for some applications.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_install_launchers_finish() to get the results.
+ */
+void
+xdp_portal_install_launchers (XdpPortal *portal,
+                              XdpParent *parent,
+                              const XdpLauncher *launchers,
+                              gsize n_launchers,
+                              XdpLauncherInstallFlags flags,
+                              guint max_concurrent,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer data)
+{
+  InstallBatch *batch;
+  gsize i;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (launchers != NULL || n_launchers == 0);
+  g_return_if_fail ((flags & ~(XDP_LAUNCHER_INSTALL_FLAG_INTERACTIVE)) == 0);
+
+  for (i = 0; i < n_launchers; i++)
+    {
+      g_return_if_fail (launchers[i].name != NULL);
+      g_return_if_fail (launchers[i].icon_file != NULL);
+      g_return_if_fail (launchers[i].desktop_file_id != NULL);
+      g_return_if_fail (launchers[i].desktop_entry != NULL);
+    }
+
+  batch = g_new0 (InstallBatch, 1);
+  batch->portal = g_object_ref (portal);
+  batch->flags = flags;
+  batch->max_concurrent = max_concurrent ? max_concurrent : DEFAULT_MAX_CONCURRENT;
+  batch->n_launchers = n_launchers;
+  batch->launchers = g_new0 (XdpLauncher, n_launchers);
+  batch->results = g_new0 (ItemResult, n_launchers);
+  for (i = 0; i < n_launchers; i++)
+    {
+      batch->launchers[i].name = g_strdup (launchers[i].name);
+      batch->launchers[i].icon_file = g_strdup (launchers[i].icon_file);
+      batch->launchers[i].desktop_file_id = g_strdup (launchers[i].desktop_file_id);
+      batch->launchers[i].desktop_entry = g_strdup (launchers[i].desktop_entry);
+      batch->launchers[i].target = g_strdup (launchers[i].target);
+    }
+  batch->task = g_task_new (portal, cancellable, callback, data);
+
+  /* One parent handle is shared by all items */
+  if (parent && (flags & XDP_LAUNCHER_INSTALL_FLAG_INTERACTIVE) != 0)
+    {
+      batch->parent = _xdp_parent_copy (parent);
+      batch->parent->export (batch->parent, parent_exported, batch);
+      return;
+    }
+
+  batch->parent_handle = g_strdup ("");
+  start_items (batch);
+}
+
+/**
+ * xdp_portal_install_launchers_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the install-launchers request, and returns the outcome for
+ * each launcher. The information in the returned #GVariant has the format
+ * `a(sbs)`, with one item for each launcher, in the order they were passed
+ * to xdp_portal_install_launchers(): the desktop file ID, whether the
+ * launcher was installed, and an error message if it was not.
+ *
+ * Returns: (transfer full): the results
+ */
+GVariant *
+xdp_portal_install_launchers_finish (XdpPortal *portal,
+                                     GAsyncResult *result,
+                                     GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, portal), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * xdp_portal_uninstall_launcher:
+ * @portal: a #XdpPortal
+ * @desktop_file_id: the desktop file ID of the launcher
+ * @error: return location for an error
+ *
+ * Removes a launcher that was installed with xdp_portal_install_launchers().
+ *
+ * Returns: %TRUE if the launcher was removed
+ */
+gboolean
+xdp_portal_uninstall_launcher (XdpPortal *portal,
+                               const char *desktop_file_id,
+                               GError **error)
+{
+  GVariantBuilder options;
+  g_autoptr(GVariant) ret = NULL;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (desktop_file_id != NULL, FALSE);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  ret = g_dbus_connection_call_sync (portal->bus,
+                                     PORTAL_BUS_NAME,
+                                     PORTAL_OBJECT_PATH,
+                                     DYNAMIC_LAUNCHER_INTERFACE,
+                                     "Uninstall",
+                                     g_variant_new ("(sa{sv})", desktop_file_id, &options),
+                                     NULL,
+                                     G_DBUS_CALL_FLAGS_NONE,
+                                     -1,
+                                     NULL,
+                                     error);
+
+  return ret != NULL;
+}
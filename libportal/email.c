@@ -153,7 +153,7 @@ static void
 compose_email (EmailCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   g_autoptr(GUnixFDList) fd_list = NULL;
   GCancellable *cancellable;
 
@@ -163,8 +163,7 @@ compose_email (EmailCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->request_path = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
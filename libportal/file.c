@@ -150,7 +150,7 @@ static void
 open_file (FileCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   GCancellable *cancellable;
 
   if (call->parent_handle == NULL)
@@ -159,8 +159,7 @@ open_file (FileCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->request_path = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "portal-private.h"
+
+/* Identical requests that are in flight at the same time share
+ * one portal request. The first caller starts a flight, and every
+ * caller, including the first, waits for its result. Each caller can
+ * cancel its own wait; the portal request is only closed when nobody
+ * is waiting anymore.
+ */
+
+typedef struct _Flight Flight;
+
+typedef struct {
+  Flight *flight;
+  GTask *task;
+  gulong cancelled_id;
+} Waiter;
+
+struct _Flight {
+  XdpPortal *portal;
+  char *key;
+  GCancellable *cancellable;
+  GList *waiters;
+  GBoxedCopyFunc copy;
+  GDestroyNotify destroy;
+  XdpFlightShareFunc share;
+};
+
+static void
+waiter_free (Waiter *waiter)
+{
+  if (waiter->cancelled_id)
+    g_signal_handler_disconnect (g_task_get_cancellable (waiter->task), waiter->cancelled_id);
+
+  g_object_unref (waiter->task);
+  g_free (waiter);
+}
+
+static void
+flight_land (Flight *flight)
+{
+  /* Later requests start a new flight */
+  if (g_hash_table_lookup (flight->portal->flights, flight->key) == flight)
+    g_hash_table_remove (flight->portal->flights, flight->key);
+}
+
+static void
+flight_free (Flight *flight)
+{
+  g_object_unref (flight->cancellable);
+  g_free (flight->key);
+  g_free (flight);
+}
+
+static void
+waiter_cancelled (GCancellable *cancellable,
+                  gpointer data)
+{
+  Waiter *waiter = data;
+  Flight *flight = waiter->flight;
+
+  flight->waiters = g_list_remove (flight->waiters, waiter);
+
+  g_signal_handler_disconnect (cancellable, waiter->cancelled_id);
+  waiter->cancelled_id = 0;
+
+  g_task_return_new_error (waiter->task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Operation was cancelled");
+  waiter_free (waiter);
+
+  if (flight->waiters == NULL)
+    {
+      flight_land (flight);
+      g_cancellable_cancel (flight->cancellable);
+    }
+}
+
+static void
+flight_done (GObject *source,
+             GAsyncResult *result,
+             gpointer data)
+{
+  Flight *flight = data;
+  g_autoptr(GError) error = NULL;
+  gpointer value;
+  GList *waiters;
+  GList *l;
+
+  value = g_task_propagate_pointer (G_TASK (result), &error);
+
+  flight_land (flight);
+
+  waiters = flight->waiters;
+  flight->waiters = NULL;
+
+  if (value && flight->share)
+    flight->share (flight->portal, value, g_list_length (waiters));
+
+  /* Returning may run callbacks, which must not see half-detached waiters */
+  for (l = waiters; l; l = l->next)
+    {
+      Waiter *waiter = l->data;
+
+      if (waiter->cancelled_id)
+        {
+          g_signal_handler_disconnect (g_task_get_cancellable (waiter->task), waiter->cancelled_id);
+          waiter->cancelled_id = 0;
+        }
+    }
+
+  for (l = waiters; l; l = l->next)
+    {
+      Waiter *waiter = l->data;
+
+      if (error)
+        g_task_return_error (waiter->task, g_error_copy (error));
+      else
+        g_task_return_pointer (waiter->task, flight->copy (value), flight->destroy);
+    }
+
+  g_list_free_full (waiters, (GDestroyNotify) waiter_free);
+
+  if (value)
+    flight->destroy (value);
+
+  flight_free (flight);
+}
+
+/*
+ * _xdp_portal_join_flight:
+ * @portal: a #XdpPortal
+ * @key: identifies the request; requests with the same key
+ *     must be interchangeable
+ * @task: (transfer full): the task of the caller
+ * @copy: copies the result for each caller
+ * @destroy: frees a result
+ * @share: (nullable): called with a successful result and the number
+ *     of callers that receive a copy of it, before they do
+ *
+ * Attaches @task to an in-flight request with the same @key, if
+ * there is one. Otherwise, starts a new flight.
+ *
+ * Returns: (transfer full) (nullable): %NULL if @task joined an existing
+ *     flight, otherwise the task that the caller must use for its request.
+ *     The result of that task must be a pointer that @copy and @destroy
+ *     can handle.
+ */
+GTask *
+_xdp_portal_join_flight (XdpPortal          *portal,
+                         const char         *key,
+                         GTask              *task,
+                         GBoxedCopyFunc      copy,
+                         GDestroyNotify      destroy,
+                         XdpFlightShareFunc  share)
+{
+  GCancellable *cancellable;
+  Flight *flight;
+  Waiter *waiter;
+  GTask *flight_task = NULL;
+
+  /* Nothing to share, let the request fail on its own */
+  cancellable = g_task_get_cancellable (task);
+  if (g_cancellable_is_cancelled (cancellable))
+    return task;
+
+  flight = g_hash_table_lookup (portal->flights, key);
+  if (flight == NULL)
+    {
+      flight = g_new0 (Flight, 1);
+      flight->portal = portal;
+      flight->key = g_strdup (key);
+      flight->cancellable = g_cancellable_new ();
+      flight->copy = copy;
+      flight->destroy = destroy;
+      flight->share = share;
+      g_hash_table_insert (portal->flights, flight->key, flight);
+
+      flight_task = g_task_new (portal, flight->cancellable, flight_done, flight);
+    }
+
+  waiter = g_new0 (Waiter, 1);
+  waiter->flight = flight;
+  waiter->task = task;
+  if (cancellable)
+    waiter->cancelled_id = g_signal_connect (cancellable, "cancelled", G_CALLBACK (waiter_cancelled), waiter);
+
+  flight->waiters = g_list_append (flight->waiters, waiter);
+
+  return flight_task;
+}
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#include <gio/gunixfdlist.h>
+
+#include "portal-private.h"
+
+/**
+ * SECTION:gamemode
+ * @title: GameMode
+ * @short_description: request performance mode
+ *
+ * These functions let applications ask GameMode to apply its
+ * performance optimizations, such as changing the CPU governor,
+ * while they run a demanding workload.
+ *
+ * Registration is reference counted, so independent parts of an
+ * application can each call xdp_portal_gamemode_register() and
+ * xdp_portal_gamemode_unregister(). The process is registered while
+ * at least one registration is held. GameMode drops the registration
+ * of a process when it exits, and libportal releases it when the
+ * #XdpPortal is finalized.
+ *
+ * The process is identified with a pidfd where the kernel supports it,
+ * so that the registration can not be confused with a different process
+ * that reuses the pid.
+ *
+ * The underlying portal is org.freedesktop.portal.GameMode.
+ */
+
+#define GAMEMODE_INTERFACE "org.freedesktop.portal.GameMode"
+
+static int
+open_pidfd (void)
+{
+#ifdef SYS_pidfd_open
+  return syscall (SYS_pidfd_open, getpid (), 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/* Calls @method, or its ByPIDFd variant, for this process. */
+static void
+gamemode_call (XdpPortal *portal,
+               const char *method,
+               GCancellable *cancellable,
+               GAsyncReadyCallback callback,
+               gpointer data)
+{
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  g_autofree char *pidfd_method = NULL;
+  g_autoptr(GError) error = NULL;
+  GVariant *parameters;
+  int pidfd;
+  int fd_in = -1;
+
+  pidfd = open_pidfd ();
+  if (pidfd != -1)
+    {
+      fd_list = g_unix_fd_list_new ();
+      fd_in = g_unix_fd_list_append (fd_list, pidfd, &error);
+      close (pidfd);
+      if (error)
+        {
+          g_warning ("Failed to add pidfd to request: %s", error->message);
+          g_clear_object (&fd_list);
+        }
+    }
+
+  if (fd_list)
+    {
+      /* The pidfd identifies both the game and the requester */
+      pidfd_method = g_strconcat (method, "ByPIDFd", NULL);
+      method = pidfd_method;
+      parameters = g_variant_new ("(hh)", fd_in, fd_in);
+    }
+  else
+    parameters = g_variant_new ("(i)", getpid ());
+
+  g_dbus_connection_call_with_unix_fd_list (portal->bus,
+                                            PORTAL_BUS_NAME,
+                                            PORTAL_OBJECT_PATH,
+                                            GAMEMODE_INTERFACE,
+                                            method,
+                                            parameters,
+                                            G_VARIANT_TYPE ("(i)"),
+                                            G_DBUS_CALL_FLAGS_NONE,
+                                            -1,
+                                            fd_list,
+                                            cancellable,
+                                            callback,
+                                            data);
+}
+
+static gboolean
+gamemode_call_finish (GObject *source,
+                      GAsyncResult *result,
+                      int *status,
+                      GError **error)
+{
+  g_autoptr(GVariant) ret = NULL;
+
+  ret = g_dbus_connection_call_with_unix_fd_list_finish (G_DBUS_CONNECTION (source), NULL, result, error);
+
+  if (ret == NULL)
+    return FALSE;
+
+  g_variant_get (ret, "(i)", status);
+
+  if (*status < 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED, "GameMode rejected the request");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+unregistered (GObject *source,
+              GAsyncResult *result,
+              gpointer data)
+{
+  g_autoptr(GError) error = NULL;
+  int status;
+
+  if (!gamemode_call_finish (source, result, &status, &error))
+    g_warning ("Failed to unregister from GameMode: %s", error->message);
+}
+
+static void
+registered (GObject *source,
+            GAsyncResult *result,
+            gpointer data)
+{
+  XdpPortal *portal = data;
+  g_autoptr(GError) error = NULL;
+  GList *waiters;
+  GList *l;
+  GList *next;
+  int status;
+
+  waiters = portal->gamemode_waiters;
+  portal->gamemode_waiters = NULL;
+
+  /* Cancelled requests give their registration back */
+  for (l = waiters; l; l = next)
+    {
+      next = l->next;
+
+      if (g_task_return_error_if_cancelled (G_TASK (l->data)))
+        {
+          if (portal->gamemode_count > 0)
+            portal->gamemode_count--;
+
+          g_object_unref (l->data);
+          waiters = g_list_delete_link (waiters, l);
+        }
+    }
+
+  if (gamemode_call_finish (source, result, &status, &error))
+    {
+      portal->gamemode_registered = TRUE;
+
+      /* Everybody let go while we were waiting */
+      if (portal->gamemode_count == 0)
+        {
+          portal->gamemode_registered = FALSE;
+          gamemode_call (portal, "UnregisterGame", NULL, unregistered, NULL);
+        }
+
+      for (l = waiters; l; l = l->next)
+        g_task_return_boolean (G_TASK (l->data), TRUE);
+    }
+  else
+    {
+      portal->gamemode_count -= MIN (portal->gamemode_count, g_list_length (waiters));
+
+      for (l = waiters; l; l = l->next)
+        g_task_return_error (G_TASK (l->data), g_error_copy (error));
+    }
+
+  g_list_free_full (waiters, g_object_unref);
+  g_object_unref (portal);
+}
+
+void
+_xdp_portal_release_gamemode (XdpPortal *portal)
+{
+  if (!portal->gamemode_registered)
+    return;
+
+  portal->gamemode_registered = FALSE;
+  portal->gamemode_count = 0;
+  gamemode_call (portal, "UnregisterGame", NULL, unregistered, NULL);
+}
+
+/**
+ * xdp_portal_gamemode_register:
+ * @portal: a #XdpPortal
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Takes a GameMode registration for this process. If the process is
+ * already registered, this only increases the registration count.
+ *
+ * Each successful registration must be released with
+ * xdp_portal_gamemode_unregister(). A registration that fails or
+ * is cancelled through @cancellable is not taken.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_gamemode_register_finish() to get the results.
+ */
+void
+xdp_portal_gamemode_register (XdpPortal *portal,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer data)
+{
+  GTask *task;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  task = g_task_new (portal, cancellable, callback, data);
+
+  /* A registration that was counted must be reported as taken, so
+   * cancellation only counts while it is still pending
+   */
+  g_task_set_check_cancellable (task, FALSE);
+
+  portal->gamemode_count++;
+
+  if (portal->gamemode_registered)
+    {
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  /* Requests that arrive while registering share the result */
+  portal->gamemode_waiters = g_list_append (portal->gamemode_waiters, task);
+  if (portal->gamemode_waiters->next == NULL)
+    gamemode_call (portal, "RegisterGame", NULL, registered, g_object_ref (portal));
+}
+
+/**
+ * xdp_portal_gamemode_register_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the GameMode registration.
+ *
+ * Returns: %TRUE if the process is registered
+ */
+gboolean
+xdp_portal_gamemode_register_finish (XdpPortal *portal,
+                                     GAsyncResult *result,
+                                     GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, portal), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * xdp_portal_gamemode_unregister:
+ * @portal: a #XdpPortal
+ *
+ * Releases a registration that was taken with xdp_portal_gamemode_register().
+ * When the last registration is released, the process is unregistered
+ * from GameMode.
+ */
+void
+xdp_portal_gamemode_unregister (XdpPortal *portal)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  if (portal->gamemode_count == 0)
+    {
+      g_warning ("No GameMode registration to release");
+      return;
+    }
+
+  portal->gamemode_count--;
+
+  /* A pending registration is undone when it completes */
+  if (portal->gamemode_count == 0 && portal->gamemode_registered)
+    {
+      portal->gamemode_registered = FALSE;
+      gamemode_call (portal, "UnregisterGame", NULL, unregistered, NULL);
+    }
+}
+
+static void
+status_received (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  g_autoptr(GTask) task = data;
+  GError *error = NULL;
+  int status;
+
+  if (!gamemode_call_finish (source, result, &status, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_int (task, status);
+}
+
+/**
+ * xdp_portal_gamemode_query_status:
+ * @portal: a #XdpPortal
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Queries whether GameMode is active, and whether this process
+ * is registered.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_gamemode_query_status_finish() to get the results.
+ */
+void
+xdp_portal_gamemode_query_status (XdpPortal *portal,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer data)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  gamemode_call (portal, "QueryStatus", cancellable, status_received,
+                 g_task_new (portal, cancellable, callback, data));
+}
+
+/**
+ * xdp_portal_gamemode_query_status_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the GameMode status query.
+ *
+ * Returns: the GameMode status, or %XDP_GAMEMODE_INACTIVE on error
+ */
+XdpGameModeStatus
+xdp_portal_gamemode_query_status_finish (XdpPortal *portal,
+                                         GAsyncResult *result,
+                                         GError **error)
+{
+  gssize status;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), XDP_GAMEMODE_INACTIVE);
+  g_return_val_if_fail (g_task_is_valid (result, portal), XDP_GAMEMODE_INACTIVE);
+
+  status = g_task_propagate_int (G_TASK (result), error);
+
+  return status < 0 ? XDP_GAMEMODE_INACTIVE : (XdpGameModeStatus) status;
+}
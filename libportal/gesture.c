@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include "portal-private.h"
+#include "session-private.h"
+
+/**
+ * SECTION:gesture
+ * @title: Touch gestures
+ * @short_description: synthesize multi-touch gestures
+ *
+ * These functions let applications play back pinch, rotate and swipe
+ * gestures on the touchscreen of a remote desktop session.
+ *
+ * A gesture is described by an #XdpTouchGesture. The touch points are
+ * interpolated between the start and end parameters over the duration
+ * of the gesture, and the events for all touch points of one frame are
+ * sent together, at a steady frame rate.
+ *
+ * Touch slots for the gesture are allocated automatically, avoiding
+ * slots that are in use by xdp_session_touch_down().
+ */
+
+#define MAX_FINGERS 10
+#define DEFAULT_FINGERS 2
+#define DEFAULT_FRAME_RATE 60
+
+typedef struct {
+  XdpSession *session;
+  XdpTouchGesture gesture;
+  guint slots[MAX_FINGERS];
+  gboolean down;
+  gint64 start_time;
+  guint timeout_id;
+  GTask *task;
+} GestureCall;
+
+static void
+gesture_call_free (GestureCall *call)
+{
+  guint i;
+
+  if (call->timeout_id)
+    g_source_remove (call->timeout_id);
+
+  for (i = 0; i < call->gesture.n_fingers; i++)
+    call->session->touch_slots &= ~(1u << call->slots[i]);
+
+  g_object_unref (call->session);
+  g_object_unref (call->task);
+
+  g_free (call);
+}
+
+static gboolean
+allocate_slots (GestureCall *call)
+{
+  guint slot;
+  guint i;
+
+  for (i = 0, slot = 0; i < call->gesture.n_fingers; i++, slot++)
+    {
+      while (slot < 32 && (call->session->touch_slots & (1u << slot)) != 0)
+        slot++;
+
+      if (slot == 32)
+        {
+          /* Give back what we got so far */
+          while (i > 0)
+            call->session->touch_slots &= ~(1u << call->slots[--i]);
+          return FALSE;
+        }
+
+      call->slots[i] = slot;
+      call->session->touch_slots |= 1u << slot;
+    }
+
+  return TRUE;
+}
+
+static void
+finger_position (const XdpTouchGesture *gesture,
+                 guint finger,
+                 double t,
+                 double *x,
+                 double *y)
+{
+  double radius = gesture->start_radius;
+  double angle = gesture->start_angle;
+  double dx = 0;
+  double dy = 0;
+
+  switch (gesture->type)
+    {
+    case XDP_TOUCH_GESTURE_PINCH:
+      radius += (gesture->end_radius - gesture->start_radius) * t;
+      break;
+    case XDP_TOUCH_GESTURE_ROTATE:
+      angle += (gesture->end_angle - gesture->start_angle) * t;
+      break;
+    case XDP_TOUCH_GESTURE_SWIPE:
+      dx = gesture->dx * t;
+      dy = gesture->dy * t;
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+
+  /* The fingers are spread evenly on a circle around the center */
+  angle += 2 * G_PI * finger / gesture->n_fingers;
+
+  *x = gesture->x + dx + radius * cos (angle);
+  *y = gesture->y + dy + radius * sin (angle);
+}
+
+static void
+send_frame (GestureCall *call,
+            InputEventType type,
+            double t)
+{
+  InputEvent event = { INPUT_TOUCH_MOTION, };
+  guint i;
+
+  /* The events of one frame are sent back to back, so they
+   * reach the compositor together. The gesture does its own
+   * pacing, so it bypasses the jitter buffer.
+   */
+  for (i = 0; i < call->gesture.n_fingers; i++)
+    {
+      event.type = type;
+      event.stream = call->gesture.stream;
+      event.slot = call->slots[i];
+      if (type != INPUT_TOUCH_UP)
+        finger_position (&call->gesture, i, t, &event.x, &event.y);
+
+      _xdp_session_send_input (call->session, &event);
+    }
+}
+
+static gboolean
+gesture_frame (gpointer data)
+{
+  GestureCall *call = data;
+  GCancellable *cancellable;
+  gint64 elapsed;
+  double t;
+
+  if (call->session->state != XDP_SESSION_ACTIVE)
+    {
+      call->timeout_id = 0;
+      g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_CLOSED, "Session closed");
+      gesture_call_free (call);
+      return G_SOURCE_REMOVE;
+    }
+
+  cancellable = g_task_get_cancellable (call->task);
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      call->timeout_id = 0;
+      send_frame (call, INPUT_TOUCH_UP, 1.0);
+      g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Gesture canceled");
+      gesture_call_free (call);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* Positions follow the clock, not the number of frames, so
+   * a late timeout does not slow the gesture down.
+   */
+  elapsed = g_get_monotonic_time () - call->start_time;
+  if (call->gesture.duration > 0)
+    t = MIN ((double) elapsed / (call->gesture.duration * 1000.0), 1.0);
+  else
+    t = 1.0;
+
+  send_frame (call, INPUT_TOUCH_MOTION, t);
+
+  if (t < 1.0)
+    return G_SOURCE_CONTINUE;
+
+  call->timeout_id = 0;
+  send_frame (call, INPUT_TOUCH_UP, 1.0);
+  g_task_return_boolean (call->task, TRUE);
+  gesture_call_free (call);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * xdp_session_touch_gesture:
+ * @session: a #XdpSession
+ * @gesture: the gesture to perform
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the gesture is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Performs a touch gesture.
+ *
+ * If the gesture is cancelled, all its touch points are lifted
+ * at their current position.
+ *
+ * When the gesture is done, @callback will be called. You can then
+ * call xdp_session_touch_gesture_finish() to get the results.
+ *
+ * May only be called on a remote desktop session
+ * with %XDP_DEVICE_TOUCHSCREEN access.
+ */
+void
+xdp_session_touch_gesture (XdpSession *session,
+                           const XdpTouchGesture *gesture,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer data)
+{
+  GestureCall *call;
+  guint frame_rate;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_REMOTE_DESKTOP &&
+                    session->state == XDP_SESSION_ACTIVE &&
+                    ((session->devices & XDP_DEVICE_TOUCHSCREEN) != 0));
+  g_return_if_fail (gesture != NULL);
+  g_return_if_fail (gesture->n_fingers <= MAX_FINGERS);
+
+  call = g_new0 (GestureCall, 1);
+  call->session = g_object_ref (session);
+  call->gesture = *gesture;
+  if (call->gesture.n_fingers == 0)
+    call->gesture.n_fingers = DEFAULT_FINGERS;
+  call->task = g_task_new (session, cancellable, callback, data);
+
+  if (!allocate_slots (call))
+    {
+      call->gesture.n_fingers = 0;
+      g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_BUSY, "No free touch slots");
+      gesture_call_free (call);
+      return;
+    }
+
+  frame_rate = gesture->frame_rate ? gesture->frame_rate : DEFAULT_FRAME_RATE;
+
+  call->start_time = g_get_monotonic_time ();
+  send_frame (call, INPUT_TOUCH_DOWN, 0.0);
+
+  call->timeout_id = g_timeout_add_full (G_PRIORITY_HIGH,
+                                         MAX (1000 / frame_rate, 1),
+                                         gesture_frame,
+                                         call,
+                                         NULL);
+}
+
+/**
+ * xdp_session_touch_gesture_finish:
+ * @session: a #XdpSession
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes a touch gesture.
+ *
+ * Returns: %TRUE if the gesture was performed completely
+ */
+gboolean
+xdp_session_touch_gesture_finish (XdpSession *session,
+                                  GAsyncResult *result,
+                                  GError **error)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, session), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
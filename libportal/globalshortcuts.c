@@ -0,0 +1,515 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "portal-private.h"
+#include "session-private.h"
+#include "utils-private.h"
+
+/**
+ * SECTION:globalshortcuts
+ * @title: Global shortcuts
+ * @short_description: shortcuts that work when the application is not focused
+ *
+ * A global shortcuts session lets an application react to key
+ * combinations regardless of which window has the focus.
+ *
+ * After creating the session with xdp_portal_create_global_shortcuts_session(),
+ * add the shortcuts with xdp_session_add_shortcut(), each with its own
+ * handler, and then bind them all at once with xdp_session_bind_shortcuts().
+ * The user decides which key combinations trigger the shortcuts.
+ *
+ * Handlers are called when a shortcut is pressed and released, with the
+ * timestamp from the compositor.
+ *
+ * The underlying portal is org.freedesktop.portal.GlobalShortcuts.
+ */
+
+#define GLOBAL_SHORTCUTS_INTERFACE "org.freedesktop.portal.GlobalShortcuts"
+
+typedef struct {
+  char *description;
+  char *preferred_trigger;
+  XdpShortcutHandler handler;
+  gpointer data;
+  GDestroyNotify destroy;
+} Shortcut;
+
+static void
+shortcut_free (Shortcut *shortcut)
+{
+  if (shortcut->destroy)
+    shortcut->destroy (shortcut->data);
+
+  g_free (shortcut->description);
+  g_free (shortcut->preferred_trigger);
+
+  g_free (shortcut);
+}
+
+typedef struct {
+  XdpPortal *portal;
+  XdpSession *session;
+  XdpParent *parent;
+  char *parent_handle;
+  char *id;
+  guint signal_id;
+  GTask *task;
+  char *request_path;
+  guint cancelled_id;
+} ShortcutsCall;
+
+static void
+shortcuts_call_free (ShortcutsCall *call)
+{
+  if (call->parent)
+    {
+      call->parent->unexport (call->parent);
+      _xdp_parent_free (call->parent);
+    }
+  g_free (call->parent_handle);
+
+  if (call->signal_id)
+    g_dbus_connection_signal_unsubscribe (call->portal->bus, call->signal_id);
+
+  if (call->cancelled_id)
+    g_signal_handler_disconnect (g_task_get_cancellable (call->task), call->cancelled_id);
+
+  g_free (call->request_path);
+
+  g_object_unref (call->portal);
+  g_clear_object (&call->session);
+  g_object_unref (call->task);
+
+  g_free (call->id);
+
+  g_free (call);
+}
+
+static void
+cancelled_cb (GCancellable *cancellable,
+              gpointer data)
+{
+  ShortcutsCall *call = data;
+
+  g_dbus_connection_call (call->portal->bus,
+                          PORTAL_BUS_NAME,
+                          call->request_path,
+                          REQUEST_INTERFACE,
+                          "Close",
+                          NULL,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+/* Picks the request path for @call, and returns its token,
+ * which points into the path
+ */
+static const char *
+new_request (ShortcutsCall *call)
+{
+  const char *token;
+
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
+
+  return token;
+}
+
+static void
+call_request (ShortcutsCall *call,
+              const char *method,
+              GVariant *parameters,
+              GDBusSignalCallback response)
+{
+  GCancellable *cancellable;
+
+  call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
+                                                        PORTAL_BUS_NAME,
+                                                        REQUEST_INTERFACE,
+                                                        "Response",
+                                                        call->request_path,
+                                                        NULL,
+                                                        G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+                                                        response,
+                                                        call,
+                                                        NULL);
+
+  cancellable = g_task_get_cancellable (call->task);
+  if (cancellable)
+    call->cancelled_id = g_signal_connect (cancellable, "cancelled", G_CALLBACK (cancelled_cb), call);
+
+  g_dbus_connection_call (call->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          GLOBAL_SHORTCUTS_INTERFACE,
+                          method,
+                          parameters,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          cancellable,
+                          NULL,
+                          NULL);
+}
+
+static gboolean
+check_response (ShortcutsCall *call,
+                GVariant *parameters,
+                GVariant **ret)
+{
+  guint32 response;
+
+  g_variant_get (parameters, "(u@a{sv})", &response, ret);
+
+  if (response == 1)
+    g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "GlobalShortcuts canceled");
+  else if (response == 2)
+    g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_FAILED, "GlobalShortcuts failed");
+
+  return response == 0;
+}
+
+static void
+shortcuts_signal (GDBusConnection *bus,
+                  const char *sender_name,
+                  const char *object_path,
+                  const char *interface_name,
+                  const char *signal_name,
+                  GVariant *parameters,
+                  gpointer data)
+{
+  XdpSession *session = data;
+  const char *session_handle;
+  const char *shortcut_id;
+  guint64 timestamp;
+  Shortcut *shortcut;
+
+  if (strcmp (signal_name, "ShortcutsChanged") == 0)
+    {
+      g_autoptr(GVariant) shortcuts = NULL;
+
+      g_variant_get (parameters, "(&o@a(sa{sv}))", &session_handle, &shortcuts);
+      if (g_strcmp0 (session_handle, session->id) == 0)
+        g_signal_emit (session, _xdp_session_signals[SESSION_SHORTCUTS_CHANGED], 0, shortcuts);
+      return;
+    }
+
+  /* Activated and Deactivated share their signature */
+  g_variant_get (parameters, "(&o&st@a{sv})", &session_handle, &shortcut_id, &timestamp, NULL);
+  if (g_strcmp0 (session_handle, session->id) != 0)
+    return;
+
+  shortcut = g_hash_table_lookup (session->shortcuts, shortcut_id);
+  if (shortcut == NULL)
+    return;
+
+  shortcut->handler (session,
+                     shortcut_id,
+                     strcmp (signal_name, "Activated") == 0,
+                     timestamp,
+                     shortcut->data);
+}
+
+static void
+session_created (GDBusConnection *bus,
+                 const char *sender_name,
+                 const char *object_path,
+                 const char *interface_name,
+                 const char *signal_name,
+                 GVariant *parameters,
+                 gpointer data)
+{
+  ShortcutsCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  XdpSession *session;
+
+  if (check_response (call, parameters, &ret))
+    {
+      session = _xdp_session_new (call->portal, call->id, XDP_SESSION_GLOBAL_SHORTCUTS);
+      session->shortcuts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                  g_free, (GDestroyNotify)shortcut_free);
+      session->shortcuts_signal_id =
+          g_dbus_connection_signal_subscribe (call->portal->bus,
+                                              PORTAL_BUS_NAME,
+                                              GLOBAL_SHORTCUTS_INTERFACE,
+                                              NULL,
+                                              PORTAL_OBJECT_PATH,
+                                              NULL,
+                                              G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+                                              shortcuts_signal,
+                                              session,
+                                              NULL);
+
+      /* There is no Start, the session can be used right away */
+      _xdp_session_set_session_state (session, XDP_SESSION_ACTIVE);
+
+      g_task_return_pointer (call->task, session, g_object_unref);
+    }
+
+  shortcuts_call_free (call);
+}
+
+/**
+ * xdp_portal_create_global_shortcuts_session:
+ * @portal: a #XdpPortal
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Creates a session for global shortcuts.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_create_global_shortcuts_session_finish() to get the results.
+ */
+void
+xdp_portal_create_global_shortcuts_session (XdpPortal *portal,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback,
+                                            gpointer data)
+{
+  ShortcutsCall *call;
+  GVariantBuilder options;
+  const char *token;
+  const char *session_token;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  call = g_new0 (ShortcutsCall, 1);
+  call->portal = g_object_ref (portal);
+  call->task = g_task_new (portal, cancellable, callback, data);
+
+  token = new_request (call);
+  call->id = _xdp_portal_new_handle (portal, SESSION_PATH_PREFIX, &session_token);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
+  g_variant_builder_add (&options, "{sv}", "session_handle_token", g_variant_new_string (session_token));
+
+  call_request (call, "CreateSession", g_variant_new ("(a{sv})", &options), session_created);
+}
+
+/**
+ * xdp_portal_create_global_shortcuts_session_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the create-global-shortcuts request, and returns an #XdpSession.
+ *
+ * Returns: (transfer full): a #XdpSession
+ */
+XdpSession *
+xdp_portal_create_global_shortcuts_session_finish (XdpPortal *portal,
+                                                   GAsyncResult *result,
+                                                   GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, portal), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * xdp_session_add_shortcut:
+ * @session: a global shortcuts #XdpSession
+ * @id: the ID of the shortcut
+ * @description: user-visible description of the shortcut
+ * @preferred_trigger: (nullable): the preferred key combination, such
+ *     as "CTRL+ALT+a", or %NULL
+ * @handler: (scope notified): the function to call when the shortcut is
+ *     pressed or released
+ * @data: (closure): data to pass to @handler
+ * @destroy: (nullable): function to free @data
+ *
+ * Adds a shortcut to @session. The shortcut is bound to a key
+ * combination with the next call to xdp_session_bind_shortcuts().
+ *
+ * Adding a shortcut with an ID that already exists replaces it.
+ */
+void
+xdp_session_add_shortcut (XdpSession *session,
+                          const char *id,
+                          const char *description,
+                          const char *preferred_trigger,
+                          XdpShortcutHandler handler,
+                          gpointer data,
+                          GDestroyNotify destroy)
+{
+  Shortcut *shortcut;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_GLOBAL_SHORTCUTS);
+  g_return_if_fail (id != NULL);
+  g_return_if_fail (description != NULL);
+  g_return_if_fail (handler != NULL);
+
+  shortcut = g_new0 (Shortcut, 1);
+  shortcut->description = g_strdup (description);
+  shortcut->preferred_trigger = g_strdup (preferred_trigger);
+  shortcut->handler = handler;
+  shortcut->data = data;
+  shortcut->destroy = destroy;
+
+  g_hash_table_replace (session->shortcuts, g_strdup (id), shortcut);
+}
+
+static void
+shortcuts_bound (GDBusConnection *bus,
+                 const char *sender_name,
+                 const char *object_path,
+                 const char *interface_name,
+                 const char *signal_name,
+                 GVariant *parameters,
+                 gpointer data)
+{
+  ShortcutsCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  GVariant *shortcuts;
+
+  if (check_response (call, parameters, &ret))
+    {
+      if (!g_variant_lookup (ret, "shortcuts", "@a(sa{sv})", &shortcuts))
+        shortcuts = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("(sa{sv})"), NULL, 0));
+
+      g_task_return_pointer (call->task, shortcuts, (GDestroyNotify) g_variant_unref);
+    }
+
+  shortcuts_call_free (call);
+}
+
+static void bind_shortcuts (ShortcutsCall *call);
+
+static void
+parent_exported (XdpParent *parent,
+                 const char *handle,
+                 gpointer data)
+{
+  ShortcutsCall *call = data;
+  call->parent_handle = g_strdup (handle);
+  bind_shortcuts (call);
+}
+
+static void
+bind_shortcuts (ShortcutsCall *call)
+{
+  GVariantBuilder options;
+  GVariantBuilder list;
+  GHashTableIter iter;
+  const char *id;
+  Shortcut *shortcut;
+  const char *token;
+
+  if (call->parent_handle == NULL)
+    {
+      call->parent->export (call->parent, parent_exported, call);
+      return;
+    }
+
+  token = new_request (call);
+
+  /* All shortcuts go into one request */
+  g_variant_builder_init (&list, G_VARIANT_TYPE ("a(sa{sv})"));
+  g_hash_table_iter_init (&iter, call->session->shortcuts);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&id, (gpointer *)&shortcut))
+    {
+      g_variant_builder_open (&list, G_VARIANT_TYPE ("(sa{sv})"));
+      g_variant_builder_add (&list, "s", id);
+      g_variant_builder_open (&list, G_VARIANT_TYPE_VARDICT);
+      g_variant_builder_add (&list, "{sv}", "description", g_variant_new_string (shortcut->description));
+      if (shortcut->preferred_trigger)
+        g_variant_builder_add (&list, "{sv}", "preferred_trigger", g_variant_new_string (shortcut->preferred_trigger));
+      g_variant_builder_close (&list);
+      g_variant_builder_close (&list);
+    }
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
+
+  call_request (call, "BindShortcuts",
+                g_variant_new ("(oa(sa{sv})sa{sv})",
+                               call->session->id, &list, call->parent_handle, &options),
+                shortcuts_bound);
+}
+
+/**
+ * xdp_session_bind_shortcuts:
+ * @session: a global shortcuts #XdpSession
+ * @parent: (nullable): parent window information
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Binds all shortcuts that have been added with xdp_session_add_shortcut()
+ * in a single request. The user may be asked to assign key combinations.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_session_bind_shortcuts_finish() to get the results.
+ */
+void
+xdp_session_bind_shortcuts (XdpSession *session,
+                            XdpParent *parent,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer data)
+{
+  ShortcutsCall *call;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_GLOBAL_SHORTCUTS &&
+                    session->state == XDP_SESSION_ACTIVE);
+
+  call = g_new0 (ShortcutsCall, 1);
+  call->portal = g_object_ref (session->portal);
+  call->session = g_object_ref (session);
+  if (parent)
+    call->parent = _xdp_parent_copy (parent);
+  else
+    call->parent_handle = g_strdup ("");
+  call->task = g_task_new (session, cancellable, callback, data);
+
+  bind_shortcuts (call);
+}
+
+/**
+ * xdp_session_bind_shortcuts_finish:
+ * @session: a global shortcuts #XdpSession
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the bind-shortcuts request, and returns the shortcuts that
+ * were bound. The information in the returned #GVariant has the format
+ * `a(sa{sv})`. Each item has the ID of a shortcut, and a dictionary
+ * that contains the description and, in `trigger_description`,
+ * a user-visible description of the key combination.
+ *
+ * Returns: (transfer full): the bound shortcuts
+ */
+GVariant *
+xdp_session_bind_shortcuts_finish (XdpSession *session,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, session), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -29,9 +29,15 @@
  * A typical use for this functionality is to prevent the session from
  * locking while a video is playing.
  *
+ * Instead of managing inhibitors by ID, an inhibitor can be tied to the
+ * lifetime of an object with xdp_portal_inhibit_for_object(), or to an
+ * operation with xdp_portal_inhibit_for_cancellable().
+ *
  * The underlying portal is org.freedesktop.portal.Inhibit.
  */
 
+typedef struct _ScopedInhibit ScopedInhibit;
+
 typedef struct {
   XdpPortal *portal;
   XdpParent *parent;
@@ -39,9 +45,22 @@ typedef struct {
   XdpInhibitFlags inhibit;
   char *reason;
   char *id;
+  ScopedInhibit *scoped;
+  gboolean released;
   guint signal_id; 
 } InhibitCall;
 
+struct _ScopedInhibit {
+  XdpPortal *portal;
+  GObject *scope;
+  gulong cancelled_id;
+  InhibitCall *call;
+  char *handle;
+};
+
+static void release_scoped_inhibit (ScopedInhibit *scoped,
+                                    gboolean finalizing);
+
 static void
 inhibit_call_free (InhibitCall *call)
 {
@@ -55,6 +74,9 @@ inhibit_call_free (InhibitCall *call)
  if (call->signal_id)
    g_dbus_connection_signal_unsubscribe (call->portal->bus, call->signal_id);
 
+  if (call->scoped)
+    call->scoped->call = NULL;
+
   g_object_unref (call->portal);
 
   g_free (call->reason);
@@ -84,7 +106,19 @@ response_received (GDBusConnection *bus,
     g_warning ("Inhibit failed");
 
   if (response != 0)
-    g_hash_table_remove (call->portal->inhibit_handles, call->id);
+    {
+      /* A scoped call has no id, and loses its scope when the
+       * scope goes away before the response arrives.
+       */
+      if (call->scoped)
+        {
+          /* There is nothing to close */
+          g_clear_pointer (&call->scoped->handle, g_free);
+          release_scoped_inhibit (call->scoped, FALSE);
+        }
+      else if (call->id)
+        g_hash_table_remove (call->portal->inhibit_handles, call->id);
+    }
 
   inhibit_call_free (call);
 }
@@ -105,8 +139,15 @@ static void
 do_inhibit (InhibitCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
-  g_autofree char *handle = NULL;
+  const char *token;
+  char *handle;
+
+  /* The scope went away while the parent was exported */
+  if (call->released)
+    {
+      inhibit_call_free (call);
+      return;
+    }
 
   if (call->parent_handle == NULL)
     {
@@ -114,8 +155,7 @@ do_inhibit (InhibitCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  handle = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  handle = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -127,9 +167,16 @@ do_inhibit (InhibitCall *call)
                                                         call,
                                                         NULL);
 
-  g_hash_table_insert (call->portal->inhibit_handles,
-                       g_strdup (call->id),
-                       g_strdup (handle));
+  /* The handle is needed to close the request later, so it is
+   * kept anyway. It is handed over instead of copied, and the token,
+   * which points into it, stays valid.
+   */
+  if (call->scoped)
+    call->scoped->handle = handle;
+  else
+    g_hash_table_insert (call->portal->inhibit_handles,
+                         g_strdup (call->id),
+                         handle);
 
   g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
   g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
@@ -147,6 +194,22 @@ do_inhibit (InhibitCall *call)
                           NULL, NULL, NULL);
 }
 
+static void
+close_inhibit_request (XdpPortal *portal,
+                       const char *handle)
+{
+  g_dbus_connection_call (portal->bus,
+                          PORTAL_BUS_NAME,
+                          handle,
+                          REQUEST_INTERFACE,
+                          "Close",
+                          g_variant_new ("()"),
+                          G_VARIANT_TYPE_UNIT,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          G_MAXINT,
+                          NULL, NULL, NULL);
+}
+
 /**
  * xdp_portal_inhibit:
  * @portal: a #XdpPortal
@@ -221,14 +284,167 @@ xdp_portal_uninhibit (XdpPortal *portal,
       return;
     }
 
-  g_dbus_connection_call (portal->bus,
-                          PORTAL_BUS_NAME,
-                          value,
-                          REQUEST_INTERFACE,
-                          "Close",
-                          g_variant_new ("()"),
-                          G_VARIANT_TYPE_UNIT,
-                          G_DBUS_CALL_FLAGS_NONE,
-                          G_MAXINT,
-                          NULL, NULL, NULL);
+  close_inhibit_request (portal, value);
+}
+
+static void
+scope_finalized (gpointer data,
+                 GObject *where_the_object_was)
+{
+  release_scoped_inhibit ((ScopedInhibit *)data, TRUE);
+}
+
+static void
+scope_cancelled (GCancellable *cancellable,
+                 gpointer data)
+{
+  release_scoped_inhibit ((ScopedInhibit *)data, FALSE);
+}
+
+static void
+release_scoped_inhibit (ScopedInhibit *scoped,
+                        gboolean finalizing)
+{
+  g_hash_table_remove (scoped->portal->scoped_inhibits, scoped->scope);
+
+  /* Signal handlers are already gone when weak references are notified */
+  if (!finalizing)
+    {
+      if (scoped->cancelled_id)
+        g_signal_handler_disconnect (scoped->scope, scoped->cancelled_id);
+      g_object_weak_unref (scoped->scope, scope_finalized, scoped);
+    }
+
+  if (scoped->call)
+    {
+      /* Inhibit has not been called yet, so don't */
+      if (scoped->handle == NULL)
+        scoped->call->released = TRUE;
+      scoped->call->scoped = NULL;
+    }
+
+  if (scoped->handle)
+    close_inhibit_request (scoped->portal, scoped->handle);
+
+  g_free (scoped->handle);
+  g_free (scoped);
+}
+
+void
+_xdp_portal_release_scoped_inhibits (XdpPortal *portal)
+{
+  GHashTableIter iter;
+  ScopedInhibit *scoped;
+
+  if (portal->scoped_inhibits == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, portal->scoped_inhibits);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&scoped))
+    {
+      g_hash_table_iter_steal (&iter);
+      release_scoped_inhibit (scoped, FALSE);
+    }
+
+  g_clear_pointer (&portal->scoped_inhibits, g_hash_table_unref);
+}
+
+static void
+inhibit_scoped (XdpPortal *portal,
+                XdpParent *parent,
+                XdpInhibitFlags inhibit,
+                const char *reason,
+                GObject *scope)
+{
+  ScopedInhibit *scoped;
+  InhibitCall *call;
+
+  if (portal->scoped_inhibits == NULL)
+    portal->scoped_inhibits = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  if (g_hash_table_contains (portal->scoped_inhibits, scope))
+    {
+      g_warning ("Duplicate Inhibit scope: %p", scope);
+      return;
+    }
+
+  scoped = g_new0 (ScopedInhibit, 1);
+  scoped->portal = portal;
+  scoped->scope = scope;
+  g_object_weak_ref (scope, scope_finalized, scoped);
+  g_hash_table_insert (portal->scoped_inhibits, scope, scoped);
+
+  call = g_new0 (InhibitCall, 1);
+  call->portal = g_object_ref (portal);
+  if (parent)
+    call->parent = _xdp_parent_copy (parent);
+  else
+    call->parent_handle = g_strdup ("");
+  call->inhibit = inhibit;
+  call->reason = g_strdup (reason);
+  call->scoped = scoped;
+  scoped->call = call;
+
+  if (G_IS_CANCELLABLE (scope))
+    scoped->cancelled_id = g_signal_connect (scope, "cancelled", G_CALLBACK (scope_cancelled), scoped);
+
+  do_inhibit (call);
+}
+
+/**
+ * xdp_portal_inhibit_for_object:
+ * @portal: a #XdpPortal
+ * @parent: (nullable): parent window information
+ * @inhibit: information about what to inhibit
+ * @reason: (nullable): user-visible reason for the inhibition
+ * @object: (type GObject): the object that scopes the inhibition
+ *
+ * Inhibits various session status changes for as long as @object
+ * is alive. The inhibitor is removed when @object is finalized.
+ *
+ * There can only be one inhibitor for each object.
+ */
+void
+xdp_portal_inhibit_for_object (XdpPortal *portal,
+                               XdpParent *parent,
+                               XdpInhibitFlags inhibit,
+                               const char *reason,
+                               gpointer object)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (G_IS_OBJECT (object));
+
+  inhibit_scoped (portal, parent, inhibit, reason, G_OBJECT (object));
+}
+
+/**
+ * xdp_portal_inhibit_for_cancellable:
+ * @portal: a #XdpPortal
+ * @parent: (nullable): parent window information
+ * @inhibit: information about what to inhibit
+ * @reason: (nullable): user-visible reason for the inhibition
+ * @cancellable: the #GCancellable of the operation that needs the inhibition
+ *
+ * Inhibits various session status changes while an operation is running.
+ * The inhibitor is removed when @cancellable is cancelled or finalized,
+ * whichever comes first.
+ *
+ * If @cancellable is already cancelled, nothing is inhibited.
+ *
+ * @cancellable must be cancelled in the thread that uses @portal.
+ */
+void
+xdp_portal_inhibit_for_cancellable (XdpPortal *portal,
+                                    XdpParent *parent,
+                                    XdpInhibitFlags inhibit,
+                                    const char *reason,
+                                    GCancellable *cancellable)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (G_IS_CANCELLABLE (cancellable));
+
+  if (g_cancellable_is_cancelled (cancellable))
+    return;
+
+  inhibit_scoped (portal, parent, inhibit, reason, G_OBJECT (cancellable));
 }
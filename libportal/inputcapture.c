@@ -0,0 +1,749 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gunixfdlist.h>
+
+#include "portal-private.h"
+#include "session-private.h"
+#include "utils-private.h"
+
+/**
+ * SECTION:inputcapture
+ * @title: Input capture
+ * @short_description: capture input at pointer barriers
+ *
+ * An input capture session lets an application take over the local
+ * input devices when the pointer crosses a barrier at the edge of the
+ * screen, for example to forward input to a different machine.
+ *
+ * After creating the session with xdp_portal_create_input_capture_session(),
+ * the zones of the screen are available with xdp_session_get_zones(), and
+ * barriers along their edges can be set up with
+ * xdp_session_set_pointer_barriers(). When capture is enabled with
+ * xdp_session_enable_input_capture() and the pointer hits a barrier, the
+ * #XdpSession::activated signal is emitted, and the input events can be
+ * read from the EIS socket returned by xdp_session_connect_to_eis().
+ *
+ * The zones are kept up to date; when they change, the barriers have to
+ * be set up again, and #XdpSession::zones-changed is emitted.
+ *
+ * The underlying portal is org.freedesktop.portal.InputCapture.
+ */
+
+#define INPUT_CAPTURE_INTERFACE "org.freedesktop.portal.InputCapture"
+
+typedef struct {
+  XdpPortal *portal;
+  XdpParent *parent;
+  char *parent_handle;
+  XdpInputCapability capabilities;
+  char *id;
+  XdpSession *session;
+  guint signal_id;
+  GTask *task;
+  char *request_path;
+  guint cancelled_id;
+  gboolean creating;
+} InputCaptureCall;
+
+static void
+input_capture_call_free (InputCaptureCall *call)
+{
+  if (call->parent)
+    {
+      call->parent->unexport (call->parent);
+      _xdp_parent_free (call->parent);
+    }
+  g_free (call->parent_handle);
+
+  if (call->signal_id)
+    g_dbus_connection_signal_unsubscribe (call->portal->bus, call->signal_id);
+
+  if (call->cancelled_id)
+    g_signal_handler_disconnect (g_task_get_cancellable (call->task), call->cancelled_id);
+
+  g_free (call->request_path);
+
+  g_object_unref (call->portal);
+  g_clear_object (&call->session);
+  g_object_unref (call->task);
+
+  g_free (call->id);
+
+  g_free (call);
+}
+
+static void
+cancelled_cb (GCancellable *cancellable,
+              gpointer data)
+{
+  InputCaptureCall *call = data;
+
+  g_dbus_connection_call (call->portal->bus,
+                          PORTAL_BUS_NAME,
+                          call->request_path,
+                          REQUEST_INTERFACE,
+                          "Close",
+                          NULL,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+/* Picks the request path for the next request of @call, and returns
+ * its token, which points into the path
+ */
+static const char *
+new_request (InputCaptureCall *call)
+{
+  const char *token;
+
+  g_clear_pointer (&call->request_path, g_free);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
+
+  return token;
+}
+
+/* Makes a portal request for @call on the path from new_request(),
+ * and calls @response when it is done
+ */
+static void
+call_request (InputCaptureCall *call,
+              const char *method,
+              GVariant *parameters,
+              GDBusSignalCallback response)
+{
+  GCancellable *cancellable;
+
+  call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
+                                                        PORTAL_BUS_NAME,
+                                                        REQUEST_INTERFACE,
+                                                        "Response",
+                                                        call->request_path,
+                                                        NULL,
+                                                        G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+                                                        response,
+                                                        call,
+                                                        NULL);
+
+  cancellable = g_task_get_cancellable (call->task);
+  if (cancellable && call->cancelled_id == 0)
+    call->cancelled_id = g_signal_connect (cancellable, "cancelled", G_CALLBACK (cancelled_cb), call);
+
+  g_dbus_connection_call (call->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          INPUT_CAPTURE_INTERFACE,
+                          method,
+                          parameters,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          cancellable,
+                          NULL,
+                          NULL);
+}
+
+static gboolean
+check_response (InputCaptureCall *call,
+                GVariant *parameters,
+                GVariant **ret)
+{
+  guint32 response;
+
+  g_dbus_connection_signal_unsubscribe (call->portal->bus, call->signal_id);
+  call->signal_id = 0;
+
+  g_variant_get (parameters, "(u@a{sv})", &response, ret);
+
+  if (response == 1)
+    g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "InputCapture canceled");
+  else if (response == 2)
+    g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_FAILED, "InputCapture failed");
+
+  return response == 0;
+}
+
+static void
+zones_received (GDBusConnection *bus,
+                const char *sender_name,
+                const char *object_path,
+                const char *interface_name,
+                const char *signal_name,
+                GVariant *parameters,
+                gpointer data)
+{
+  InputCaptureCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  GVariant *zones;
+  guint32 zone_set;
+
+  if (check_response (call, parameters, &ret))
+    {
+      if (g_variant_lookup (ret, "zones", "@a(uuii)", &zones))
+        {
+          g_clear_pointer (&call->session->zones, g_variant_unref);
+          call->session->zones = zones;
+        }
+      if (g_variant_lookup (ret, "zone_set", "u", &zone_set))
+        call->session->zone_set = zone_set;
+
+      g_task_return_pointer (call->task, g_object_ref (call->session), g_object_unref);
+    }
+  else if (call->creating)
+    {
+      /* The portal session exists already, but nobody gets to use it.
+       * A failed refresh keeps the old zones instead.
+       */
+      xdp_session_close (call->session);
+    }
+
+  input_capture_call_free (call);
+}
+
+static void
+get_zones (InputCaptureCall *call)
+{
+  GVariantBuilder options;
+  const char *token;
+
+  token = new_request (call);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
+
+  call_request (call, "GetZones",
+                g_variant_new ("(oa{sv})", call->session->id, &options),
+                zones_received);
+}
+
+static void
+input_capture_signal (GDBusConnection *bus,
+                      const char *sender_name,
+                      const char *object_path,
+                      const char *interface_name,
+                      const char *signal_name,
+                      GVariant *parameters,
+                      gpointer data)
+{
+  XdpSession *session = data;
+  g_autoptr(GVariant) options = NULL;
+  const char *session_handle;
+  guint32 activation_id = 0;
+  guint32 barrier_id = 0;
+  double x = 0;
+  double y = 0;
+
+  g_variant_get (parameters, "(&o@a{sv})", &session_handle, &options);
+  if (g_strcmp0 (session_handle, session->id) != 0)
+    return;
+
+  /* Activation is the hot path, check for it first */
+  if (strcmp (signal_name, "Activated") == 0)
+    {
+      g_variant_lookup (options, "activation_id", "u", &activation_id);
+      g_variant_lookup (options, "barrier_id", "u", &barrier_id);
+      g_variant_lookup (options, "cursor_position", "(dd)", &x, &y);
+      session->activation_id = activation_id;
+      g_signal_emit (session, _xdp_session_signals[SESSION_ACTIVATED], 0, activation_id, barrier_id, x, y);
+    }
+  else if (strcmp (signal_name, "Deactivated") == 0)
+    {
+      g_variant_lookup (options, "activation_id", "u", &activation_id);
+      g_variant_lookup (options, "cursor_position", "(dd)", &x, &y);
+      g_signal_emit (session, _xdp_session_signals[SESSION_DEACTIVATED], 0, activation_id, x, y);
+    }
+  else if (strcmp (signal_name, "Disabled") == 0)
+    {
+      g_signal_emit (session, _xdp_session_signals[SESSION_DISABLED], 0);
+    }
+  else if (strcmp (signal_name, "ZonesChanged") == 0)
+    {
+      guint32 zone_set;
+
+      /* Only refresh for zone sets newer than ours */
+      if (g_variant_lookup (options, "zone_set", "u", &zone_set) &&
+          zone_set < session->zone_set)
+        return;
+
+      _xdp_session_refresh_zones (session);
+    }
+}
+
+void
+_xdp_session_subscribe_input_capture (XdpSession *session)
+{
+  if (session->input_capture_signal_id)
+    g_dbus_connection_signal_unsubscribe (session->portal->bus, session->input_capture_signal_id);
+
+  /* One subscription for all signals of the session, instead of one per signal */
+  session->input_capture_signal_id = g_dbus_connection_signal_subscribe (session->portal->bus,
+                                                                         PORTAL_BUS_NAME,
+                                                                         INPUT_CAPTURE_INTERFACE,
+                                                                         NULL,
+                                                                         PORTAL_OBJECT_PATH,
+                                                                         NULL,
+                                                                         G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+                                                                         input_capture_signal,
+                                                                         session,
+                                                                         NULL);
+}
+
+static void
+zones_refreshed (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  g_autoptr(XdpSession) session = NULL;
+  g_autoptr(GError) error = NULL;
+
+  session = g_task_propagate_pointer (G_TASK (result), &error);
+  if (session == NULL)
+    {
+      g_warning ("Failed to get input capture zones: %s", error->message);
+      return;
+    }
+
+  g_signal_emit (session, _xdp_session_signals[SESSION_ZONES_CHANGED], 0);
+}
+
+void
+_xdp_session_refresh_zones (XdpSession *session)
+{
+  InputCaptureCall *call;
+
+  call = g_new0 (InputCaptureCall, 1);
+  call->portal = g_object_ref (session->portal);
+  call->session = g_object_ref (session);
+  call->task = g_task_new (session->portal, NULL, zones_refreshed, NULL);
+
+  get_zones (call);
+}
+
+static void
+session_created (GDBusConnection *bus,
+                 const char *sender_name,
+                 const char *object_path,
+                 const char *interface_name,
+                 const char *signal_name,
+                 GVariant *parameters,
+                 gpointer data)
+{
+  InputCaptureCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  guint32 capabilities = 0;
+
+  if (!check_response (call, parameters, &ret))
+    {
+      input_capture_call_free (call);
+      return;
+    }
+
+  g_variant_lookup (ret, "capabilities", "u", &capabilities);
+
+  call->session = _xdp_session_new (call->portal, call->id, XDP_SESSION_INPUT_CAPTURE);
+
+  call->session->capabilities = capabilities;
+  _xdp_session_subscribe_input_capture (call->session);
+
+  /* There is no Start, the session can be used right away */
+  _xdp_session_set_session_state (call->session, XDP_SESSION_ACTIVE);
+
+  get_zones (call);
+}
+
+static void create_session (InputCaptureCall *call);
+
+static void
+parent_exported (XdpParent *parent,
+                 const char *handle,
+                 gpointer data)
+{
+  InputCaptureCall *call = data;
+  call->parent_handle = g_strdup (handle);
+  create_session (call);
+}
+
+static void
+create_session (InputCaptureCall *call)
+{
+  GVariantBuilder options;
+  const char *token;
+  const char *session_token;
+
+  if (call->parent_handle == NULL)
+    {
+      call->parent->export (call->parent, parent_exported, call);
+      return;
+    }
+
+  token = new_request (call);
+  call->id = _xdp_portal_new_handle (call->portal, SESSION_PATH_PREFIX, &session_token);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
+  g_variant_builder_add (&options, "{sv}", "session_handle_token", g_variant_new_string (session_token));
+  g_variant_builder_add (&options, "{sv}", "capabilities", g_variant_new_uint32 (call->capabilities));
+
+  call_request (call, "CreateSession",
+                g_variant_new ("(sa{sv})", call->parent_handle, &options),
+                session_created);
+}
+
+/**
+ * xdp_portal_create_input_capture_session:
+ * @portal: a #XdpPortal
+ * @parent: (nullable): parent window information
+ * @capabilities: which kinds of input devices to capture
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Creates a session for input capture.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_create_input_capture_session_finish() to get the results.
+ */
+void
+xdp_portal_create_input_capture_session (XdpPortal *portal,
+                                         XdpParent *parent,
+                                         XdpInputCapability capabilities,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer data)
+{
+  InputCaptureCall *call;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  call = g_new0 (InputCaptureCall, 1);
+  call->portal = g_object_ref (portal);
+  if (parent)
+    call->parent = _xdp_parent_copy (parent);
+  else
+    call->parent_handle = g_strdup ("");
+  call->capabilities = capabilities;
+  call->creating = TRUE;
+  call->task = g_task_new (portal, cancellable, callback, data);
+
+  create_session (call);
+}
+
+/**
+ * xdp_portal_create_input_capture_session_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the create-input-capture request, and returns an #XdpSession.
+ *
+ * Returns: (transfer full): a #XdpSession
+ */
+XdpSession *
+xdp_portal_create_input_capture_session_finish (XdpPortal *portal,
+                                                GAsyncResult *result,
+                                                GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, portal), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * xdp_session_get_capabilities:
+ * @session: an input capture #XdpSession
+ *
+ * Obtains the kinds of input devices that the session captures.
+ *
+ * Returns: the capabilities of @session
+ */
+XdpInputCapability
+xdp_session_get_capabilities (XdpSession *session)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), 0);
+
+  return session->capabilities;
+}
+
+/**
+ * xdp_session_get_zones:
+ * @session: an input capture #XdpSession
+ *
+ * Obtains the current zones of the session. The information in the
+ * returned #GVariant has the format `a(uuii)`. Each item describes a
+ * zone by its width, height and the x and y position of its top left
+ * corner.
+ *
+ * Returns: (transfer none): the zones of @session
+ */
+GVariant *
+xdp_session_get_zones (XdpSession *session)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), NULL);
+
+  return session->zones;
+}
+
+static void
+barriers_set (GDBusConnection *bus,
+              const char *sender_name,
+              const char *object_path,
+              const char *interface_name,
+              const char *signal_name,
+              GVariant *parameters,
+              gpointer data)
+{
+  InputCaptureCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  GVariant *failed;
+
+  if (check_response (call, parameters, &ret))
+    {
+      if (!g_variant_lookup (ret, "failed_barriers", "@au", &failed))
+        failed = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE_UINT32, NULL, 0));
+
+      g_task_return_pointer (call->task, failed, (GDestroyNotify) g_variant_unref);
+    }
+
+  input_capture_call_free (call);
+}
+
+/**
+ * xdp_session_set_pointer_barriers:
+ * @session: an input capture #XdpSession
+ * @barriers: (array length=n_barriers): the barriers to set up
+ * @n_barriers: the number of barriers
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Replaces the pointer barriers of the session. Barriers must be
+ * horizontal or vertical lines along the edges of the current zones.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_session_set_pointer_barriers_finish() to get the results.
+ */
+void
+xdp_session_set_pointer_barriers (XdpSession *session,
+                                  const XdpPointerBarrier *barriers,
+                                  gsize n_barriers,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer data)
+{
+  InputCaptureCall *call;
+  GVariantBuilder options;
+  GVariantBuilder list;
+  const char *token;
+  gsize i;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_INPUT_CAPTURE &&
+                    session->state == XDP_SESSION_ACTIVE);
+  g_return_if_fail (barriers != NULL || n_barriers == 0);
+
+  call = g_new0 (InputCaptureCall, 1);
+  call->portal = g_object_ref (session->portal);
+  call->session = g_object_ref (session);
+  call->task = g_task_new (session, cancellable, callback, data);
+
+  token = new_request (call);
+
+  g_variant_builder_init (&list, G_VARIANT_TYPE ("aa{sv}"));
+  for (i = 0; i < n_barriers; i++)
+    {
+      g_variant_builder_open (&list, G_VARIANT_TYPE_VARDICT);
+      g_variant_builder_add (&list, "{sv}", "barrier_id", g_variant_new_uint32 (barriers[i].id));
+      g_variant_builder_add (&list, "{sv}", "position",
+                             g_variant_new ("(iiii)",
+                                            barriers[i].x1, barriers[i].y1,
+                                            barriers[i].x2, barriers[i].y2));
+      g_variant_builder_close (&list);
+    }
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
+
+  call_request (call, "SetPointerBarriers",
+                g_variant_new ("(oa{sv}aa{sv}u)", session->id, &options, &list, session->zone_set),
+                barriers_set);
+}
+
+/**
+ * xdp_session_set_pointer_barriers_finish:
+ * @session: an input capture #XdpSession
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the set-pointer-barriers request, and returns the IDs
+ * of the barriers that could not be set up, as a #GVariant of
+ * type `au`.
+ *
+ * Returns: (transfer full): the failed barriers
+ */
+GVariant *
+xdp_session_set_pointer_barriers_finish (XdpSession *session,
+                                         GAsyncResult *result,
+                                         GError **error)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, session), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+call_session_method (XdpSession *session,
+                     const char *method,
+                     GVariantBuilder *options)
+{
+  g_dbus_connection_call (session->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          INPUT_CAPTURE_INTERFACE,
+                          method,
+                          g_variant_new ("(oa{sv})", session->id, options),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          NULL, NULL, NULL);
+}
+
+/**
+ * xdp_session_enable_input_capture:
+ * @session: an input capture #XdpSession
+ *
+ * Enables input capture. Input is captured when the pointer
+ * hits one of the barriers.
+ */
+void
+xdp_session_enable_input_capture (XdpSession *session)
+{
+  GVariantBuilder options;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_INPUT_CAPTURE &&
+                    session->state == XDP_SESSION_ACTIVE);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  call_session_method (session, "Enable", &options);
+}
+
+/**
+ * xdp_session_disable_input_capture:
+ * @session: an input capture #XdpSession
+ *
+ * Disables input capture. If input is currently captured, it is released.
+ */
+void
+xdp_session_disable_input_capture (XdpSession *session)
+{
+  GVariantBuilder options;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_INPUT_CAPTURE &&
+                    session->state == XDP_SESSION_ACTIVE);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  call_session_method (session, "Disable", &options);
+}
+
+/**
+ * xdp_session_release_input_capture:
+ * @session: an input capture #XdpSession
+ * @activation_id: the activation ID from #XdpSession::activated, or 0
+ *     for the most recent activation
+ * @set_position: whether to move the pointer
+ * @x: the x coordinate to move the pointer to
+ * @y: the y coordinate to move the pointer to
+ *
+ * Gives input back to the compositor, and optionally warps the
+ * pointer to a new position. Capture stays enabled.
+ */
+void
+xdp_session_release_input_capture (XdpSession *session,
+                                   guint activation_id,
+                                   gboolean set_position,
+                                   double x,
+                                   double y)
+{
+  GVariantBuilder options;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_INPUT_CAPTURE &&
+                    session->state == XDP_SESSION_ACTIVE);
+
+  if (activation_id == 0)
+    activation_id = session->activation_id;
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&options, "{sv}", "activation_id", g_variant_new_uint32 (activation_id));
+  if (set_position)
+    g_variant_builder_add (&options, "{sv}", "cursor_position", g_variant_new ("(dd)", x, y));
+  call_session_method (session, "Release", &options);
+}
+
+/**
+ * xdp_session_connect_to_eis:
+ * @session: an input capture #XdpSession
+ * @error: return location for an error
+ *
+ * Opens a file descriptor to the EIS server that delivers the
+ * captured input events. The file descriptor should be passed
+ * to a libei context with ei_setup_backend_fd().
+ *
+ * Returns: the file descriptor, or -1 on error
+ */
+int
+xdp_session_connect_to_eis (XdpSession *session,
+                            GError **error)
+{
+  GVariantBuilder options;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  int fd_out;
+
+  g_return_val_if_fail (XDP_IS_SESSION (session) &&
+                        session->type == XDP_SESSION_INPUT_CAPTURE, -1);
+
+  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
+  ret = g_dbus_connection_call_with_unix_fd_list_sync (session->portal->bus,
+                                                       PORTAL_BUS_NAME,
+                                                       PORTAL_OBJECT_PATH,
+                                                       INPUT_CAPTURE_INTERFACE,
+                                                       "ConnectToEIS",
+                                                       g_variant_new ("(oa{sv})", session->id, &options),
+                                                       G_VARIANT_TYPE ("(h)"),
+                                                       G_DBUS_CALL_FLAGS_NONE,
+                                                       -1,
+                                                       NULL,
+                                                       &fd_list,
+                                                       NULL,
+                                                       error);
+  if (ret == NULL)
+    return -1;
+
+  g_variant_get (ret, "(h)", &fd_out);
+
+  return g_unix_fd_list_get (fd_list, fd_out, error);
+}
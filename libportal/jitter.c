@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "portal-private.h"
+#include "session-private.h"
+
+/**
+ * SECTION:jitter
+ * @title: Jitter buffer
+ * @short_description: smooth out input from remote clients
+ *
+ * Input that is forwarded from a remote client typically arrives in
+ * bursts, due to jitter in the network. Passing it on to the compositor
+ * as it arrives produces jerky pointer motion.
+ *
+ * A remote desktop session can optionally hold input events in a jitter
+ * buffer, enabled with xdp_session_set_jitter_buffer(). Events that carry
+ * the time at which the remote client produced them, which is set with
+ * xdp_session_set_input_time(), are released to the compositor with the
+ * same spacing they had on the sender, delayed by a small, bounded amount.
+ *
+ * The buffer estimates the network jitter from the timestamps, and can
+ * adapt its delay to it. Statistics about the buffer can be obtained
+ * with xdp_session_get_jitter_buffer_stats().
+ */
+
+/* The smallest observed transit time is used as the reference for
+ * the release schedule. It is re-evaluated periodically, so that clock
+ * drift between the sender and us does not accumulate.
+ */
+#define OFFSET_WINDOW (10 * G_USEC_PER_SEC)
+
+/* With adaptive depth, the delay is a multiple of the estimated jitter. */
+#define JITTER_FACTOR 3
+
+typedef struct {
+  InputEvent event;
+  gint64 release_time;
+} QueuedEvent;
+
+struct _JitterBuffer {
+  gint64 max_delay;
+  gboolean adaptive;
+
+  GQueue events;
+  GSource *source;
+  gint64 last_release;
+
+  gboolean have_offset;
+  gint64 base_offset;
+  gint64 window_min;
+  gint64 window_start;
+  gint64 last_offset;
+  double jitter;
+  gint64 delay;
+
+  guint64 n_received;
+  guint64 n_released;
+  guint64 n_late;
+  guint max_depth;
+};
+
+static gboolean
+jitter_source_dispatch (GSource *source,
+                        GSourceFunc callback,
+                        gpointer data)
+{
+  return callback (data);
+}
+
+static GSourceFuncs jitter_source_funcs = {
+  NULL,
+  NULL,
+  jitter_source_dispatch,
+  NULL
+};
+
+static void
+update_ready_time (JitterBuffer *jb)
+{
+  QueuedEvent *next = g_queue_peek_head (&jb->events);
+
+  g_source_set_ready_time (jb->source, next ? next->release_time : -1);
+}
+
+static gboolean
+release_due_events (gpointer data)
+{
+  XdpSession *session = data;
+  JitterBuffer *jb = session->jitter;
+  gint64 now = g_get_monotonic_time ();
+  QueuedEvent *queued;
+
+  while ((queued = g_queue_peek_head (&jb->events)) != NULL &&
+         queued->release_time <= now)
+    {
+      g_queue_pop_head (&jb->events);
+
+      /* The session may have been closed while the event was waiting */
+      if (session->state == XDP_SESSION_ACTIVE)
+        _xdp_session_send_input (session, &queued->event);
+      jb->n_released++;
+
+      g_free (queued);
+    }
+
+  update_ready_time (jb);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+flush_events (XdpSession *session)
+{
+  JitterBuffer *jb = session->jitter;
+  QueuedEvent *queued;
+
+  while ((queued = g_queue_pop_head (&jb->events)) != NULL)
+    {
+      if (session->state == XDP_SESSION_ACTIVE)
+        _xdp_session_send_input (session, &queued->event);
+      jb->n_released++;
+      g_free (queued);
+    }
+
+  update_ready_time (jb);
+}
+
+GMainContext *
+_xdp_session_get_input_context (XdpSession *session)
+{
+  if (session->jitter)
+    return g_source_get_context (session->jitter->source);
+
+  return g_main_context_get_thread_default ();
+}
+
+void
+_xdp_session_flush_jitter_buffer (XdpSession *session)
+{
+  if (session->jitter)
+    flush_events (session);
+}
+
+void
+_xdp_session_clear_jitter_buffer (XdpSession *session)
+{
+  JitterBuffer *jb = session->jitter;
+  QueuedEvent *queued;
+
+  if (jb == NULL)
+    return;
+
+  while ((queued = g_queue_pop_head (&jb->events)) != NULL)
+    g_free (queued);
+  g_source_destroy (jb->source);
+  g_source_unref (jb->source);
+  g_free (jb);
+
+  session->jitter = NULL;
+}
+
+static void
+update_estimate (JitterBuffer *jb,
+                 gint64 now,
+                 gint64 offset)
+{
+  if (!jb->have_offset)
+    {
+      jb->have_offset = TRUE;
+      jb->base_offset = offset;
+      jb->window_min = offset;
+      jb->window_start = now;
+      jb->last_offset = offset;
+    }
+  else
+    {
+      gint64 d = offset - jb->last_offset;
+
+      /* Interarrival jitter, as in RFC 3550 */
+      jb->jitter += ((double) ABS (d) - jb->jitter) / 16.0;
+      jb->last_offset = offset;
+
+      jb->base_offset = MIN (jb->base_offset, offset);
+      jb->window_min = MIN (jb->window_min, offset);
+
+      if (now - jb->window_start > OFFSET_WINDOW)
+        {
+          jb->base_offset = jb->window_min;
+          jb->window_min = offset;
+          jb->window_start = now;
+        }
+    }
+
+  if (jb->adaptive)
+    jb->delay = CLAMP ((gint64) (JITTER_FACTOR * jb->jitter), 0, jb->max_delay);
+  else
+    jb->delay = jb->max_delay;
+}
+
+void
+_xdp_session_dispatch_input (XdpSession *session,
+                             const InputEvent *event)
+{
+  JitterBuffer *jb = session->jitter;
+  QueuedEvent *queued;
+  gint64 now;
+  gint64 release_time;
+
+  if (jb == NULL)
+    {
+      _xdp_session_send_input (session, event);
+      return;
+    }
+
+  now = g_get_monotonic_time ();
+  jb->n_received++;
+
+  if (session->input_time != 0)
+    {
+      update_estimate (jb, now, now - session->input_time);
+      release_time = session->input_time + jb->base_offset + jb->delay;
+      if (release_time < now)
+        jb->n_late++;
+    }
+  else
+    release_time = now;
+
+  /* Never hold an event for longer than the configured bound,
+   * and never reorder events.
+   */
+  release_time = MIN (release_time, now + jb->max_delay);
+  release_time = MAX (release_time, jb->last_release);
+  jb->last_release = release_time;
+
+  if (release_time <= now && g_queue_is_empty (&jb->events))
+    {
+      _xdp_session_send_input (session, event);
+      jb->n_released++;
+      return;
+    }
+
+  queued = g_new (QueuedEvent, 1);
+  queued->event = *event;
+  queued->release_time = release_time;
+  g_queue_push_tail (&jb->events, queued);
+
+  jb->max_depth = MAX (jb->max_depth, g_queue_get_length (&jb->events));
+
+  update_ready_time (jb);
+}
+
+/**
+ * xdp_session_set_jitter_buffer:
+ * @session: a remote desktop #XdpSession
+ * @max_delay: the maximum time to hold back events, in milliseconds,
+ *     or 0 to disable the jitter buffer
+ * @adaptive: whether to adapt the delay to the observed jitter
+ *
+ * Enables or disables the jitter buffer for input events.
+ *
+ * If @adaptive is %FALSE, timestamped events are always delayed by
+ * @max_delay. Otherwise, the delay follows the estimated network jitter
+ * and @max_delay is an upper bound for it.
+ *
+ * When the jitter buffer is disabled, pending events are sent
+ * immediately.
+ */
+void
+xdp_session_set_jitter_buffer (XdpSession *session,
+                               guint max_delay,
+                               gboolean adaptive)
+{
+  JitterBuffer *jb;
+
+  g_return_if_fail (XDP_IS_SESSION (session));
+  g_return_if_fail (session->type == XDP_SESSION_REMOTE_DESKTOP);
+
+  if (max_delay == 0)
+    {
+      if (session->jitter)
+        {
+          flush_events (session);
+          _xdp_session_clear_jitter_buffer (session);
+        }
+      return;
+    }
+
+  jb = session->jitter;
+  if (jb == NULL)
+    {
+      jb = g_new0 (JitterBuffer, 1);
+      g_queue_init (&jb->events);
+
+      jb->source = g_source_new (&jitter_source_funcs, sizeof (GSource));
+      g_source_set_priority (jb->source, G_PRIORITY_HIGH);
+      g_source_set_callback (jb->source, release_due_events, session, NULL);
+      g_source_attach (jb->source, g_main_context_get_thread_default ());
+
+      session->jitter = jb;
+    }
+
+  jb->max_delay = (gint64) max_delay * 1000;
+  jb->adaptive = adaptive;
+  jb->delay = adaptive ? MIN (jb->delay, jb->max_delay) : jb->max_delay;
+}
+
+/**
+ * xdp_session_set_input_time:
+ * @session: a remote desktop #XdpSession
+ * @time: the time at which the remote client produced the following
+ *     input events, in microseconds, or 0 to unset it
+ *
+ * Sets the sender timestamp for input events that are sent after
+ * this call, such as xdp_session_pointer_motion().
+ *
+ * The timestamps only need to be monotonic on the sender; they
+ * do not need to be in the same time base as g_get_monotonic_time().
+ *
+ * Timestamps are only used when the jitter buffer is enabled.
+ * Events without a timestamp are passed on as soon as all earlier
+ * events have been released.
+ */
+void
+xdp_session_set_input_time (XdpSession *session,
+                            gint64 time)
+{
+  g_return_if_fail (XDP_IS_SESSION (session));
+
+  session->input_time = time;
+}
+
+/**
+ * xdp_session_get_jitter_buffer_stats:
+ * @session: a remote desktop #XdpSession
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Obtains statistics about the jitter buffer of @session.
+ *
+ * If the jitter buffer is not enabled, all values are 0.
+ */
+void
+xdp_session_get_jitter_buffer_stats (XdpSession *session,
+                                     XdpJitterBufferStats *stats)
+{
+  JitterBuffer *jb;
+
+  g_return_if_fail (XDP_IS_SESSION (session));
+  g_return_if_fail (stats != NULL);
+
+  memset (stats, 0, sizeof (XdpJitterBufferStats));
+
+  jb = session->jitter;
+  if (jb == NULL)
+    return;
+
+  stats->n_received = jb->n_received;
+  stats->n_released = jb->n_released;
+  stats->n_late = jb->n_late;
+  stats->depth = g_queue_get_length (&jb->events);
+  stats->max_depth = jb->max_depth;
+  stats->delay = jb->delay;
+  stats->jitter = (gint64) jb->jitter;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "portal-private.h"
+#include "session-private.h"
+
+/**
+ * SECTION:keyrepeat
+ * @title: Key repeat
+ * @short_description: repeat held keys locally
+ *
+ * Remote clients often forward the auto-repeat of their keyboard as a
+ * stream of key presses and releases. This makes the repeat rate depend
+ * on the network, and causes a lot of traffic for every held key.
+ *
+ * With xdp_session_set_key_repeat(), a remote desktop session keeps track
+ * of the keys that are held down. Repeated presses of a held key are
+ * dropped, so a remote client can send a single press and a single release
+ * for a held key, and the repeat is generated on this side: either by the
+ * compositor, which repeats held keys by itself, or by a local timer at a
+ * configured rate.
+ */
+
+#define KEY_ID(keysym, key) GUINT_TO_POINTER (((guint) (key) & 0x7fffffff) | ((keysym) ? 0x80000000 : 0))
+
+typedef struct {
+  XdpSession *session;
+  gboolean keysym;
+  int key;
+  guint timeout_id;
+} HeldKey;
+
+static void
+held_key_free (HeldKey *held)
+{
+  if (held->timeout_id)
+    g_source_remove (held->timeout_id);
+  g_free (held);
+}
+
+static void
+send_key (XdpSession *session,
+          gboolean keysym,
+          int key,
+          XdpKeyState state)
+{
+  InputEvent event = { INPUT_KEYBOARD_KEYCODE, };
+
+  event.type = keysym ? INPUT_KEYBOARD_KEYSYM : INPUT_KEYBOARD_KEYCODE;
+  event.value = key;
+  event.state = state;
+  _xdp_session_dispatch_input (session, &event);
+}
+
+static gboolean
+repeat_key (gpointer data)
+{
+  HeldKey *held = data;
+  XdpSession *session = held->session;
+
+  if (session->state != XDP_SESSION_ACTIVE)
+    {
+      held->timeout_id = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  /* Compositors ignore a second press of a key that is already down,
+   * so a repeat is sent as a release followed by a press.
+   */
+  send_key (session, held->keysym, held->key, XDP_KEY_RELEASED);
+  send_key (session, held->keysym, held->key, XDP_KEY_PRESSED);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+start_repeat (gpointer data)
+{
+  HeldKey *held = data;
+
+  held->timeout_id = g_timeout_add (held->session->key_repeat_interval, repeat_key, held);
+  repeat_key (held);
+
+  return G_SOURCE_REMOVE;
+}
+
+gboolean
+_xdp_session_handle_key (XdpSession *session,
+                         gboolean keysym,
+                         int key,
+                         XdpKeyState state)
+{
+  HeldKey *held;
+
+  if (session->key_repeat_mode == XDP_KEY_REPEAT_NONE)
+    return FALSE;
+
+  held = g_hash_table_lookup (session->held_keys, KEY_ID (keysym, key));
+
+  if (state == XDP_KEY_PRESSED)
+    {
+      /* A repeated press from the remote side */
+      if (held)
+        return TRUE;
+
+      held = g_new0 (HeldKey, 1);
+      held->session = session;
+      held->keysym = keysym;
+      held->key = key;
+      g_hash_table_insert (session->held_keys, KEY_ID (keysym, key), held);
+
+      send_key (session, keysym, key, XDP_KEY_PRESSED);
+
+      if (session->key_repeat_mode == XDP_KEY_REPEAT_LOCAL)
+        held->timeout_id = g_timeout_add (session->key_repeat_delay, start_repeat, held);
+    }
+  else
+    {
+      if (held)
+        g_hash_table_remove (session->held_keys, KEY_ID (keysym, key));
+
+      send_key (session, keysym, key, XDP_KEY_RELEASED);
+    }
+
+  return TRUE;
+}
+
+void
+_xdp_session_clear_held_keys (XdpSession *session)
+{
+  if (session->held_keys)
+    g_hash_table_remove_all (session->held_keys);
+}
+
+void
+_xdp_session_replay_held_keys (XdpSession *session)
+{
+  GHashTableIter iter;
+  HeldKey *held;
+
+  if (session->held_keys == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, session->held_keys);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&held))
+    send_key (session, held->keysym, held->key, XDP_KEY_PRESSED);
+}
+
+/**
+ * xdp_session_set_key_repeat:
+ * @session: a remote desktop #XdpSession
+ * @mode: how to repeat held keys
+ * @delay: the time before a held key starts to repeat, in milliseconds
+ * @interval: the time between repeats, in milliseconds
+ *
+ * Changes how repeated presses of held keys are handled by
+ * xdp_session_keyboard_key().
+ *
+ * With %XDP_KEY_REPEAT_NONE, all key events are passed on as they are.
+ * With %XDP_KEY_REPEAT_COMPOSITOR, repeated presses of a key that is
+ * held down are dropped, and the compositor repeats the key. With
+ * %XDP_KEY_REPEAT_LOCAL, repeated presses are dropped as well, and the
+ * key is repeated after @delay every @interval milliseconds until it
+ * is released.
+ *
+ * @delay and @interval are only used with %XDP_KEY_REPEAT_LOCAL.
+ */
+void
+xdp_session_set_key_repeat (XdpSession *session,
+                            XdpKeyRepeatMode mode,
+                            guint delay,
+                            guint interval)
+{
+  g_return_if_fail (XDP_IS_SESSION (session));
+  g_return_if_fail (session->type == XDP_SESSION_REMOTE_DESKTOP);
+  g_return_if_fail (mode != XDP_KEY_REPEAT_LOCAL || interval > 0);
+
+  /* Keys that are currently held stay down, but are no longer tracked */
+  _xdp_session_clear_held_keys (session);
+
+  if (mode != XDP_KEY_REPEAT_NONE && session->held_keys == NULL)
+    session->held_keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                NULL, (GDestroyNotify)held_key_free);
+
+  session->key_repeat_mode = mode;
+  session->key_repeat_delay = delay;
+  session->key_repeat_interval = interval;
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "portal-private.h"
+#include "session-private.h"
+
+/**
+ * SECTION:latency
+ * @title: Input latency
+ * @short_description: measure input-to-frame latency
+ *
+ * These functions help to measure the delay between injecting input
+ * into a remote desktop session and seeing its effect in a screencast
+ * stream of the same session.
+ *
+ * A measurement consists of marker events, which are absolute pointer
+ * motions to known positions, sent with xdp_session_send_latency_marker().
+ * The application that consumes the pipewire stream reports the cursor
+ * position of each frame it receives with xdp_session_notify_frame(),
+ * typically taken from the cursor metadata of the stream. Whenever a frame
+ * shows the position of a pending marker, the time between sending the
+ * marker and the frame is recorded as a sample.
+ *
+ * The collected samples can be obtained as a distribution with
+ * xdp_session_get_latency_stats().
+ */
+
+/* When more markers than this are waiting for a frame,
+ * the oldest ones are considered lost.
+ */
+#define MAX_PENDING_MARKERS 64
+
+/* Only this many of the most recent samples are kept. Once there
+ * are this many, each new sample replaces the oldest one.
+ */
+#define MAX_LATENCY_SAMPLES 1024
+
+/* Positions are compared in the logical coordinate space of the
+ * stream, and the compositor may round them.
+ */
+#define POSITION_TOLERANCE 0.5
+
+typedef struct {
+  guint id;
+  guint stream;
+  double x;
+  double y;
+  gint64 sent_time; /* 0 while the motion is held in a jitter buffer */
+} LatencyMarker;
+
+static void
+latency_marker_free (LatencyMarker *marker)
+{
+  g_free (marker);
+}
+
+void
+_xdp_session_clear_latency (XdpSession *session)
+{
+  if (session->latency_markers)
+    {
+      g_queue_free_full (session->latency_markers, (GDestroyNotify)latency_marker_free);
+      session->latency_markers = NULL;
+    }
+  g_clear_pointer (&session->latency_samples, g_array_unref);
+  session->latency_oldest = 0;
+  session->latency_lost = 0;
+}
+
+void
+_xdp_session_latency_marker_sent (XdpSession *session,
+                                  guint marker)
+{
+  GList *l;
+
+  if (session->latency_markers == NULL)
+    return;
+
+  for (l = session->latency_markers->head; l; l = l->next)
+    {
+      LatencyMarker *m = l->data;
+
+      if (m->id == marker)
+        {
+          m->sent_time = g_get_monotonic_time ();
+          break;
+        }
+    }
+}
+
+/**
+ * xdp_session_send_latency_marker:
+ * @session: a #XdpSession
+ * @stream: the node ID of the pipewire stream the position is relative to
+ * @x: X position of the marker
+ * @y: Y position of the marker
+ *
+ * Moves the pointer to the position (@x, @y) in the given streams
+ * logical coordinate space, and remembers the time at which this
+ * was done, so that a later frame showing the pointer at this position
+ * can be matched to it by xdp_session_notify_frame().
+ *
+ * If the session has a jitter buffer, the time is taken when the
+ * motion leaves the buffer, so the delay of the buffer is not part
+ * of the measured latency.
+ *
+ * Consecutive markers should use positions that differ, otherwise
+ * a frame can not be attributed to one of them.
+ *
+ * May only be called on a remote desktop session
+ * with %XDP_DEVICE_POINTER access.
+ *
+ * Returns: an ID for the marker, or 0 if it could not be sent
+ */
+guint
+xdp_session_send_latency_marker (XdpSession *session,
+                                 guint stream,
+                                 double x,
+                                 double y)
+{
+  InputEvent event = { INPUT_POINTER_POSITION, };
+  LatencyMarker *marker;
+
+  g_return_val_if_fail (XDP_IS_SESSION (session) &&
+                        session->type == XDP_SESSION_REMOTE_DESKTOP &&
+                        session->state == XDP_SESSION_ACTIVE &&
+                        ((session->devices & XDP_DEVICE_POINTER) != 0), 0);
+
+  if (session->latency_markers == NULL)
+    session->latency_markers = g_queue_new ();
+
+  while (g_queue_get_length (session->latency_markers) >= MAX_PENDING_MARKERS)
+    {
+      latency_marker_free (g_queue_pop_head (session->latency_markers));
+      session->latency_lost++;
+    }
+
+  marker = g_new0 (LatencyMarker, 1);
+  marker->id = ++session->latency_serial;
+  marker->stream = stream;
+  marker->x = x;
+  marker->y = y;
+  g_queue_push_tail (session->latency_markers, marker);
+
+  event.stream = stream;
+  event.x = x;
+  event.y = y;
+  event.marker = marker->id;
+  _xdp_session_dispatch_input (session, &event);
+
+  return marker->id;
+}
+
+/**
+ * xdp_session_notify_frame:
+ * @session: a #XdpSession
+ * @stream: the node ID of the pipewire stream the frame belongs to
+ * @x: X position of the cursor in the frame
+ * @y: Y position of the cursor in the frame
+ * @frame_time: the time at which the frame was received, in the
+ *     time base of g_get_monotonic_time(), or 0 to use the current time
+ *
+ * Reports a frame of a screencast stream that shows the cursor at
+ * position (@x, @y).
+ *
+ * If the position matches a pending marker that was sent with
+ * xdp_session_send_latency_marker(), a latency sample is recorded.
+ * Markers that were sent before the matched one and have not been
+ * seen are counted as lost.
+ *
+ * Returns: the ID of the matched marker, or 0 if the frame
+ *     did not match a pending marker
+ */
+guint
+xdp_session_notify_frame (XdpSession *session,
+                          guint stream,
+                          double x,
+                          double y,
+                          gint64 frame_time)
+{
+  GList *l;
+  guint id;
+
+  g_return_val_if_fail (XDP_IS_SESSION (session), 0);
+
+  if (session->latency_markers == NULL)
+    return 0;
+
+  if (frame_time <= 0)
+    frame_time = g_get_monotonic_time ();
+
+  for (l = session->latency_markers->head; l; l = l->next)
+    {
+      LatencyMarker *marker = l->data;
+
+      /* Markers are sent in order, so none after this one is out yet */
+      if (marker->sent_time == 0)
+        return 0;
+
+      if (marker->stream == stream &&
+          fabs (marker->x - x) <= POSITION_TOLERANCE &&
+          fabs (marker->y - y) <= POSITION_TOLERANCE)
+        break;
+    }
+
+  if (l == NULL)
+    return 0;
+
+  while (session->latency_markers->head != l)
+    {
+      latency_marker_free (g_queue_pop_head (session->latency_markers));
+      session->latency_lost++;
+    }
+
+  {
+    LatencyMarker *marker = g_queue_pop_head (session->latency_markers);
+    gint64 latency = MAX (frame_time - marker->sent_time, 0);
+
+    if (session->latency_samples == NULL)
+      session->latency_samples = g_array_sized_new (FALSE, FALSE, sizeof (gint64), MAX_LATENCY_SAMPLES);
+
+    if (session->latency_samples->len < MAX_LATENCY_SAMPLES)
+      g_array_append_val (session->latency_samples, latency);
+    else
+      {
+        g_array_index (session->latency_samples, gint64, session->latency_oldest) = latency;
+        session->latency_oldest = (session->latency_oldest + 1) % MAX_LATENCY_SAMPLES;
+      }
+
+    id = marker->id;
+    latency_marker_free (marker);
+  }
+
+  return id;
+}
+
+static int
+compare_samples (gconstpointer a,
+                 gconstpointer b)
+{
+  gint64 sa = *(const gint64 *)a;
+  gint64 sb = *(const gint64 *)b;
+
+  return sa < sb ? -1 : (sa > sb ? 1 : 0);
+}
+
+static gint64
+percentile (const gint64 *sorted,
+            guint n,
+            guint p)
+{
+  guint rank;
+
+  rank = (guint) ((((guint64) n * p) + 99) / 100);
+  if (rank > 0)
+    rank--;
+
+  return sorted[MIN (rank, n - 1)];
+}
+
+/**
+ * xdp_session_get_latency_stats:
+ * @session: a #XdpSession
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Obtains the distribution of the latency samples that have been
+ * recorded since the session was created, or since the last call
+ * to xdp_session_reset_latency_stats(). Only the 1024 most recent
+ * samples are taken into account.
+ *
+ * All times are in microseconds. If no samples have been recorded,
+ * all times are 0.
+ */
+void
+xdp_session_get_latency_stats (XdpSession *session,
+                               XdpLatencyStats *stats)
+{
+  g_autofree gint64 *sorted = NULL;
+  gint64 sum = 0;
+  guint n;
+  guint i;
+
+  g_return_if_fail (XDP_IS_SESSION (session));
+  g_return_if_fail (stats != NULL);
+
+  memset (stats, 0, sizeof (XdpLatencyStats));
+
+  stats->n_lost = session->latency_lost;
+  stats->n_pending = session->latency_markers ? g_queue_get_length (session->latency_markers) : 0;
+
+  if (session->latency_samples == NULL || session->latency_samples->len == 0)
+    return;
+
+  n = session->latency_samples->len;
+  sorted = g_new (gint64, n);
+  memcpy (sorted, session->latency_samples->data, n * sizeof (gint64));
+  qsort (sorted, n, sizeof (gint64), compare_samples);
+
+  for (i = 0; i < n; i++)
+    sum += sorted[i];
+
+  stats->n_samples = n;
+  stats->min = sorted[0];
+  stats->max = sorted[n - 1];
+  stats->mean = sum / n;
+  stats->p50 = percentile (sorted, n, 50);
+  stats->p90 = percentile (sorted, n, 90);
+  stats->p99 = percentile (sorted, n, 99);
+}
+
+/**
+ * xdp_session_reset_latency_stats:
+ * @session: a #XdpSession
+ *
+ * Discards all recorded latency samples and pending markers.
+ */
+void
+xdp_session_reset_latency_stats (XdpSession *session)
+{
+  g_return_if_fail (XDP_IS_SESSION (session));
+
+  _xdp_session_clear_latency (session);
+}
@@ -84,7 +84,8 @@ static void
 do_open (OpenCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  g_autofree char *handle = NULL;
+  const char *token;
   g_autoptr(GFile) file = NULL;
 
   if (call->parent_handle == NULL)
@@ -93,7 +94,8 @@ do_open (OpenCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
+  /* Nothing waits for the response, only the token is needed */
+  handle = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
 
   g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
   g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
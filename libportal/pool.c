@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "portal-private.h"
+#include "session-private.h"
+
+/**
+ * SECTION:pool
+ * @title: Session pool
+ * @short_description: create sessions ahead of time
+ *
+ * Creating a screencast or remote desktop session takes several round
+ * trips to the portal before the session can be started. To take this
+ * latency off the interactive path, an #XdpPortal can keep a pool of
+ * sessions that have been created ahead of time.
+ *
+ * A pool is set up with xdp_portal_set_session_pool(). When
+ * xdp_portal_create_screencast_session() or
+ * xdp_portal_create_remote_desktop_session() is called with parameters
+ * that match the pool, a session from the pool is returned right away,
+ * and the pool is refilled in the background.
+ *
+ * Sessions that stay in the pool for longer than the configured
+ * time to live are closed and replaced.
+ */
+
+typedef struct {
+  XdpSession *session;
+  gint64 created;
+} PooledSession;
+
+struct _SessionPool {
+  XdpPortal *portal;
+  XdpSessionType type;
+  XdpDeviceType devices;
+  XdpOutputType outputs;
+  gboolean multiple;
+  guint size;
+  gint64 ttl;
+
+  GQueue entries;
+  guint n_filling;
+  guint generation;
+  guint expire_id;
+};
+
+typedef struct {
+  SessionPool *pool;
+  guint generation;
+} FillCall;
+
+static void
+pooled_session_free (PooledSession *entry,
+                     gboolean close)
+{
+  if (close && entry->session->state != XDP_SESSION_CLOSED)
+    xdp_session_close (entry->session);
+  g_object_unref (entry->session);
+  g_free (entry);
+}
+
+static void refill_pool (SessionPool *pool);
+
+static void schedule_expiry (SessionPool *pool);
+
+static gboolean
+expire_sessions (gpointer data)
+{
+  SessionPool *pool = data;
+  gint64 now = g_get_monotonic_time ();
+  PooledSession *entry;
+
+  pool->expire_id = 0;
+
+  while ((entry = g_queue_peek_head (&pool->entries)) != NULL &&
+         now - entry->created >= pool->ttl)
+    pooled_session_free (g_queue_pop_head (&pool->entries), TRUE);
+
+  refill_pool (pool);
+  schedule_expiry (pool);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_expiry (SessionPool *pool)
+{
+  PooledSession *entry;
+  gint64 remaining;
+
+  if (pool->expire_id != 0 || pool->ttl == 0)
+    return;
+
+  /* The queue is ordered by creation time */
+  entry = g_queue_peek_head (&pool->entries);
+  if (entry == NULL)
+    return;
+
+  remaining = entry->created + pool->ttl - g_get_monotonic_time ();
+  pool->expire_id = g_timeout_add (MAX (remaining / 1000, 0) + 1, expire_sessions, pool);
+}
+
+static void
+session_filled (GObject *source,
+                GAsyncResult *result,
+                gpointer data)
+{
+  FillCall *call = data;
+  SessionPool *pool = call->pool;
+  g_autoptr(GError) error = NULL;
+  XdpSession *session;
+
+  session = _xdp_portal_create_session_finish (XDP_PORTAL (source), result, &error);
+
+  /* The pool was reconfigured while the session was created */
+  if (call->generation != pool->generation)
+    {
+      if (session)
+        {
+          xdp_session_close (session);
+          g_object_unref (session);
+        }
+      g_free (call);
+      return;
+    }
+
+  pool->n_filling--;
+  g_free (call);
+
+  if (session == NULL)
+    {
+      /* Don't retry right away, the next request will try again */
+      g_warning ("Failed to create a session for the pool: %s", error->message);
+      return;
+    }
+
+  {
+    PooledSession *entry = g_new0 (PooledSession, 1);
+
+    entry->session = session;
+    entry->created = g_get_monotonic_time ();
+    g_queue_push_tail (&pool->entries, entry);
+  }
+
+  schedule_expiry (pool);
+}
+
+static void
+refill_pool (SessionPool *pool)
+{
+  while (g_queue_get_length (&pool->entries) + pool->n_filling < pool->size)
+    {
+      FillCall *call = g_new0 (FillCall, 1);
+
+      call->pool = pool;
+      call->generation = pool->generation;
+      pool->n_filling++;
+
+      _xdp_portal_create_session (pool->portal,
+                                  pool->type,
+                                  pool->devices,
+                                  pool->outputs,
+                                  pool->multiple,
+                                  session_filled,
+                                  call);
+    }
+}
+
+static void
+clear_pool (SessionPool *pool)
+{
+  PooledSession *entry;
+
+  while ((entry = g_queue_pop_head (&pool->entries)) != NULL)
+    pooled_session_free (entry, TRUE);
+
+  if (pool->expire_id)
+    {
+      g_source_remove (pool->expire_id);
+      pool->expire_id = 0;
+    }
+
+  /* Sessions that are still being created are dropped when they arrive */
+  pool->generation++;
+  pool->n_filling = 0;
+}
+
+void
+_xdp_portal_free_session_pools (XdpPortal *portal)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (portal->session_pools); i++)
+    {
+      SessionPool *pool = portal->session_pools[i];
+
+      if (pool == NULL)
+        continue;
+
+      clear_pool (pool);
+      g_free (pool);
+      portal->session_pools[i] = NULL;
+    }
+}
+
+XdpSession *
+_xdp_portal_take_pooled_session (XdpPortal *portal,
+                                 XdpSessionType type,
+                                 XdpDeviceType devices,
+                                 XdpOutputType outputs,
+                                 gboolean multiple)
+{
+  SessionPool *pool;
+  PooledSession *entry;
+  XdpSession *session = NULL;
+  gint64 now;
+
+  if (type >= G_N_ELEMENTS (portal->session_pools))
+    return NULL;
+
+  pool = portal->session_pools[type];
+  if (pool == NULL ||
+      pool->devices != devices ||
+      pool->outputs != outputs ||
+      pool->multiple != multiple)
+    return NULL;
+
+  now = g_get_monotonic_time ();
+
+  while (session == NULL &&
+         (entry = g_queue_pop_head (&pool->entries)) != NULL)
+    {
+      /* Skip sessions that were closed by the portal, or are stale */
+      if (entry->session->state == XDP_SESSION_INITIAL &&
+          (pool->ttl == 0 || now - entry->created < pool->ttl))
+        session = g_object_ref (entry->session);
+
+      pooled_session_free (entry, session == NULL);
+    }
+
+  refill_pool (pool);
+
+  return session;
+}
+
+/**
+ * xdp_portal_set_session_pool:
+ * @portal: a #XdpPortal
+ * @type: the type of sessions to keep in the pool
+ * @devices: which kinds of input devices to offer, for remote desktop sessions
+ * @outputs: which kinds of source to offer
+ * @multiple: whether to allow selecting multiple sources
+ * @size: the number of sessions to keep ready, or 0 to disable the pool
+ * @ttl: the time after which unused sessions are replaced, in seconds,
+ *     or 0 to keep them indefinitely
+ *
+ * Sets up a pool of sessions of type @type that are created ahead of time,
+ * with the given parameters. There can be one pool for each session type,
+ * calling this function again replaces the pool.
+ *
+ * The sessions in the pool keep @portal alive. To release them, call this
+ * function again with a @size of 0.
+ */
+void
+xdp_portal_set_session_pool (XdpPortal *portal,
+                             XdpSessionType type,
+                             XdpDeviceType devices,
+                             XdpOutputType outputs,
+                             gboolean multiple,
+                             guint size,
+                             guint ttl)
+{
+  SessionPool *pool;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (type < G_N_ELEMENTS (portal->session_pools));
+
+  if (type == XDP_SESSION_SCREENCAST)
+    devices = XDP_DEVICE_NONE;
+
+  pool = portal->session_pools[type];
+  if (pool == NULL)
+    {
+      pool = g_new0 (SessionPool, 1);
+      pool->portal = portal;
+      pool->type = type;
+      g_queue_init (&pool->entries);
+      portal->session_pools[type] = pool;
+    }
+  else
+    clear_pool (pool);
+
+  pool->devices = devices;
+  pool->outputs = outputs;
+  pool->multiple = multiple;
+  pool->size = size;
+  pool->ttl = (gint64) ttl * G_USEC_PER_SEC;
+
+  refill_pool (pool);
+}
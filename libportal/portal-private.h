@@ -19,14 +19,88 @@
 
 #include "portal.h"
 
+typedef struct _SessionPool SessionPool;
+
 struct _XdpPortal {
   GObject parent_instance;
 
   GDBusConnection *bus;
   char *sender;
   GHashTable *inhibit_handles;
+  GHashTable *scoped_inhibits;
+  GHashTable *sessions;
+  SessionPool *session_pools[2];
+
+  gboolean have_realtime_limits;
+  gboolean have_max_realtime_priority;
+  gboolean have_min_nice_level;
+  int max_realtime_priority;
+  int min_nice_level;
+  gint64 rttime_usec_max;
+
+  guint gamemode_count;
+  gboolean gamemode_registered;
+  GList *gamemode_waiters;
+
+  GHashTable *flights;
+
+  char *screenshot_dir;
+  guint screenshot_max_files;
+  guint64 screenshot_max_bytes;
+  GQueue screenshots;
+  guint64 screenshot_bytes;
+  guint64 screenshots_evicted;
+  guint64 screenshot_bytes_evicted;
+  guint screenshot_serial;
+  GHashTable *shared_screenshots;
 };
 
+void _xdp_portal_release_scoped_inhibits (XdpPortal *portal);
+void _xdp_portal_release_gamemode        (XdpPortal *portal);
+void _xdp_portal_free_screenshot_storage (XdpPortal *portal);
+
+#if XDP_HAS_REMOTE
+void _xdp_portal_add_session    (XdpPortal  *portal,
+                                 XdpSession *session);
+void _xdp_portal_remove_session (XdpPortal  *portal,
+                                 XdpSession *session);
+
+void        _xdp_portal_create_session        (XdpPortal           *portal,
+                                               XdpSessionType       type,
+                                               XdpDeviceType        devices,
+                                               XdpOutputType        outputs,
+                                               gboolean             multiple,
+                                               GAsyncReadyCallback  callback,
+                                               gpointer             data);
+XdpSession *_xdp_portal_create_session_finish (XdpPortal           *portal,
+                                               GAsyncResult        *result,
+                                               GError             **error);
+
+XdpSession *_xdp_portal_take_pooled_session   (XdpPortal           *portal,
+                                               XdpSessionType       type,
+                                               XdpDeviceType        devices,
+                                               XdpOutputType        outputs,
+                                               gboolean             multiple);
+void        _xdp_portal_free_session_pools    (XdpPortal           *portal);
+#endif
+
+void _xdp_portal_start_recording (XdpPortal *portal);
+
+char *_xdp_portal_new_handle (XdpPortal   *portal,
+                              const char  *prefix,
+                              const char **token);
+
+typedef void (* XdpFlightShareFunc) (XdpPortal *portal,
+                                     gpointer   value,
+                                     guint      n_waiters);
+
+GTask *_xdp_portal_join_flight (XdpPortal          *portal,
+                                const char         *key,
+                                GTask              *task,
+                                GBoxedCopyFunc      copy,
+                                GDestroyNotify      destroy,
+                                XdpFlightShareFunc  share);
+
 #define PORTAL_BUS_NAME "org.freedesktop.portal.Desktop"
 #define PORTAL_OBJECT_PATH  "/org/freedesktop/portal/desktop"
 #define REQUEST_PATH_PREFIX "/org/freedesktop/portal/desktop/request/"
@@ -17,7 +17,12 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "portal-private.h"
+#if XDP_HAS_REMOTE
+#include "session-private.h"
+#endif
 
 /**
  * SECTION:portal
@@ -38,12 +43,31 @@ xdp_portal_finalize (GObject *object)
 {
   XdpPortal *portal = XDP_PORTAL (object);
 
+#if XDP_HAS_INHIBIT
+  _xdp_portal_release_scoped_inhibits (portal);
+#endif
+#if XDP_HAS_GAMEMODE
+  _xdp_portal_release_gamemode (portal);
+#endif
+#if XDP_HAS_SCREENSHOT
+  _xdp_portal_free_screenshot_storage (portal);
+#endif
+
   g_clear_object (&portal->bus);
   g_free (portal->sender);
 
   if (portal->inhibit_handles)
     g_hash_table_unref (portal->inhibit_handles);
 
+  /* Sessions keep the portal alive, so there are none left here */
+  g_hash_table_unref (portal->sessions);
+#if XDP_HAS_REMOTE
+  _xdp_portal_free_session_pools (portal);
+#endif
+
+  /* Flights keep the portal alive too */
+  g_hash_table_unref (portal->flights);
+
   G_OBJECT_CLASS (xdp_portal_parent_class)->finalize (object);
 }
 
@@ -65,6 +89,27 @@ xdp_portal_init (XdpPortal *portal)
   for (i = 0; portal->sender[i]; i++)
     if (portal->sender[i] == '.') 
       portal->sender[i] = '_';
+
+  portal->sessions = g_hash_table_new (g_str_hash, g_str_equal);
+  portal->flights = g_hash_table_new (g_str_hash, g_str_equal);
+
+  _xdp_portal_start_recording (portal);
+}
+
+/* Returns a new request or session path with a random token.
+ * @token points into the returned path, so both come from one allocation.
+ */
+char *
+_xdp_portal_new_handle (XdpPortal   *portal,
+                        const char  *prefix,
+                        const char **token)
+{
+  char *handle;
+
+  handle = g_strdup_printf ("%s%s/portal%d", prefix, portal->sender, g_random_int_range (0, G_MAXINT));
+  *token = strrchr (handle, '/') + 1;
+
+  return handle;
 }
 
 /**
@@ -95,3 +140,365 @@ xdp_portal_new (void)
  *
  * Frees an #XdpParent.
  */
+
+#if XDP_HAS_REMOTE
+
+void
+_xdp_portal_add_session (XdpPortal *portal,
+                         XdpSession *session)
+{
+  g_hash_table_insert (portal->sessions, session->id, session);
+}
+
+void
+_xdp_portal_remove_session (XdpPortal *portal,
+                            XdpSession *session)
+{
+  if (g_hash_table_lookup (portal->sessions, session->id) == session)
+    g_hash_table_remove (portal->sessions, session->id);
+}
+
+/**
+ * xdp_portal_get_sessions:
+ * @portal: a #XdpPortal
+ *
+ * Obtains all sessions that have been created with @portal
+ * and are still alive, including sessions that have been closed.
+ *
+ * Returns: (transfer full) (element-type XdpSession): a list of sessions
+ */
+GList *
+xdp_portal_get_sessions (XdpPortal *portal)
+{
+  GList *sessions;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+
+  sessions = g_hash_table_get_values (portal->sessions);
+  g_list_foreach (sessions, (GFunc)g_object_ref, NULL);
+
+  return sessions;
+}
+
+/**
+ * xdp_portal_get_n_sessions:
+ * @portal: a #XdpPortal
+ * @type: the type of sessions to count
+ *
+ * Counts the sessions of type @type that have been created with
+ * @portal and have not been closed.
+ *
+ * Returns: the number of open sessions of type @type
+ */
+guint
+xdp_portal_get_n_sessions (XdpPortal *portal,
+                           XdpSessionType type)
+{
+  GHashTableIter iter;
+  XdpSession *session;
+  guint n = 0;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), 0);
+
+  g_hash_table_iter_init (&iter, portal->sessions);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&session))
+    {
+      if (session->type == type && session->state != XDP_SESSION_CLOSED)
+        n++;
+    }
+
+  return n;
+}
+
+typedef struct {
+  GTask *task;
+  guint n_pending;
+  GError *error;
+} CloseAllCall;
+
+static void
+session_close_done (GObject *source,
+                    GAsyncResult *result,
+                    gpointer data)
+{
+  CloseAllCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  if (ret == NULL)
+    {
+      if (call->error == NULL)
+        call->error = error;
+      else
+        g_error_free (error);
+    }
+
+  if (--call->n_pending > 0)
+    return;
+
+  if (call->error)
+    g_task_return_error (call->task, call->error);
+  else
+    g_task_return_boolean (call->task, TRUE);
+
+  g_object_unref (call->task);
+  g_free (call);
+}
+
+/**
+ * xdp_portal_close_all_sessions:
+ * @portal: a #XdpPortal
+ * @timeout: the time to wait for the portal to acknowledge, in milliseconds,
+ *     or -1 for the default timeout
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Closes all sessions of @portal that are not closed yet.
+ *
+ * The sessions are closed concurrently, and move to the closed state
+ * right away. The request is done when the portal has acknowledged
+ * all of them, or when @timeout has passed.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_close_all_sessions_finish() to get the results.
+ */
+void
+xdp_portal_close_all_sessions (XdpPortal *portal,
+                               int timeout,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer data)
+{
+  g_autoptr(GPtrArray) sessions = NULL;
+  GHashTableIter iter;
+  XdpSession *session;
+  CloseAllCall *call;
+  guint i;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  /* Closing a session emits ::closed, and handlers may drop
+   * the last reference, so don't iterate the registry itself.
+   */
+  sessions = g_ptr_array_new_with_free_func (g_object_unref);
+  g_hash_table_iter_init (&iter, portal->sessions);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&session))
+    {
+      if (session->state != XDP_SESSION_CLOSED)
+        g_ptr_array_add (sessions, g_object_ref (session));
+    }
+
+  call = g_new0 (CloseAllCall, 1);
+  call->task = g_task_new (portal, cancellable, callback, data);
+
+  if (sessions->len == 0)
+    {
+      g_task_return_boolean (call->task, TRUE);
+      g_object_unref (call->task);
+      g_free (call);
+      return;
+    }
+
+  call->n_pending = sessions->len;
+
+  for (i = 0; i < sessions->len; i++)
+    {
+      session = g_ptr_array_index (sessions, i);
+
+      g_dbus_connection_call (portal->bus,
+                              PORTAL_BUS_NAME,
+                              session->id,
+                              SESSION_INTERFACE,
+                              "Close",
+                              NULL,
+                              NULL,
+                              G_DBUS_CALL_FLAGS_NONE,
+                              timeout,
+                              cancellable,
+                              session_close_done,
+                              call);
+    }
+
+  for (i = 0; i < sessions->len; i++)
+    {
+      session = g_ptr_array_index (sessions, i);
+      _xdp_session_set_session_state (session, XDP_SESSION_CLOSED);
+    }
+}
+
+/**
+ * xdp_portal_close_all_sessions_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the close-all-sessions request.
+ *
+ * Returns: %TRUE if the portal acknowledged closing all sessions in time
+ */
+gboolean
+xdp_portal_close_all_sessions_finish (XdpPortal *portal,
+                                      GAsyncResult *result,
+                                      GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, portal), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+#endif /* XDP_HAS_REMOTE */
+
+static void
+ping_done (GObject *source,
+           GAsyncResult *result,
+           gpointer data)
+{
+  g_autoptr(GTask) task = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  if (ret == NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/* Events that a jitter buffer holds back have not been sent yet,
+ * so they go out before the Ping that waits for delivery.
+ */
+static void
+flush_held_input (XdpPortal *portal)
+{
+#if XDP_HAS_REMOTE
+  GHashTableIter iter;
+  XdpSession *session;
+
+  g_hash_table_iter_init (&iter, portal->sessions);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&session))
+    _xdp_session_flush_jitter_buffer (session);
+#endif
+}
+
+/**
+ * xdp_portal_flush:
+ * @portal: a #XdpPortal
+ * @timeout: the time to wait, in milliseconds, or -1 for the default timeout
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Waits until all portal calls that have been made without waiting
+ * for a reply, such as xdp_portal_add_notification(), xdp_portal_uninhibit(),
+ * xdp_session_close() or the input functions of remote desktop sessions,
+ * have been delivered to the portal.
+ *
+ * Input events that a jitter buffer is holding back (see
+ * xdp_session_set_jitter_buffer()) are sent right away. Keys that are
+ * held down for key repeat stay held down; no release is sent for them.
+ *
+ * This is useful before exiting a short-lived process. Calls that are
+ * still waiting for a parent window handle to be exported are not
+ * covered.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_flush_finish() to get the results.
+ */
+void
+xdp_portal_flush (XdpPortal *portal,
+                  int timeout,
+                  GCancellable *cancellable,
+                  GAsyncReadyCallback callback,
+                  gpointer data)
+{
+  GTask *task;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  task = g_task_new (portal, cancellable, callback, data);
+
+  flush_held_input (portal);
+
+  /* Messages on a connection are delivered in order, so once the
+   * portal has answered this, everything sent before has arrived.
+   */
+  g_dbus_connection_call (portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          "org.freedesktop.DBus.Peer",
+                          "Ping",
+                          NULL,
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          timeout,
+                          cancellable,
+                          ping_done,
+                          task);
+}
+
+/**
+ * xdp_portal_flush_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the flush request.
+ *
+ * Returns: %TRUE if all pending calls have been delivered
+ */
+gboolean
+xdp_portal_flush_finish (XdpPortal *portal,
+                         GAsyncResult *result,
+                         GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, portal), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * xdp_portal_flush_sync:
+ * @portal: a #XdpPortal
+ * @timeout: the time to wait, in milliseconds, or -1 for the default timeout
+ * @cancellable: (nullable): optional #GCancellable
+ * @error: return location for an error
+ *
+ * Waits until all portal calls that have been made without waiting
+ * for a reply have been delivered to the portal, like xdp_portal_flush().
+ * Input held back by jitter buffers is sent first.
+ *
+ * This function blocks, but does not iterate the main context of the
+ * calling thread, so no callbacks are run while it waits.
+ *
+ * Returns: %TRUE if all pending calls have been delivered
+ */
+gboolean
+xdp_portal_flush_sync (XdpPortal *portal,
+                       int timeout,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+  g_autoptr(GVariant) ret = NULL;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+
+  flush_held_input (portal);
+
+  ret = g_dbus_connection_call_sync (portal->bus,
+                                     PORTAL_BUS_NAME,
+                                     PORTAL_OBJECT_PATH,
+                                     "org.freedesktop.DBus.Peer",
+                                     "Ping",
+                                     NULL,
+                                     NULL,
+                                     G_DBUS_CALL_FLAGS_NONE,
+                                     timeout,
+                                     cancellable,
+                                     error);
+
+  return ret != NULL;
+}
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <gio/gio.h>
+#include <libportal/portal-features.h>
 
 G_BEGIN_DECLS
 
@@ -31,6 +32,24 @@ GType      xdp_portal_get_type               (void) G_GNUC_CONST;
 XDP_PUBLIC
 XdpPortal *xdp_portal_new                    (void);
 
+XDP_PUBLIC
+void       xdp_portal_flush                  (XdpPortal            *portal,
+                                              int                   timeout,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              data);
+
+XDP_PUBLIC
+gboolean   xdp_portal_flush_finish           (XdpPortal            *portal,
+                                              GAsyncResult         *result,
+                                              GError              **error);
+
+XDP_PUBLIC
+gboolean   xdp_portal_flush_sync             (XdpPortal            *portal,
+                                              int                   timeout,
+                                              GCancellable         *cancellable,
+                                              GError              **error);
+
 /**
  * XdpParent:
  *
@@ -50,7 +69,11 @@ typedef void     (* XdpParentUnexport) (XdpParent         *parent);
 
 struct _XdpParent {
   /*< private >*/
+#ifdef __cplusplus
+  XdpParentExport export_; /* export is a keyword in C++ */
+#else
   XdpParentExport export;
+#endif
   XdpParentUnexport unexport;
   GObject *object;
   XdpParentExported callback;
@@ -73,6 +96,8 @@ static inline void xdp_parent_free (XdpParent *parent)
 
 /* Screenshot */
 
+#if XDP_HAS_SCREENSHOT
+
 XDP_PUBLIC
 void       xdp_portal_take_screenshot        (XdpPortal           *portal,
                                               XdpParent           *parent,
@@ -99,9 +124,152 @@ GVariant * xdp_portal_pick_color_finish      (XdpPortal           *portal,
                                               GAsyncResult        *result,
                                               GError             **error);
 
+/**
+ * XdpScreenshotStorageStats:
+ * @n_files: the number of screenshots that libportal owns
+ * @n_bytes: the total size of these screenshots
+ * @n_evicted: the number of screenshots that were deleted
+ *     to stay within the limits
+ * @n_evicted_bytes: the total size of the deleted screenshots
+ *
+ * Statistics about the screenshots that libportal owns.
+ */
+typedef struct {
+  guint   n_files;
+  guint64 n_bytes;
+  guint64 n_evicted;
+  guint64 n_evicted_bytes;
+} XdpScreenshotStorageStats;
+
+XDP_PUBLIC
+void       xdp_portal_set_screenshot_storage       (XdpPortal                  *portal,
+                                                    const char                 *directory,
+                                                    guint                       max_files,
+                                                    guint64                     max_bytes);
+
+XDP_PUBLIC
+void       xdp_portal_get_screenshot_storage_stats (XdpPortal                  *portal,
+                                                    XdpScreenshotStorageStats  *stats);
+
+XDP_PUBLIC
+gboolean   xdp_portal_release_screenshot           (XdpPortal                  *portal,
+                                                    const char                 *uri,
+                                                    GError                    **error);
+
+XDP_PUBLIC
+GBytes *   xdp_portal_read_screenshot              (XdpPortal                  *portal,
+                                                    const char                 *uri,
+                                                    GError                    **error);
+
+#endif /* XDP_HAS_SCREENSHOT */
+
+/* Screenshot processing */
+
+#if XDP_HAS_SCREENSHOT_PROCESSING
+
+XDP_PUBLIC
+void       xdp_portal_process_screenshot        (XdpPortal           *portal,
+                                                 const char          *uri,
+                                                 int                  x,
+                                                 int                  y,
+                                                 int                  width,
+                                                 int                  height,
+                                                 const guint         *sizes,
+                                                 gsize                n_sizes,
+                                                 GCancellable        *cancellable,
+                                                 GAsyncReadyCallback  callback,
+                                                 gpointer             data);
+
+XDP_PUBLIC
+GVariant * xdp_portal_process_screenshot_finish (XdpPortal           *portal,
+                                                 GAsyncResult        *result,
+                                                 GError             **error);
+
+#endif /* XDP_HAS_SCREENSHOT_PROCESSING */
+
+/* Color sampling */
+
+#if XDP_HAS_SCREENSHOT
+
+/**
+ * XdpColorSampleMode:
+ * @XDP_COLOR_SAMPLE_AVERAGE: Use the mean of the pixels of a region.
+ * @XDP_COLOR_SAMPLE_MEDIAN: Use the median of each color component
+ *     of the pixels of a region, which ignores outliers such as text.
+ *
+ * How the pixels of a region are combined into one color.
+ */
+typedef enum {
+  XDP_COLOR_SAMPLE_AVERAGE,
+  XDP_COLOR_SAMPLE_MEDIAN
+} XdpColorSampleMode;
+
+/**
+ * XdpFrameFormat:
+ * @XDP_FRAME_FORMAT_RGBX: 4 bytes per pixel, in the order red, green,
+ *     blue and an ignored byte, such as alpha.
+ * @XDP_FRAME_FORMAT_BGRX: 4 bytes per pixel, in the order blue, green,
+ *     red and an ignored byte. This is the usual format of screencasts.
+ *
+ * The layout of the pixels of a video frame.
+ */
+typedef enum {
+  XDP_FRAME_FORMAT_RGBX,
+  XDP_FRAME_FORMAT_BGRX
+} XdpFrameFormat;
+
+/**
+ * XdpSampleRegion:
+ * @x: the left edge of the region
+ * @y: the top edge of the region
+ * @width: the width of the region, 0 or 1 for a single point
+ * @height: the height of the region, 0 or 1 for a single point
+ *
+ * A region of an image to read the color of.
+ */
+typedef struct {
+  int x;
+  int y;
+  int width;
+  int height;
+} XdpSampleRegion;
+
+XDP_PUBLIC
+GVariant * xdp_sample_frame_colors         (const guchar           *pixels,
+                                            int                     width,
+                                            int                     height,
+                                            int                     stride,
+                                            XdpFrameFormat          format,
+                                            const XdpSampleRegion  *regions,
+                                            gsize                   n_regions,
+                                            XdpColorSampleMode      mode,
+                                            GError                **error);
+
+#if XDP_HAS_SCREENSHOT_PROCESSING
+
+XDP_PUBLIC
+void       xdp_portal_sample_colors        (XdpPortal              *portal,
+                                            const char             *uri,
+                                            const XdpSampleRegion  *regions,
+                                            gsize                   n_regions,
+                                            XdpColorSampleMode      mode,
+                                            GCancellable           *cancellable,
+                                            GAsyncReadyCallback     callback,
+                                            gpointer                data);
+
+XDP_PUBLIC
+GVariant * xdp_portal_sample_colors_finish (XdpPortal              *portal,
+                                            GAsyncResult           *result,
+                                            GError                **error);
+
+#endif /* XDP_HAS_SCREENSHOT_PROCESSING */
+
+#endif /* XDP_HAS_SCREENSHOT */
 
 /* Notification */
 
+#if XDP_HAS_NOTIFICATION
+
 XDP_PUBLIC
 void       xdp_portal_add_notification    (XdpPortal  *portal,
                                            const char *id,
@@ -111,8 +279,12 @@ XDP_PUBLIC
 void       xdp_portal_remove_notification (XdpPortal  *portal,
                                            const char *id);
 
+#endif /* XDP_HAS_NOTIFICATION */
+
 /* Email */
 
+#if XDP_HAS_EMAIL
+
 XDP_PUBLIC
 void       xdp_portal_compose_email        (XdpPortal            *portal,
                                             XdpParent            *parent,
@@ -129,8 +301,12 @@ gboolean   xdp_portal_compose_email_finish (XdpPortal            *portal,
                                             GAsyncResult         *result,
                                             GError              **error);
 
+#endif /* XDP_HAS_EMAIL */
+
 /* Account */
 
+#if XDP_HAS_ACCOUNT
+
 XDP_PUBLIC
 void       xdp_portal_get_user_information        (XdpPortal            *portal,
                                                    XdpParent            *parent,
@@ -144,8 +320,12 @@ GVariant * xdp_portal_get_user_information_finish (XdpPortal            *portal,
                                                    GAsyncResult         *result,
                                                    GError              **error);
 
+#endif /* XDP_HAS_ACCOUNT */
+
 /* Inhibit */
 
+#if XDP_HAS_INHIBIT
+
 /**
  * XdpInhibitFlags:
  * @XDP_INHIBIT_LOGOUT: Inhibit logout.
@@ -173,16 +353,38 @@ XDP_PUBLIC
 void       xdp_portal_uninhibit                   (XdpPortal            *portal,
                                                    const char           *id);
 
+XDP_PUBLIC
+void       xdp_portal_inhibit_for_object          (XdpPortal            *portal,
+                                                   XdpParent            *parent,
+                                                   XdpInhibitFlags       inhibit,
+                                                   const char           *reason,
+                                                   gpointer              object);
+
+XDP_PUBLIC
+void       xdp_portal_inhibit_for_cancellable     (XdpPortal            *portal,
+                                                   XdpParent            *parent,
+                                                   XdpInhibitFlags       inhibit,
+                                                   const char           *reason,
+                                                   GCancellable         *cancellable);
+
+#endif /* XDP_HAS_INHIBIT */
+
 /* OpenURI */
 
+#if XDP_HAS_OPENURI
+
 XDP_PUBLIC
 void       xdp_portal_open_uri                    (XdpPortal            *portal,
                                                    XdpParent            *parent,
                                                    const char           *uri,
                                                    gboolean              writable);
 
+#endif /* XDP_HAS_OPENURI */
+
 /* Filechooser */
 
+#if XDP_HAS_FILECHOOSER
+
 XDP_PUBLIC
 void       xdp_portal_open_file                   (XdpPortal            *portal,
                                                    XdpParent            *parent,
@@ -219,8 +421,12 @@ GVariant *xdp_portal_save_file_finish             (XdpPortal            *portal,
                                                    GAsyncResult         *result,
                                                    GError              **error);
 
+#endif /* XDP_HAS_FILECHOOSER */
+
 /* Print */
 
+#if XDP_HAS_PRINT
+
 XDP_PUBLIC
 void      xdp_portal_prepare_print                (XdpPortal            *portal,
                                                    XdpParent            *parent,
@@ -253,8 +459,12 @@ gboolean xdp_portal_print_file_finish             (XdpPortal            *portal,
                                                    GAsyncResult         *result,
                                                    GError              **error);
 
+#endif /* XDP_HAS_PRINT */
+
 /* Remote desktop, screencast */
 
+#if XDP_HAS_REMOTE
+
 #define XDP_TYPE_SESSION (xdp_session_get_type ())
 
 G_DECLARE_FINAL_TYPE (XdpSession, xdp_session, XDP, SESSION, GObject)
@@ -320,12 +530,16 @@ typedef enum {
  * XdpSessionType:
  * @XDP_SESSION_SCREENCAST: a screencast session.
  * @XDP_SESSION_REMOTE_DESKTOP: a remote desktop session.
+ * @XDP_SESSION_INPUT_CAPTURE: an input capture session.
+ * @XDP_SESSION_GLOBAL_SHORTCUTS: a global shortcuts session.
  *
  * The type of a session.
  */
 typedef enum {
   XDP_SESSION_SCREENCAST,
-  XDP_SESSION_REMOTE_DESKTOP
+  XDP_SESSION_REMOTE_DESKTOP,
+  XDP_SESSION_INPUT_CAPTURE,
+  XDP_SESSION_GLOBAL_SHORTCUTS
 } XdpSessionType;
 
 /**
@@ -369,6 +583,34 @@ XdpSession *xdp_portal_create_remote_desktop_session_finish (XdpPortal
                                                              GAsyncResult         *result,
                                                              GError              **error);
 
+XDP_PUBLIC
+GList      *xdp_portal_get_sessions                         (XdpPortal            *portal);
+
+XDP_PUBLIC
+guint       xdp_portal_get_n_sessions                       (XdpPortal            *portal,
+                                                             XdpSessionType        type);
+
+XDP_PUBLIC
+void        xdp_portal_close_all_sessions                   (XdpPortal            *portal,
+                                                             int                   timeout,
+                                                             GCancellable         *cancellable,
+                                                             GAsyncReadyCallback   callback,
+                                                             gpointer              data);
+
+XDP_PUBLIC
+gboolean    xdp_portal_close_all_sessions_finish            (XdpPortal            *portal,
+                                                             GAsyncResult         *result,
+                                                             GError              **error);
+
+XDP_PUBLIC
+void        xdp_portal_set_session_pool                     (XdpPortal            *portal,
+                                                             XdpSessionType        type,
+                                                             XdpDeviceType         devices,
+                                                             XdpOutputType         outputs,
+                                                             gboolean              multiple,
+                                                             guint                 size,
+                                                             guint                 ttl);
+
 XDP_PUBLIC
 void        xdp_session_start                (XdpSession           *session,
                                               XdpParent            *parent,
@@ -387,6 +629,13 @@ void        xdp_session_close                (XdpSession           *session);
 XDP_PUBLIC
 int         xdp_session_open_pipewire_remote (XdpSession           *session);
 
+XDP_PUBLIC
+void        xdp_session_set_auto_reconnect   (XdpSession           *session,
+                                              gboolean              auto_reconnect);
+
+XDP_PUBLIC
+gboolean    xdp_session_get_auto_reconnect   (XdpSession           *session);
+
 XDP_PUBLIC
 XdpSessionType  xdp_session_get_session_type  (XdpSession *session);
 
@@ -470,6 +719,29 @@ void      xdp_session_keyboard_key   (XdpSession *session,
                                       int         key,
                                       XdpKeyState state);
 
+/**
+ * XdpKeyRepeatMode:
+ * @XDP_KEY_REPEAT_NONE: pass all key events on as they are
+ * @XDP_KEY_REPEAT_COMPOSITOR: drop repeated presses of held keys,
+ *     and let the compositor repeat them
+ * @XDP_KEY_REPEAT_LOCAL: drop repeated presses of held keys,
+ *     and repeat them with a local timer
+ *
+ * The XdpKeyRepeatMode enumeration is used to describe
+ * how held keys are repeated.
+ */
+typedef enum {
+  XDP_KEY_REPEAT_NONE,
+  XDP_KEY_REPEAT_COMPOSITOR,
+  XDP_KEY_REPEAT_LOCAL
+} XdpKeyRepeatMode;
+
+XDP_PUBLIC
+void      xdp_session_set_key_repeat (XdpSession       *session,
+                                      XdpKeyRepeatMode  mode,
+                                      guint             delay,
+                                      guint             interval);
+
 XDP_PUBLIC
 void      xdp_session_touch_down     (XdpSession *session,
                                       guint       stream,
@@ -488,5 +760,589 @@ XDP_PUBLIC
 void      xdp_session_touch_up       (XdpSession *session,
                                       guint       slot);
 
+/**
+ * XdpTouchGestureType:
+ * @XDP_TOUCH_GESTURE_PINCH: the distance of the touch points from
+ *     the center changes
+ * @XDP_TOUCH_GESTURE_ROTATE: the touch points rotate around the center
+ * @XDP_TOUCH_GESTURE_SWIPE: the touch points move in parallel
+ *
+ * The XdpTouchGestureType enumeration is used to describe
+ * the kind of a touch gesture.
+ */
+typedef enum {
+  XDP_TOUCH_GESTURE_PINCH,
+  XDP_TOUCH_GESTURE_ROTATE,
+  XDP_TOUCH_GESTURE_SWIPE
+} XdpTouchGestureType;
+
+/**
+ * XdpTouchGesture:
+ * @type: the kind of gesture
+ * @stream: the node ID of the pipewire stream the positions are relative to
+ * @n_fingers: the number of touch points, or 0 for 2
+ * @x: X position of the center of the gesture
+ * @y: Y position of the center of the gesture
+ * @start_radius: distance of the touch points from the center at the start
+ * @end_radius: distance of the touch points from the center at the end,
+ *     for %XDP_TOUCH_GESTURE_PINCH
+ * @start_angle: angle of the first touch point at the start, in radians
+ * @end_angle: angle of the first touch point at the end, in radians,
+ *     for %XDP_TOUCH_GESTURE_ROTATE
+ * @dx: horizontal movement of the touch points, for %XDP_TOUCH_GESTURE_SWIPE
+ * @dy: vertical movement of the touch points, for %XDP_TOUCH_GESTURE_SWIPE
+ * @duration: the duration of the gesture, in milliseconds
+ * @frame_rate: the number of frames per second, or 0 for 60
+ *
+ * A description of a touch gesture. The touch points are spread evenly on
+ * a circle around the center. Positions are in the logical coordinate
+ * space of the stream.
+ */
+typedef struct {
+  XdpTouchGestureType type;
+  guint  stream;
+  guint  n_fingers;
+  double x;
+  double y;
+  double start_radius;
+  double end_radius;
+  double start_angle;
+  double end_angle;
+  double dx;
+  double dy;
+  guint  duration;
+  guint  frame_rate;
+} XdpTouchGesture;
+
+XDP_PUBLIC
+void      xdp_session_touch_gesture        (XdpSession            *session,
+                                            const XdpTouchGesture *gesture,
+                                            GCancellable          *cancellable,
+                                            GAsyncReadyCallback    callback,
+                                            gpointer               data);
+
+XDP_PUBLIC
+gboolean  xdp_session_touch_gesture_finish (XdpSession            *session,
+                                            GAsyncResult          *result,
+                                            GError               **error);
+
+/* Jitter buffer */
+
+/**
+ * XdpJitterBufferStats:
+ * @n_received: the number of events that entered the buffer
+ * @n_released: the number of events that were passed on
+ * @n_late: the number of timestamped events that arrived after
+ *     their scheduled release time
+ * @depth: the number of events currently held
+ * @max_depth: the largest number of events that were held at once
+ * @delay: the current delay for timestamped events, in microseconds
+ * @jitter: the estimated network jitter, in microseconds
+ *
+ * Statistics about the jitter buffer of a remote desktop session.
+ */
+typedef struct {
+  guint64 n_received;
+  guint64 n_released;
+  guint64 n_late;
+  guint   depth;
+  guint   max_depth;
+  gint64  delay;
+  gint64  jitter;
+} XdpJitterBufferStats;
+
+XDP_PUBLIC
+void      xdp_session_set_jitter_buffer       (XdpSession           *session,
+                                               guint                 max_delay,
+                                               gboolean              adaptive);
+
+XDP_PUBLIC
+void      xdp_session_set_input_time          (XdpSession           *session,
+                                               gint64                time);
+
+XDP_PUBLIC
+void      xdp_session_get_jitter_buffer_stats (XdpSession           *session,
+                                               XdpJitterBufferStats *stats);
+
+/* Input latency */
+
+/**
+ * XdpLatencyStats:
+ * @n_samples: the number of recorded samples
+ * @n_lost: the number of markers that were never seen in a frame
+ * @n_pending: the number of markers that are still waiting for a frame
+ * @min: the smallest latency
+ * @max: the largest latency
+ * @mean: the average latency
+ * @p50: the median latency
+ * @p90: the 90th percentile of the latency
+ * @p99: the 99th percentile of the latency
+ *
+ * The distribution of input-to-frame latencies recorded for a session.
+ * All times are in microseconds.
+ */
+typedef struct {
+  guint  n_samples;
+  guint  n_lost;
+  guint  n_pending;
+  gint64 min;
+  gint64 max;
+  gint64 mean;
+  gint64 p50;
+  gint64 p90;
+  gint64 p99;
+} XdpLatencyStats;
+
+XDP_PUBLIC
+guint     xdp_session_send_latency_marker  (XdpSession      *session,
+                                            guint            stream,
+                                            double           x,
+                                            double           y);
+
+XDP_PUBLIC
+guint     xdp_session_notify_frame         (XdpSession      *session,
+                                            guint            stream,
+                                            double           x,
+                                            double           y,
+                                            gint64           frame_time);
+
+XDP_PUBLIC
+void      xdp_session_get_latency_stats    (XdpSession      *session,
+                                            XdpLatencyStats *stats);
+
+XDP_PUBLIC
+void      xdp_session_reset_latency_stats  (XdpSession      *session);
+
+#endif /* XDP_HAS_REMOTE */
+
+/* Realtime */
+
+#if XDP_HAS_REALTIME
+
+XDP_PUBLIC
+gboolean   xdp_portal_get_realtime_limits               (XdpPortal            *portal,
+                                                         int                  *max_realtime_priority,
+                                                         int                  *min_nice_level,
+                                                         gint64               *rttime_usec_max,
+                                                         GCancellable         *cancellable,
+                                                         GError              **error);
+
+XDP_PUBLIC
+void       xdp_portal_make_thread_realtime              (XdpPortal            *portal,
+                                                         guint64               thread,
+                                                         guint                 priority,
+                                                         GCancellable         *cancellable,
+                                                         GAsyncReadyCallback   callback,
+                                                         gpointer              data);
+
+XDP_PUBLIC
+gboolean   xdp_portal_make_thread_realtime_finish       (XdpPortal            *portal,
+                                                         GAsyncResult         *result,
+                                                         GError              **error);
+
+XDP_PUBLIC
+gboolean   xdp_portal_make_thread_realtime_sync         (XdpPortal            *portal,
+                                                         guint64               thread,
+                                                         guint                 priority,
+                                                         GCancellable         *cancellable,
+                                                         GError              **error);
+
+XDP_PUBLIC
+void       xdp_portal_make_thread_high_priority         (XdpPortal            *portal,
+                                                         guint64               thread,
+                                                         int                   nice_level,
+                                                         GCancellable         *cancellable,
+                                                         GAsyncReadyCallback   callback,
+                                                         gpointer              data);
+
+XDP_PUBLIC
+gboolean   xdp_portal_make_thread_high_priority_finish  (XdpPortal            *portal,
+                                                         GAsyncResult         *result,
+                                                         GError              **error);
+
+XDP_PUBLIC
+gboolean   xdp_portal_make_thread_high_priority_sync    (XdpPortal            *portal,
+                                                         guint64               thread,
+                                                         int                   nice_level,
+                                                         GCancellable         *cancellable,
+                                                         GError              **error);
+
+#if XDP_HAS_REMOTE
+
+XDP_PUBLIC
+void       xdp_session_make_input_thread_realtime        (XdpSession           *session,
+                                                         guint                 priority,
+                                                         GCancellable         *cancellable,
+                                                         GAsyncReadyCallback   callback,
+                                                         gpointer              data);
+
+XDP_PUBLIC
+gboolean   xdp_session_make_input_thread_realtime_finish (XdpSession           *session,
+                                                         GAsyncResult         *result,
+                                                         GError              **error);
+
+#endif /* XDP_HAS_REMOTE */
+
+#endif /* XDP_HAS_REALTIME */
+
+/* GameMode */
+
+#if XDP_HAS_GAMEMODE
+
+/**
+ * XdpGameModeStatus:
+ * @XDP_GAMEMODE_INACTIVE: GameMode is not active.
+ * @XDP_GAMEMODE_ACTIVE: GameMode is active for other processes.
+ * @XDP_GAMEMODE_REGISTERED: GameMode is active, and this process is registered.
+ *
+ * The status of GameMode, as seen by this process.
+ */
+typedef enum {
+  XDP_GAMEMODE_INACTIVE   = 0,
+  XDP_GAMEMODE_ACTIVE     = 1,
+  XDP_GAMEMODE_REGISTERED = 2
+} XdpGameModeStatus;
+
+XDP_PUBLIC
+void              xdp_portal_gamemode_register            (XdpPortal            *portal,
+                                                           GCancellable         *cancellable,
+                                                           GAsyncReadyCallback   callback,
+                                                           gpointer              data);
+
+XDP_PUBLIC
+gboolean          xdp_portal_gamemode_register_finish     (XdpPortal            *portal,
+                                                           GAsyncResult         *result,
+                                                           GError              **error);
+
+XDP_PUBLIC
+void              xdp_portal_gamemode_unregister          (XdpPortal            *portal);
+
+XDP_PUBLIC
+void              xdp_portal_gamemode_query_status        (XdpPortal            *portal,
+                                                           GCancellable         *cancellable,
+                                                           GAsyncReadyCallback   callback,
+                                                           gpointer              data);
+
+XDP_PUBLIC
+XdpGameModeStatus xdp_portal_gamemode_query_status_finish (XdpPortal            *portal,
+                                                           GAsyncResult         *result,
+                                                           GError              **error);
+
+#endif /* XDP_HAS_GAMEMODE */
+
+/* Clipboard */
+
+#if XDP_HAS_REMOTE
+
+XDP_PUBLIC
+void          xdp_session_request_clipboard       (XdpSession           *session);
+
+XDP_PUBLIC
+gboolean      xdp_session_is_clipboard_enabled    (XdpSession           *session);
+
+XDP_PUBLIC
+void          xdp_session_set_selection           (XdpSession           *session,
+                                                   const char * const   *mime_types);
+
+XDP_PUBLIC
+void          xdp_session_selection_write         (XdpSession           *session,
+                                                   guint                 serial,
+                                                   GInputStream         *source,
+                                                   GCancellable         *cancellable,
+                                                   GAsyncReadyCallback   callback,
+                                                   gpointer              data);
+
+XDP_PUBLIC
+gboolean      xdp_session_selection_write_finish  (XdpSession           *session,
+                                                   GAsyncResult         *result,
+                                                   GError              **error);
+
+XDP_PUBLIC
+void          xdp_session_selection_write_done    (XdpSession           *session,
+                                                   guint                 serial,
+                                                   gboolean              success);
+
+XDP_PUBLIC
+void          xdp_session_selection_read          (XdpSession           *session,
+                                                   const char           *mime_type,
+                                                   GCancellable         *cancellable,
+                                                   GAsyncReadyCallback   callback,
+                                                   gpointer              data);
+
+XDP_PUBLIC
+GInputStream *xdp_session_selection_read_finish   (XdpSession           *session,
+                                                   GAsyncResult         *result,
+                                                   GError              **error);
+
+#endif /* XDP_HAS_REMOTE */
+
+/* Input capture */
+
+#if XDP_HAS_INPUTCAPTURE
+
+/**
+ * XdpInputCapability:
+ * @XDP_INPUT_CAPABILITY_KEYBOARD: capture the keyboard
+ * @XDP_INPUT_CAPABILITY_POINTER: capture pointer devices
+ * @XDP_INPUT_CAPABILITY_TOUCHSCREEN: capture touchscreens
+ *
+ * Flags to specify what input devices to capture.
+ */
+typedef enum {
+  XDP_INPUT_CAPABILITY_KEYBOARD    = 1,
+  XDP_INPUT_CAPABILITY_POINTER     = 2,
+  XDP_INPUT_CAPABILITY_TOUCHSCREEN = 4
+} XdpInputCapability;
+
+/**
+ * XdpPointerBarrier:
+ * @id: the ID of the barrier, must not be 0
+ * @x1: the x coordinate of the start of the barrier
+ * @y1: the y coordinate of the start of the barrier
+ * @x2: the x coordinate of the end of the barrier
+ * @y2: the y coordinate of the end of the barrier
+ *
+ * A pointer barrier along the edge of a zone.
+ */
+typedef struct {
+  guint id;
+  int x1;
+  int y1;
+  int x2;
+  int y2;
+} XdpPointerBarrier;
+
+XDP_PUBLIC
+void               xdp_portal_create_input_capture_session        (XdpPortal               *portal,
+                                                                   XdpParent               *parent,
+                                                                   XdpInputCapability       capabilities,
+                                                                   GCancellable            *cancellable,
+                                                                   GAsyncReadyCallback      callback,
+                                                                   gpointer                 data);
+
+XDP_PUBLIC
+XdpSession        *xdp_portal_create_input_capture_session_finish (XdpPortal               *portal,
+                                                                   GAsyncResult            *result,
+                                                                   GError                 **error);
+
+XDP_PUBLIC
+XdpInputCapability xdp_session_get_capabilities                   (XdpSession              *session);
+
+XDP_PUBLIC
+GVariant          *xdp_session_get_zones                          (XdpSession              *session);
+
+XDP_PUBLIC
+void               xdp_session_set_pointer_barriers               (XdpSession              *session,
+                                                                   const XdpPointerBarrier *barriers,
+                                                                   gsize                    n_barriers,
+                                                                   GCancellable            *cancellable,
+                                                                   GAsyncReadyCallback      callback,
+                                                                   gpointer                 data);
+
+XDP_PUBLIC
+GVariant          *xdp_session_set_pointer_barriers_finish        (XdpSession              *session,
+                                                                   GAsyncResult            *result,
+                                                                   GError                 **error);
+
+XDP_PUBLIC
+void               xdp_session_enable_input_capture               (XdpSession              *session);
+
+XDP_PUBLIC
+void               xdp_session_disable_input_capture              (XdpSession              *session);
+
+XDP_PUBLIC
+void               xdp_session_release_input_capture              (XdpSession              *session,
+                                                                   guint                    activation_id,
+                                                                   gboolean                 set_position,
+                                                                   double                   x,
+                                                                   double                   y);
+
+XDP_PUBLIC
+int                xdp_session_connect_to_eis                     (XdpSession              *session,
+                                                                   GError                 **error);
+
+#endif /* XDP_HAS_INPUTCAPTURE */
+
+/* Global shortcuts */
+
+#if XDP_HAS_GLOBALSHORTCUTS
+
+/**
+ * XdpShortcutHandler:
+ * @session: the #XdpSession
+ * @id: the ID of the shortcut
+ * @activated: %TRUE if the shortcut was pressed, %FALSE if it was released
+ * @timestamp: the time of the event, in milliseconds, as reported by the compositor
+ * @data: the data passed to xdp_session_add_shortcut()
+ *
+ * The type of the functions that are called when a global shortcut
+ * is pressed or released.
+ */
+typedef void (* XdpShortcutHandler) (XdpSession *session,
+                                     const char *id,
+                                     gboolean    activated,
+                                     guint64     timestamp,
+                                     gpointer    data);
+
+XDP_PUBLIC
+void        xdp_portal_create_global_shortcuts_session        (XdpPortal            *portal,
+                                                               GCancellable         *cancellable,
+                                                               GAsyncReadyCallback   callback,
+                                                               gpointer              data);
+
+XDP_PUBLIC
+XdpSession *xdp_portal_create_global_shortcuts_session_finish (XdpPortal            *portal,
+                                                               GAsyncResult         *result,
+                                                               GError              **error);
+
+XDP_PUBLIC
+void        xdp_session_add_shortcut                          (XdpSession           *session,
+                                                               const char           *id,
+                                                               const char           *description,
+                                                               const char           *preferred_trigger,
+                                                               XdpShortcutHandler    handler,
+                                                               gpointer              data,
+                                                               GDestroyNotify        destroy);
+
+XDP_PUBLIC
+void        xdp_session_bind_shortcuts                        (XdpSession           *session,
+                                                               XdpParent            *parent,
+                                                               GCancellable         *cancellable,
+                                                               GAsyncReadyCallback   callback,
+                                                               gpointer              data);
+
+XDP_PUBLIC
+GVariant   *xdp_session_bind_shortcuts_finish                 (XdpSession           *session,
+                                                               GAsyncResult         *result,
+                                                               GError              **error);
+
+#endif /* XDP_HAS_GLOBALSHORTCUTS */
+
+/* Dynamic launcher */
+
+#if XDP_HAS_DYNAMICLAUNCHER
+
+/**
+ * XdpLauncherInstallFlags:
+ * @XDP_LAUNCHER_INSTALL_FLAG_NONE: No options.
+ * @XDP_LAUNCHER_INSTALL_FLAG_INTERACTIVE: Ask the user to confirm each launcher.
+ *
+ * Options for installing launchers.
+ */
+typedef enum {
+  XDP_LAUNCHER_INSTALL_FLAG_NONE        = 0,
+  XDP_LAUNCHER_INSTALL_FLAG_INTERACTIVE = 1
+} XdpLauncherInstallFlags;
+
+/**
+ * XdpLauncher:
+ * @name: the name of the launcher, as shown to the user
+ * @icon_file: the path of a PNG, JPEG or SVG file to use as icon
+ * @desktop_file_id: the desktop file ID, which must have the
+ *     application ID as prefix
+ * @desktop_entry: the contents of the desktop file
+ * @target: (nullable): the URL to open, for web application launchers
+ *
+ * Information about a launcher to install.
+ */
+typedef struct {
+  const char *name;
+  const char *icon_file;
+  const char *desktop_file_id;
+  const char *desktop_entry;
+  const char *target;
+} XdpLauncher;
+
+XDP_PUBLIC
+void      xdp_portal_install_launchers        (XdpPortal               *portal,
+                                               XdpParent               *parent,
+                                               const XdpLauncher       *launchers,
+                                               gsize                    n_launchers,
+                                               XdpLauncherInstallFlags  flags,
+                                               guint                    max_concurrent,
+                                               GCancellable            *cancellable,
+                                               GAsyncReadyCallback      callback,
+                                               gpointer                 data);
+
+XDP_PUBLIC
+GVariant *xdp_portal_install_launchers_finish (XdpPortal               *portal,
+                                               GAsyncResult            *result,
+                                               GError                 **error);
+
+XDP_PUBLIC
+gboolean  xdp_portal_uninstall_launcher       (XdpPortal               *portal,
+                                               const char              *desktop_file_id,
+                                               GError                 **error);
+
+#endif /* XDP_HAS_DYNAMICLAUNCHER */
+
+/* Batch */
+
+#define XDP_TYPE_BATCH (xdp_batch_get_type ())
+
+G_DECLARE_FINAL_TYPE (XdpBatch, xdp_batch, XDP, BATCH, GObject)
+
+/**
+ * XdpBatchStartFunc:
+ * @portal: the #XdpPortal of the batch
+ * @parent: (nullable): the parent window of the batch
+ * @cancellable: (nullable): the #GCancellable of the batch
+ * @callback: the callback to pass to the call
+ * @callback_data: the data to pass to the call, for @callback
+ * @data: the data passed to xdp_batch_add()
+ *
+ * The type of the functions that start the operations of a #XdpBatch.
+ */
+typedef void (* XdpBatchStartFunc) (XdpPortal           *portal,
+                                    XdpParent           *parent,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             callback_data,
+                                    gpointer             data);
+
+/**
+ * XdpBatchCallFunc:
+ * @portal: the #XdpPortal of the batch
+ * @data: the data passed to xdp_batch_add_call()
+ *
+ * The type of the functions that make calls without
+ * a reply as part of a #XdpBatch.
+ */
+typedef void (* XdpBatchCallFunc) (XdpPortal *portal,
+                                   gpointer   data);
+
+XDP_PUBLIC
+GType         xdp_batch_get_type   (void) G_GNUC_CONST;
+
+XDP_PUBLIC
+XdpBatch     *xdp_batch_new        (XdpPortal            *portal,
+                                    XdpParent            *parent);
+
+XDP_PUBLIC
+guint         xdp_batch_add        (XdpBatch             *batch,
+                                    XdpBatchStartFunc     start,
+                                    gpointer              data,
+                                    GDestroyNotify        destroy);
+
+XDP_PUBLIC
+void          xdp_batch_add_call   (XdpBatch             *batch,
+                                    XdpBatchCallFunc      call,
+                                    gpointer              data,
+                                    GDestroyNotify        destroy);
+
+XDP_PUBLIC
+void          xdp_batch_run        (XdpBatch             *batch,
+                                    GCancellable         *cancellable,
+                                    GAsyncReadyCallback   callback,
+                                    gpointer              data);
+
+XDP_PUBLIC
+gboolean      xdp_batch_run_finish (XdpBatch             *batch,
+                                    GAsyncResult         *result,
+                                    GError              **error);
+
+XDP_PUBLIC
+GAsyncResult *xdp_batch_get_result (XdpBatch             *batch,
+                                    guint                 index);
 
 G_END_DECLS
@@ -0,0 +1,840 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* C++20 wrappers for libportal.
+ *
+ * Each asynchronous call is available as an awaitable that can be used
+ * with co_await in a coroutine. The awaitable lives in the coroutine
+ * frame and is passed to the C function as callback data, so awaiting
+ * a call needs no allocations besides those of the call itself. The
+ * coroutine is resumed from the main context of the call.
+ *
+ * The arguments of a call are used when it is awaited, so the awaitable
+ * should be awaited right away:
+ *
+ *   xdp::Variant files = co_await xdp::open_file (portal, nullptr, "Open", true, false);
+ *
+ * Errors are thrown as xdp::Error.
+ *
+ * Every function of libportal that takes a GAsyncReadyCallback has a
+ * wrapper here, named after it without the xdp_portal_ or xdp_session_
+ * prefix; xdp_batch_run() is xdp::run(). Functions that return right
+ * away, such as xdp_portal_open_uri() or the input functions of remote
+ * desktop sessions, are called directly.
+ */
+
+#include <libportal/portal.h>
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <utility>
+
+namespace xdp {
+
+class Error : public std::exception
+{
+public:
+  explicit Error (GError *error) noexcept : error_ (error) {}
+  Error (const Error &other) noexcept : error_ (g_error_copy (other.error_)) {}
+  Error &operator= (const Error &other) noexcept
+  {
+    if (this != &other)
+      {
+        g_clear_error (&error_);
+        error_ = g_error_copy (other.error_);
+      }
+    return *this;
+  }
+  ~Error () override { g_clear_error (&error_); }
+
+  const char *what () const noexcept override { return error_->message; }
+  GQuark domain () const noexcept { return error_->domain; }
+  int code () const noexcept { return error_->code; }
+  bool matches (GQuark domain, int code) const noexcept { return g_error_matches (error_, domain, code); }
+
+private:
+  GError *error_;
+};
+
+/* An owned reference to a GObject */
+template <typename T>
+class Object
+{
+public:
+  Object () noexcept = default;
+  explicit Object (T *ptr) noexcept : ptr_ (ptr) {}
+  Object (const Object &other) noexcept : ptr_ (other.ptr_ ? static_cast<T *> (g_object_ref (other.ptr_)) : nullptr) {}
+  Object (Object &&other) noexcept : ptr_ (std::exchange (other.ptr_, nullptr)) {}
+  Object &operator= (Object other) noexcept { std::swap (ptr_, other.ptr_); return *this; }
+  ~Object () { if (ptr_) g_object_unref (ptr_); }
+
+  T *get () const noexcept { return ptr_; }
+  T *release () noexcept { return std::exchange (ptr_, nullptr); }
+  explicit operator bool () const noexcept { return ptr_ != nullptr; }
+  operator T * () const noexcept { return ptr_; }
+
+private:
+  T *ptr_ = nullptr;
+};
+
+using Portal = Object<XdpPortal>;
+
+inline Portal
+make_portal ()
+{
+  return Portal (xdp_portal_new ());
+}
+
+/* An owned reference to a GVariant */
+class Variant
+{
+public:
+  Variant () noexcept = default;
+  explicit Variant (GVariant *variant) noexcept : variant_ (variant ? g_variant_take_ref (variant) : nullptr) {}
+  Variant (const Variant &other) noexcept : variant_ (other.variant_ ? g_variant_ref (other.variant_) : nullptr) {}
+  Variant (Variant &&other) noexcept : variant_ (std::exchange (other.variant_, nullptr)) {}
+  Variant &operator= (Variant other) noexcept { std::swap (variant_, other.variant_); return *this; }
+  ~Variant () { if (variant_) g_variant_unref (variant_); }
+
+  GVariant *get () const noexcept { return variant_; }
+  explicit operator bool () const noexcept { return variant_ != nullptr; }
+  operator GVariant * () const noexcept { return variant_; }
+
+private:
+  GVariant *variant_ = nullptr;
+};
+
+/* Owns an XdpParent, such as one from xdp_parent_new_gtk() */
+class Parent
+{
+public:
+  Parent () noexcept = default;
+  explicit Parent (XdpParent *parent) noexcept : parent_ (parent) {}
+  Parent (const Parent &) = delete;
+  Parent &operator= (const Parent &) = delete;
+  Parent (Parent &&other) noexcept : parent_ (std::exchange (other.parent_, nullptr)) {}
+  Parent &operator= (Parent &&other) noexcept { std::swap (parent_, other.parent_); return *this; }
+  ~Parent () { if (parent_) xdp_parent_free (parent_); }
+
+  XdpParent *get () const noexcept { return parent_; }
+  operator XdpParent * () const noexcept { return parent_; }
+
+private:
+  XdpParent *parent_ = nullptr;
+};
+
+#if XDP_HAS_REMOTE
+
+/* Owns a session, and closes it when it goes away while active */
+class Session
+{
+public:
+  Session () noexcept = default;
+  explicit Session (XdpSession *session) noexcept : session_ (session) {}
+  Session (const Session &) = delete;
+  Session &operator= (const Session &) = delete;
+  Session (Session &&other) noexcept = default;
+  Session &operator= (Session &&other) noexcept
+  {
+    close ();
+    session_ = std::move (other.session_);
+    return *this;
+  }
+  ~Session () { close (); }
+
+  XdpSession *get () const noexcept { return session_.get (); }
+  operator XdpSession * () const noexcept { return session_.get (); }
+
+  void
+  close () noexcept
+  {
+    if (session_ && xdp_session_get_session_state (session_) == XDP_SESSION_ACTIVE)
+      xdp_session_close (session_);
+  }
+
+private:
+  Object<XdpSession> session_;
+};
+
+#endif
+
+#if XDP_HAS_INHIBIT
+
+/* Holds an inhibition for as long as it exists */
+class Inhibitor
+{
+public:
+  Inhibitor (XdpPortal *portal,
+             XdpParent *parent,
+             XdpInhibitFlags flags,
+             const char *reason,
+             std::string id)
+    : portal_ (static_cast<XdpPortal *> (g_object_ref (portal))),
+      id_ (std::move (id))
+  {
+    xdp_portal_inhibit (portal, parent, flags, reason, id_.c_str ());
+  }
+  Inhibitor (const Inhibitor &) = delete;
+  Inhibitor &operator= (const Inhibitor &) = delete;
+  Inhibitor (Inhibitor &&other) noexcept = default;
+  Inhibitor &operator= (Inhibitor &&) = delete;
+  ~Inhibitor () { if (portal_) xdp_portal_uninhibit (portal_, id_.c_str ()); }
+
+  const std::string &id () const noexcept { return id_; }
+
+private:
+  Portal portal_;
+  std::string id_;
+};
+
+#endif
+
+namespace detail {
+
+inline void
+check (GError *error)
+{
+  if (error)
+    throw Error (error);
+}
+
+/* @Start starts the call with a callback and data,
+ * @Finish turns the GAsyncResult into the value of co_await.
+ */
+template <typename Start, typename Finish>
+class Operation
+{
+public:
+  Operation (Start start, Finish finish) : start_ (std::move (start)), finish_ (std::move (finish)) {}
+  Operation (const Operation &) = delete;
+  Operation &operator= (const Operation &) = delete;
+  ~Operation () { if (result_) g_object_unref (result_); }
+
+  bool await_ready () const noexcept { return false; }
+
+  void
+  await_suspend (std::coroutine_handle<> handle)
+  {
+    handle_ = handle;
+    start_ (&Operation::ready, this);
+  }
+
+  decltype (auto) await_resume () { return finish_ (result_); }
+
+private:
+  static void
+  ready (GObject *source,
+         GAsyncResult *result,
+         gpointer data)
+  {
+    auto *self = static_cast<Operation *> (data);
+
+    self->result_ = G_ASYNC_RESULT (g_object_ref (result));
+    self->handle_.resume ();
+  }
+
+  Start start_;
+  Finish finish_;
+  std::coroutine_handle<> handle_;
+  GAsyncResult *result_ = nullptr;
+};
+
+} // namespace detail
+
+#if XDP_HAS_FILECHOOSER
+
+inline auto
+open_file (XdpPortal *portal,
+           XdpParent *parent,
+           const char *title,
+           bool modal,
+           bool multiple,
+           GVariant *filters = nullptr,
+           GVariant *choices = nullptr,
+           GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_open_file (portal, parent, title, modal, multiple, filters, choices, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_open_file_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+inline auto
+save_file (XdpPortal *portal,
+           XdpParent *parent,
+           const char *title,
+           bool modal,
+           const char *current_name,
+           const char *current_folder = nullptr,
+           const char *current_file = nullptr,
+           GVariant *filters = nullptr,
+           GVariant *choices = nullptr,
+           GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_save_file (portal, parent, title, modal, current_name, current_folder, current_file,
+                            filters, choices, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_save_file_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+#if XDP_HAS_SCREENSHOT
+
+inline auto
+take_screenshot (XdpPortal *portal,
+                 XdpParent *parent,
+                 bool modal,
+                 bool interactive,
+                 GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_take_screenshot (portal, parent, modal, interactive, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      char *uri = xdp_portal_take_screenshot_finish (portal, result, &error);
+      detail::check (error);
+      std::string ret (uri);
+      g_free (uri);
+      return ret;
+    });
+}
+
+inline auto
+pick_color (XdpPortal *portal,
+            XdpParent *parent,
+            GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_pick_color (portal, parent, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_pick_color_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+#if XDP_HAS_SCREENSHOT_PROCESSING
+
+inline auto
+process_screenshot (XdpPortal *portal,
+                    const char *uri,
+                    int x,
+                    int y,
+                    int width,
+                    int height,
+                    const guint *sizes,
+                    gsize n_sizes,
+                    GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_process_screenshot (portal, uri, x, y, width, height, sizes, n_sizes, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_process_screenshot_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+inline auto
+sample_colors (XdpPortal *portal,
+               const char *uri,
+               const XdpSampleRegion *regions,
+               gsize n_regions,
+               XdpColorSampleMode mode,
+               GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_sample_colors (portal, uri, regions, n_regions, mode, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_sample_colors_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+#if XDP_HAS_ACCOUNT
+
+inline auto
+get_user_information (XdpPortal *portal,
+                      XdpParent *parent,
+                      const char *reason,
+                      GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_get_user_information (portal, parent, reason, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_get_user_information_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+#if XDP_HAS_EMAIL
+
+inline auto
+compose_email (XdpPortal *portal,
+               XdpParent *parent,
+               const char *address,
+               const char *subject,
+               const char *body,
+               const char *const *attachments = nullptr,
+               GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_compose_email (portal, parent, address, subject, body, attachments, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_compose_email_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+#endif
+
+#if XDP_HAS_PRINT
+
+inline auto
+prepare_print (XdpPortal *portal,
+               XdpParent *parent,
+               const char *title,
+               bool modal,
+               GVariant *settings = nullptr,
+               GVariant *page_setup = nullptr,
+               GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_prepare_print (portal, parent, title, modal, settings, page_setup, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_prepare_print_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+inline auto
+print_file (XdpPortal *portal,
+            XdpParent *parent,
+            const char *title,
+            bool modal,
+            guint token,
+            const char *file,
+            GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_print_file (portal, parent, title, modal, token, file, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_print_file_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+#endif
+
+#if XDP_HAS_REMOTE
+
+inline auto
+create_screencast_session (XdpPortal *portal,
+                           XdpOutputType outputs,
+                           bool multiple,
+                           GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_create_screencast_session (portal, outputs, multiple, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      XdpSession *session = xdp_portal_create_screencast_session_finish (portal, result, &error);
+      detail::check (error);
+      return Session (session);
+    });
+}
+
+inline auto
+create_remote_desktop_session (XdpPortal *portal,
+                               XdpDeviceType devices,
+                               XdpOutputType outputs,
+                               bool multiple,
+                               GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_create_remote_desktop_session (portal, devices, outputs, multiple, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      XdpSession *session = xdp_portal_create_remote_desktop_session_finish (portal, result, &error);
+      detail::check (error);
+      return Session (session);
+    });
+}
+
+inline auto
+start (XdpSession *session,
+       XdpParent *parent,
+       GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_start (session, parent, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_session_start_finish (session, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+close_all_sessions (XdpPortal *portal,
+                    int timeout = -1,
+                    GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_close_all_sessions (portal, timeout, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_close_all_sessions_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+touch_gesture (XdpSession *session,
+               const XdpTouchGesture *gesture,
+               GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_touch_gesture (session, gesture, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_session_touch_gesture_finish (session, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+selection_write (XdpSession *session,
+                 guint serial,
+                 GInputStream *source,
+                 GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_selection_write (session, serial, source, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_session_selection_write_finish (session, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+selection_read (XdpSession *session,
+                const char *mime_type,
+                GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_selection_read (session, mime_type, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GInputStream *stream = xdp_session_selection_read_finish (session, result, &error);
+      detail::check (error);
+      return Object<GInputStream> (stream);
+    });
+}
+#endif
+
+#if XDP_HAS_REALTIME
+
+inline auto
+make_thread_realtime (XdpPortal *portal,
+                      guint64 thread,
+                      guint priority,
+                      GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_make_thread_realtime (portal, thread, priority, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_make_thread_realtime_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+make_thread_high_priority (XdpPortal *portal,
+                           guint64 thread,
+                           int nice_level,
+                           GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_make_thread_high_priority (portal, thread, nice_level, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_make_thread_high_priority_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+#if XDP_HAS_REMOTE
+
+inline auto
+make_input_thread_realtime (XdpSession *session,
+                            guint priority,
+                            GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_make_input_thread_realtime (session, priority, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_session_make_input_thread_realtime_finish (session, result, &error);
+      detail::check (error);
+    });
+}
+
+#endif
+
+#endif
+
+#if XDP_HAS_GAMEMODE
+
+inline auto
+gamemode_register (XdpPortal *portal,
+                   GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_gamemode_register (portal, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_gamemode_register_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+gamemode_query_status (XdpPortal *portal,
+                       GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_gamemode_query_status (portal, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      XdpGameModeStatus status = xdp_portal_gamemode_query_status_finish (portal, result, &error);
+      detail::check (error);
+      return status;
+    });
+}
+
+#endif
+
+#if XDP_HAS_INPUTCAPTURE
+
+inline auto
+create_input_capture_session (XdpPortal *portal,
+                              XdpParent *parent,
+                              XdpInputCapability capabilities,
+                              GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_create_input_capture_session (portal, parent, capabilities, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      XdpSession *session = xdp_portal_create_input_capture_session_finish (portal, result, &error);
+      detail::check (error);
+      return Session (session);
+    });
+}
+
+inline auto
+set_pointer_barriers (XdpSession *session,
+                      const XdpPointerBarrier *barriers,
+                      gsize n_barriers,
+                      GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_set_pointer_barriers (session, barriers, n_barriers, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_session_set_pointer_barriers_finish (session, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+#if XDP_HAS_GLOBALSHORTCUTS
+
+inline auto
+create_global_shortcuts_session (XdpPortal *portal,
+                                 GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_create_global_shortcuts_session (portal, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      XdpSession *session = xdp_portal_create_global_shortcuts_session_finish (portal, result, &error);
+      detail::check (error);
+      return Session (session);
+    });
+}
+
+inline auto
+bind_shortcuts (XdpSession *session,
+                XdpParent *parent,
+                GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_session_bind_shortcuts (session, parent, cancellable, callback, data);
+    },
+    [session] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_session_bind_shortcuts_finish (session, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+#if XDP_HAS_DYNAMICLAUNCHER
+
+inline auto
+install_launchers (XdpPortal *portal,
+                   XdpParent *parent,
+                   const XdpLauncher *launchers,
+                   gsize n_launchers,
+                   XdpLauncherInstallFlags flags = XDP_LAUNCHER_INSTALL_FLAG_NONE,
+                   guint max_concurrent = 0,
+                   GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_install_launchers (portal, parent, launchers, n_launchers, flags, max_concurrent, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      GVariant *ret = xdp_portal_install_launchers_finish (portal, result, &error);
+      detail::check (error);
+      return Variant (ret);
+    });
+}
+
+#endif
+
+inline auto
+run (XdpBatch *batch,
+     GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_batch_run (batch, cancellable, callback, data);
+    },
+    [batch] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_batch_run_finish (batch, result, &error);
+      detail::check (error);
+    });
+}
+
+inline auto
+flush (XdpPortal *portal,
+       int timeout = -1,
+       GCancellable *cancellable = nullptr)
+{
+  return detail::Operation (
+    [=] (GAsyncReadyCallback callback, gpointer data) {
+      xdp_portal_flush (portal, timeout, cancellable, callback, data);
+    },
+    [portal] (GAsyncResult *result) {
+      GError *error = nullptr;
+      xdp_portal_flush_finish (portal, result, &error);
+      detail::check (error);
+    });
+}
+
+} // namespace xdp
@@ -0,0 +1,619 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "portal-private.h"
+#if XDP_HAS_REMOTE
+#include "session-private.h"
+#endif
+
+/**
+ * SECTION:realtime
+ * @title: Realtime
+ * @short_description: raise the scheduling priority of threads
+ *
+ * These functions let sandboxed applications give threads realtime
+ * scheduling or a higher nice level, for example threads that produce
+ * audio or inject input into a remote desktop session.
+ *
+ * Threads are identified by their thread ID, as seen by the application.
+ * The portal translates process and thread IDs from the pid namespace
+ * of the sandbox. Passing 0 as thread ID selects the calling thread.
+ *
+ * The portal limits the priorities that can be requested. The limits
+ * can be obtained with xdp_portal_get_realtime_limits(); they are
+ * queried once and cached. Requested priorities are clamped to them.
+ *
+ * The underlying portal is org.freedesktop.portal.Realtime.
+ */
+
+#define REALTIME_INTERFACE "org.freedesktop.portal.Realtime"
+
+G_LOCK_DEFINE_STATIC (realtime_limits);
+
+typedef struct {
+  XdpPortal *portal;
+  gboolean realtime;
+  guint64 thread;
+  int priority;
+  GTask *task;
+} RealtimeCall;
+
+static void
+realtime_call_free (RealtimeCall *call)
+{
+  g_object_unref (call->portal);
+  g_object_unref (call->task);
+
+  g_free (call);
+}
+
+static guint64
+current_thread_id (void)
+{
+  return (guint64) syscall (SYS_gettid);
+}
+
+static void
+store_limits (XdpPortal *portal,
+              GVariant *properties)
+{
+  int max_realtime_priority = 0;
+  int min_nice_level = 0;
+  gint64 rttime_usec_max = 0;
+  gboolean have_max_realtime_priority;
+  gboolean have_min_nice_level;
+
+  have_max_realtime_priority = g_variant_lookup (properties, "MaxRealtimePriority", "i", &max_realtime_priority);
+  have_min_nice_level = g_variant_lookup (properties, "MinNiceLevel", "i", &min_nice_level);
+  g_variant_lookup (properties, "RTTimeUSecMax", "x", &rttime_usec_max);
+
+  G_LOCK (realtime_limits);
+  portal->have_max_realtime_priority = have_max_realtime_priority;
+  portal->have_min_nice_level = have_min_nice_level;
+  portal->max_realtime_priority = max_realtime_priority;
+  portal->min_nice_level = min_nice_level;
+  portal->rttime_usec_max = rttime_usec_max;
+  portal->have_realtime_limits = TRUE;
+  G_UNLOCK (realtime_limits);
+}
+
+static gboolean
+ensure_limits (XdpPortal *portal,
+               GCancellable *cancellable,
+               GError **error)
+{
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GVariant) properties = NULL;
+  gboolean have_limits;
+
+  G_LOCK (realtime_limits);
+  have_limits = portal->have_realtime_limits;
+  G_UNLOCK (realtime_limits);
+
+  if (have_limits)
+    return TRUE;
+
+  ret = g_dbus_connection_call_sync (portal->bus,
+                                     PORTAL_BUS_NAME,
+                                     PORTAL_OBJECT_PATH,
+                                     "org.freedesktop.DBus.Properties",
+                                     "GetAll",
+                                     g_variant_new ("(s)", REALTIME_INTERFACE),
+                                     G_VARIANT_TYPE ("(a{sv})"),
+                                     G_DBUS_CALL_FLAGS_NONE,
+                                     -1,
+                                     cancellable,
+                                     error);
+  if (ret == NULL)
+    return FALSE;
+
+  g_variant_get (ret, "(@a{sv})", &properties);
+  store_limits (portal, properties);
+
+  return TRUE;
+}
+
+/* Called with the limits known. Returns the parameters for the portal call. */
+static GVariant *
+prepare_request (XdpPortal *portal,
+                 gboolean realtime,
+                 guint64 thread,
+                 int priority)
+{
+  gboolean have_max_realtime_priority;
+  gboolean have_min_nice_level;
+  int max_realtime_priority;
+  int min_nice_level;
+  gint64 rttime_usec_max;
+
+  G_LOCK (realtime_limits);
+  have_max_realtime_priority = portal->have_max_realtime_priority;
+  have_min_nice_level = portal->have_min_nice_level;
+  max_realtime_priority = portal->max_realtime_priority;
+  min_nice_level = portal->min_nice_level;
+  rttime_usec_max = portal->rttime_usec_max;
+  G_UNLOCK (realtime_limits);
+
+  /* Limits that the portal does not report are left to it to enforce */
+  if (!realtime)
+    return g_variant_new ("(tti)",
+                          (guint64) getpid (),
+                          thread,
+                          have_min_nice_level ? MAX (priority, min_nice_level) : priority);
+
+  /* Realtime scheduling is only granted to processes that limit
+   * the CPU time realtime threads can use without blocking.
+   */
+  if (rttime_usec_max > 0)
+    {
+      struct rlimit rl;
+
+      if (getrlimit (RLIMIT_RTTIME, &rl) == 0 &&
+          (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > (rlim_t) rttime_usec_max))
+        {
+          rl.rlim_cur = rl.rlim_max = rttime_usec_max;
+          if (setrlimit (RLIMIT_RTTIME, &rl) != 0)
+            g_warning ("Failed to limit realtime CPU time");
+        }
+    }
+
+  return g_variant_new ("(ttu)",
+                        (guint64) getpid (),
+                        thread,
+                        (guint32) (have_max_realtime_priority ? MIN (priority, max_realtime_priority) : priority));
+}
+
+static void
+request_done (GObject *source,
+              GAsyncResult *result,
+              gpointer data)
+{
+  RealtimeCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  if (ret == NULL)
+    g_task_return_error (call->task, error);
+  else
+    g_task_return_boolean (call->task, TRUE);
+
+  realtime_call_free (call);
+}
+
+static void
+send_request (RealtimeCall *call)
+{
+  g_dbus_connection_call (call->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          REALTIME_INTERFACE,
+                          call->realtime ? "MakeThreadRealtimeWithPID"
+                                         : "MakeThreadHighPriorityWithPID",
+                          prepare_request (call->portal, call->realtime, call->thread, call->priority),
+                          NULL,
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          g_task_get_cancellable (call->task),
+                          request_done,
+                          call);
+}
+
+static void
+limits_received (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  RealtimeCall *call = data;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GVariant) properties = NULL;
+  GError *error = NULL;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), result, &error);
+  if (ret == NULL)
+    {
+      g_task_return_error (call->task, error);
+      realtime_call_free (call);
+      return;
+    }
+
+  g_variant_get (ret, "(@a{sv})", &properties);
+  store_limits (call->portal, properties);
+
+  send_request (call);
+}
+
+static void
+make_thread_priority (XdpPortal *portal,
+                      gboolean realtime,
+                      guint64 thread,
+                      int priority,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer data)
+{
+  RealtimeCall *call;
+  gboolean have_limits;
+
+  call = g_new0 (RealtimeCall, 1);
+  call->portal = g_object_ref (portal);
+  call->realtime = realtime;
+  call->thread = thread ? thread : current_thread_id ();
+  call->priority = priority;
+  call->task = g_task_new (portal, cancellable, callback, data);
+
+  G_LOCK (realtime_limits);
+  have_limits = portal->have_realtime_limits;
+  G_UNLOCK (realtime_limits);
+
+  if (have_limits)
+    {
+      send_request (call);
+      return;
+    }
+
+  g_dbus_connection_call (portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          "org.freedesktop.DBus.Properties",
+                          "GetAll",
+                          g_variant_new ("(s)", REALTIME_INTERFACE),
+                          G_VARIANT_TYPE ("(a{sv})"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          cancellable,
+                          limits_received,
+                          call);
+}
+
+static gboolean
+make_thread_priority_sync (XdpPortal *portal,
+                           gboolean realtime,
+                           guint64 thread,
+                           int priority,
+                           GCancellable *cancellable,
+                           GError **error)
+{
+  g_autoptr(GVariant) ret = NULL;
+
+  if (!ensure_limits (portal, cancellable, error))
+    return FALSE;
+
+  ret = g_dbus_connection_call_sync (portal->bus,
+                                     PORTAL_BUS_NAME,
+                                     PORTAL_OBJECT_PATH,
+                                     REALTIME_INTERFACE,
+                                     realtime ? "MakeThreadRealtimeWithPID"
+                                              : "MakeThreadHighPriorityWithPID",
+                                     prepare_request (portal, realtime,
+                                                      thread ? thread : current_thread_id (),
+                                                      priority),
+                                     NULL,
+                                     G_DBUS_CALL_FLAGS_NONE,
+                                     -1,
+                                     cancellable,
+                                     error);
+
+  return ret != NULL;
+}
+
+/**
+ * xdp_portal_get_realtime_limits:
+ * @portal: a #XdpPortal
+ * @max_realtime_priority: (out) (optional): return location for the
+ *     highest realtime priority that can be requested, or 0 if the
+ *     portal does not report it
+ * @min_nice_level: (out) (optional): return location for the lowest
+ *     nice level that can be requested, or 0 if the portal does not
+ *     report it
+ * @rttime_usec_max: (out) (optional): return location for the CPU time
+ *     that realtime threads may use without blocking, in microseconds
+ * @cancellable: (nullable): optional #GCancellable
+ * @error: return location for an error
+ *
+ * Obtains the limits that the portal imposes on thread priorities.
+ *
+ * The limits are queried from the portal the first time they are
+ * needed, and cached afterwards. This function blocks if they have
+ * not been queried yet. It can be called from any thread.
+ *
+ * Returns: %TRUE if the limits are available
+ */
+gboolean
+xdp_portal_get_realtime_limits (XdpPortal *portal,
+                                int *max_realtime_priority,
+                                int *min_nice_level,
+                                gint64 *rttime_usec_max,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+
+  if (!ensure_limits (portal, cancellable, error))
+    return FALSE;
+
+  G_LOCK (realtime_limits);
+  if (max_realtime_priority)
+    *max_realtime_priority = portal->max_realtime_priority;
+  if (min_nice_level)
+    *min_nice_level = portal->min_nice_level;
+  if (rttime_usec_max)
+    *rttime_usec_max = portal->rttime_usec_max;
+  G_UNLOCK (realtime_limits);
+
+  return TRUE;
+}
+
+/**
+ * xdp_portal_make_thread_realtime:
+ * @portal: a #XdpPortal
+ * @thread: the thread ID, or 0 for the calling thread
+ * @priority: the realtime priority to request
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Requests realtime scheduling for a thread of this process.
+ *
+ * @priority is clamped to the maximum that the portal allows. Before
+ * the request is made, the RLIMIT_RTTIME resource limit of the process
+ * is lowered to the value that the portal requires, if necessary.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_make_thread_realtime_finish() to get the results.
+ */
+void
+xdp_portal_make_thread_realtime (XdpPortal *portal,
+                                 guint64 thread,
+                                 guint priority,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer data)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  make_thread_priority (portal, TRUE, thread, (int) MIN (priority, G_MAXINT),
+                        cancellable, callback, data);
+}
+
+/**
+ * xdp_portal_make_thread_realtime_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the realtime request.
+ *
+ * Returns: %TRUE if the thread was given realtime scheduling
+ */
+gboolean
+xdp_portal_make_thread_realtime_finish (XdpPortal *portal,
+                                        GAsyncResult *result,
+                                        GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, portal), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * xdp_portal_make_thread_realtime_sync:
+ * @portal: a #XdpPortal
+ * @thread: the thread ID, or 0 for the calling thread
+ * @priority: the realtime priority to request
+ * @cancellable: (nullable): optional #GCancellable
+ * @error: return location for an error
+ *
+ * Requests realtime scheduling for a thread of this process, like
+ * xdp_portal_make_thread_realtime(), and blocks until it is done.
+ *
+ * This is meant to be called by a worker thread that wants to raise
+ * its own priority, for example the thread that sends input events
+ * to a remote desktop session. It does not need a main loop.
+ *
+ * Returns: %TRUE if the thread was given realtime scheduling
+ */
+gboolean
+xdp_portal_make_thread_realtime_sync (XdpPortal *portal,
+                                      guint64 thread,
+                                      guint priority,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+
+  return make_thread_priority_sync (portal, TRUE, thread, (int) MIN (priority, G_MAXINT),
+                                    cancellable, error);
+}
+
+/**
+ * xdp_portal_make_thread_high_priority:
+ * @portal: a #XdpPortal
+ * @thread: the thread ID, or 0 for the calling thread
+ * @nice_level: the nice level to request
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Requests a higher priority for a thread of this process, by
+ * lowering its nice level. @nice_level is clamped to the minimum
+ * that the portal allows.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_make_thread_high_priority_finish() to get the results.
+ */
+void
+xdp_portal_make_thread_high_priority (XdpPortal *portal,
+                                      guint64 thread,
+                                      int nice_level,
+                                      GCancellable *cancellable,
+                                      GAsyncReadyCallback callback,
+                                      gpointer data)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  make_thread_priority (portal, FALSE, thread, nice_level, cancellable, callback, data);
+}
+
+/**
+ * xdp_portal_make_thread_high_priority_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the high priority request.
+ *
+ * Returns: %TRUE if the nice level of the thread was changed
+ */
+gboolean
+xdp_portal_make_thread_high_priority_finish (XdpPortal *portal,
+                                             GAsyncResult *result,
+                                             GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, portal), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * xdp_portal_make_thread_high_priority_sync:
+ * @portal: a #XdpPortal
+ * @thread: the thread ID, or 0 for the calling thread
+ * @nice_level: the nice level to request
+ * @cancellable: (nullable): optional #GCancellable
+ * @error: return location for an error
+ *
+ * Requests a higher priority for a thread of this process, like
+ * xdp_portal_make_thread_high_priority(), and blocks until it is done.
+ *
+ * Returns: %TRUE if the nice level of the thread was changed
+ */
+gboolean
+xdp_portal_make_thread_high_priority_sync (XdpPortal *portal,
+                                           guint64 thread,
+                                           int nice_level,
+                                           GCancellable *cancellable,
+                                           GError **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+
+  return make_thread_priority_sync (portal, FALSE, thread, nice_level, cancellable, error);
+}
+
+#if XDP_HAS_REMOTE
+
+static void
+input_thread_promoted (GObject *source,
+                       GAsyncResult *result,
+                       gpointer data)
+{
+  g_autoptr(GTask) task = data;
+  GError *error = NULL;
+
+  if (xdp_portal_make_thread_realtime_finish (XDP_PORTAL (source), result, &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+/* Runs in the thread that sends the input of the session */
+static gboolean
+promote_input_thread (gpointer data)
+{
+  GTask *task = data;
+  XdpSession *session = g_task_get_source_object (task);
+
+  xdp_portal_make_thread_realtime (session->portal,
+                                   0,
+                                   GPOINTER_TO_UINT (g_task_get_task_data (task)),
+                                   g_task_get_cancellable (task),
+                                   input_thread_promoted,
+                                   task);
+
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * xdp_session_make_input_thread_realtime:
+ * @session: a #XdpSession
+ * @priority: the realtime priority to request
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Requests realtime scheduling for the thread that sends the input
+ * events of @session, like xdp_portal_make_thread_realtime().
+ *
+ * With a jitter buffer, that is the thread whose main context the
+ * buffer releases events from, see xdp_session_set_jitter_buffer().
+ * Otherwise, input is sent by the thread that calls the input functions,
+ * which is assumed to be the one of the thread-default main context.
+ * The request is made from that thread, so its main context must run.
+ *
+ * May only be called on a remote desktop session.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_session_make_input_thread_realtime_finish() to get the results.
+ */
+void
+xdp_session_make_input_thread_realtime (XdpSession *session,
+                                        guint priority,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer data)
+{
+  GTask *task;
+
+  g_return_if_fail (XDP_IS_SESSION (session) &&
+                    session->type == XDP_SESSION_REMOTE_DESKTOP);
+
+  task = g_task_new (session, cancellable, callback, data);
+  g_task_set_task_data (task, GUINT_TO_POINTER (priority), NULL);
+
+  g_main_context_invoke (_xdp_session_get_input_context (session), promote_input_thread, task);
+}
+
+/**
+ * xdp_session_make_input_thread_realtime_finish:
+ * @session: a #XdpSession
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes the realtime request.
+ *
+ * Returns: %TRUE if the input thread was given realtime scheduling
+ */
+gboolean
+xdp_session_make_input_thread_realtime_finish (XdpSession *session,
+                                               GAsyncResult *result,
+                                               GError **error)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, session), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+#endif
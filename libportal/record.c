@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <gio/gunixfdlist.h>
+
+#include "portal-private.h"
+
+/* If LIBPORTAL_RECORD is set to a file name, the traffic between
+ * libportal and the portal is recorded into that file: method calls,
+ * their replies, and the signals of portal objects such as Request
+ * Response and Session Closed.
+ *
+ * The first line is a dictionary of type a{sv} that describes the
+ * recording. Each following line is one message, as a tuple of type
+ * (tsuussssa(st)v): the time in microseconds since recording started,
+ * the kind of message ("call", "return", "error" or "signal"), the
+ * serial, the reply serial, the object path, interface, member and
+ * error name, the type and size of each file descriptor, and the body.
+ *
+ * portal-replay can answer calls from such a recording.
+ */
+
+#define RECORD_VERSION 1
+
+G_LOCK_DEFINE_STATIC (recorder);
+
+static FILE *record_file;
+static gint64 record_start;
+static GHashTable *record_serials;
+
+static GVariant *
+describe_fds (GDBusMessage *message)
+{
+  GUnixFDList *fd_list;
+  GVariantBuilder fds;
+  const int *handles;
+  int n_handles = 0;
+  int i;
+
+  g_variant_builder_init (&fds, G_VARIANT_TYPE ("a(st)"));
+
+  fd_list = g_dbus_message_get_unix_fd_list (message);
+  if (fd_list == NULL)
+    return g_variant_builder_end (&fds);
+
+  handles = g_unix_fd_list_peek_fds (fd_list, &n_handles);
+  for (i = 0; i < n_handles; i++)
+    {
+      struct stat st;
+      const char *type = "other";
+      guint64 size = 0;
+
+      if (fstat (handles[i], &st) == 0)
+        {
+          if (S_ISREG (st.st_mode))
+            type = "file";
+          else if (S_ISFIFO (st.st_mode))
+            type = "pipe";
+          else if (S_ISSOCK (st.st_mode))
+            type = "socket";
+          size = st.st_size;
+        }
+
+      g_variant_builder_add (&fds, "(st)", type, size);
+    }
+
+  return g_variant_builder_end (&fds);
+}
+
+static const char *
+empty_if_null (const char *s)
+{
+  return s ? s : "";
+}
+
+/* Called with the lock held */
+static void
+record_message (GDBusMessage *message,
+                const char *kind)
+{
+  g_autoptr(GVariant) record = NULL;
+  g_autofree char *text = NULL;
+  GVariant *body;
+
+  body = g_dbus_message_get_body (message);
+
+  record = g_variant_ref_sink (g_variant_new ("(tsuussss@a(st)v)",
+                                              (guint64) (g_get_monotonic_time () - record_start),
+                                              kind,
+                                              g_dbus_message_get_serial (message),
+                                              g_dbus_message_get_reply_serial (message),
+                                              empty_if_null (g_dbus_message_get_path (message)),
+                                              empty_if_null (g_dbus_message_get_interface (message)),
+                                              empty_if_null (g_dbus_message_get_member (message)),
+                                              empty_if_null (g_dbus_message_get_error_name (message)),
+                                              describe_fds (message),
+                                              body ? body : g_variant_new ("()")));
+
+  text = g_variant_print (record, TRUE);
+  fprintf (record_file, "%s\n", text);
+  fflush (record_file);
+}
+
+/* Runs in the GDBus worker thread */
+static GDBusMessage *
+record_filter (GDBusConnection *bus,
+               GDBusMessage *message,
+               gboolean incoming,
+               gpointer data)
+{
+  GDBusMessageType type;
+  const char *path;
+
+  type = g_dbus_message_get_message_type (message);
+
+  G_LOCK (recorder);
+
+  if (!incoming)
+    {
+      if (type == G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+          g_strcmp0 (g_dbus_message_get_destination (message), PORTAL_BUS_NAME) == 0)
+        {
+          /* Calls without a callback get no reply, and their
+           * serial would never be removed again
+           */
+          if ((g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) == 0)
+            g_hash_table_add (record_serials, GUINT_TO_POINTER (g_dbus_message_get_serial (message)));
+          record_message (message, "call");
+        }
+    }
+  else if (type == G_DBUS_MESSAGE_TYPE_METHOD_RETURN ||
+           type == G_DBUS_MESSAGE_TYPE_ERROR)
+    {
+      if (g_hash_table_remove (record_serials, GUINT_TO_POINTER (g_dbus_message_get_reply_serial (message))))
+        record_message (message, type == G_DBUS_MESSAGE_TYPE_ERROR ? "error" : "return");
+    }
+  else if (type == G_DBUS_MESSAGE_TYPE_SIGNAL)
+    {
+      path = g_dbus_message_get_path (message);
+      if (path && g_str_has_prefix (path, PORTAL_OBJECT_PATH))
+        record_message (message, "signal");
+    }
+
+  G_UNLOCK (recorder);
+
+  return message;
+}
+
+static gpointer
+start_recording (gpointer data)
+{
+  XdpPortal *portal = data;
+  g_autoptr(GVariant) header = NULL;
+  g_autofree char *text = NULL;
+  GVariantBuilder info;
+  const char *filename;
+
+  filename = g_getenv ("LIBPORTAL_RECORD");
+  if (filename == NULL || filename[0] == '\0')
+    return NULL;
+
+  record_file = fopen (filename, "w");
+  if (record_file == NULL)
+    {
+      g_warning ("Failed to open %s for recording: %s", filename, g_strerror (errno));
+      return NULL;
+    }
+
+  record_start = g_get_monotonic_time ();
+  record_serials = g_hash_table_new (NULL, NULL);
+
+  /* Request and session paths contain the sender */
+  g_variant_builder_init (&info, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&info, "{sv}", "version", g_variant_new_uint32 (RECORD_VERSION));
+  g_variant_builder_add (&info, "{sv}", "sender", g_variant_new_string (portal->sender));
+  header = g_variant_ref_sink (g_variant_builder_end (&info));
+  text = g_variant_print (header, TRUE);
+  fprintf (record_file, "%s\n", text);
+
+  /* The connection is shared, so one filter sees every XdpPortal */
+  g_dbus_connection_add_filter (portal->bus, record_filter, NULL, NULL);
+
+  return NULL;
+}
+
+void
+_xdp_portal_start_recording (XdpPortal *portal)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  if (portal->bus == NULL)
+    return;
+
+  g_once (&once, start_recording, portal);
+}
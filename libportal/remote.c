@@ -51,6 +51,8 @@ typedef struct {
   GTask *task;
   char *request_path;
   guint cancelled_id;
+  XdpSession *session;
+  char *restore_token;
 } CreateCall;
 
 static void
@@ -66,12 +68,54 @@ create_call_free (CreateCall *call)
 
   g_object_unref (call->portal);
   g_object_unref (call->task);
+  g_clear_object (&call->session);
 
   g_free (call->id);
+  g_free (call->restore_token);
 
   g_free (call);
 }
 
+static void
+create_call_return_session (CreateCall *call)
+{
+  XdpSession *session;
+
+  /* When reconnecting, the existing session object takes over
+   * the new session handle.
+   */
+  if (call->session)
+    {
+      _xdp_session_set_id (call->session, call->id);
+      g_task_return_boolean (call->task, TRUE);
+      return;
+    }
+
+  session = _xdp_session_new (call->portal, call->id, call->type);
+  session->requested_devices = call->devices;
+  session->outputs = call->outputs;
+  session->multiple = call->multiple;
+  g_task_return_pointer (call->task, session, g_object_unref);
+}
+
+/* Sessions ask the portal to remember the selection for as long as
+ * the application runs, so that the restore token of a session can
+ * recreate it without a dialog when it is closed externally
+ */
+#define PERSIST_MODE_TRANSIENT 1
+
+/* Remote desktop sessions pass these to SelectDevices,
+ * screencast sessions to SelectSources
+ */
+static void
+add_persist_options (CreateCall *call,
+                     GVariantBuilder *options)
+{
+  if (call->restore_token)
+    g_variant_builder_add (options, "{sv}", "restore_token", g_variant_new_string (call->restore_token));
+  g_variant_builder_add (options, "{sv}", "persist_mode", g_variant_new_uint32 (PERSIST_MODE_TRANSIENT));
+}
+
 static void
 sources_selected (GDBusConnection *bus,
                   const char *sender_name,
@@ -88,12 +132,7 @@ sources_selected (GDBusConnection *bus,
   g_variant_get (parameters, "(u@a{sv})", &response, &ret);
 
   if (response == 0)
-    {
-       XdpSession *session;
-
-       session = _xdp_session_new (call->portal, call->id, call->type);
-       g_task_return_pointer (call->task, session, g_object_unref);
-    }
+    create_call_return_session (call);
   else if (response == 1)
     g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Remote desktop canceled");
   else if (response == 2)
@@ -106,11 +145,10 @@ static void
 select_sources (CreateCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   g_autofree char *handle = NULL;
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  handle = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  handle = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -126,6 +164,8 @@ select_sources (CreateCall *call)
   g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
   g_variant_builder_add (&options, "{sv}", "types", g_variant_new_uint32 (call->outputs));
   g_variant_builder_add (&options, "{sv}", "multiple", g_variant_new_boolean (call->multiple));
+  if (call->type == XDP_SESSION_SCREENCAST)
+    add_persist_options (call, &options);
   g_dbus_connection_call (call->portal->bus,
                           PORTAL_BUS_NAME,
                           PORTAL_OBJECT_PATH,
@@ -164,7 +204,7 @@ devices_selected (GDBusConnection *bus,
         select_sources (call);
       else
        {
-         g_task_return_pointer (call->task, _xdp_session_new (call->portal, call->id, call->type), g_object_unref);
+         create_call_return_session (call);
          create_call_free (call);
        }
     }
@@ -181,11 +221,10 @@ static void
 select_devices (CreateCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   g_autofree char *handle = NULL;
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  handle = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  handle = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -200,6 +239,7 @@ select_devices (CreateCall *call)
   g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
   g_variant_builder_add (&options, "{sv}", "handle_token", g_variant_new_string (token));
   g_variant_builder_add (&options, "{sv}", "type", g_variant_new_uint32 (call->devices));
+  add_persist_options (call, &options);
   g_dbus_connection_call (call->portal->bus,
                           PORTAL_BUS_NAME,
                           PORTAL_OBJECT_PATH,
@@ -270,12 +310,11 @@ static void
 create_session (CreateCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
-  g_autofree char *session_token = NULL;
+  const char *token;
+  const char *session_token;
   GCancellable *cancellable;
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->request_path = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -287,8 +326,7 @@ create_session (CreateCall *call)
                                                         call,
                                                         NULL);
 
-  session_token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->id = g_strconcat (SESSION_PATH_PREFIX, call->portal->sender, "/", session_token, NULL);
+  call->id = _xdp_portal_new_handle (call->portal, SESSION_PATH_PREFIX, &session_token);
 
   cancellable = g_task_get_cancellable (call->task);
   if (cancellable)
@@ -313,6 +351,74 @@ create_session (CreateCall *call)
                           NULL);
 }
 
+static void
+create_session_full (XdpPortal *portal,
+                     XdpSessionType type,
+                     XdpDeviceType devices,
+                     XdpOutputType outputs,
+                     gboolean multiple,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer data)
+{
+  CreateCall *call;
+
+  call = g_new0 (CreateCall, 1);
+  call->portal = g_object_ref (portal);
+  call->type = type;
+  call->devices = devices;
+  call->outputs = outputs;
+  call->multiple = multiple;
+  call->task = g_task_new (portal, cancellable, callback, data);
+
+  create_session (call);
+}
+
+static void
+create_or_take_session (XdpPortal *portal,
+                        XdpSessionType type,
+                        XdpDeviceType devices,
+                        XdpOutputType outputs,
+                        gboolean multiple,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer data)
+{
+  XdpSession *session;
+
+  session = _xdp_portal_take_pooled_session (portal, type, devices, outputs, multiple);
+  if (session)
+    {
+      g_autoptr(GTask) task = NULL;
+
+      task = g_task_new (portal, cancellable, callback, data);
+      g_task_return_pointer (task, session, g_object_unref);
+      return;
+    }
+
+  create_session_full (portal, type, devices, outputs, multiple, cancellable, callback, data);
+}
+
+void
+_xdp_portal_create_session (XdpPortal *portal,
+                            XdpSessionType type,
+                            XdpDeviceType devices,
+                            XdpOutputType outputs,
+                            gboolean multiple,
+                            GAsyncReadyCallback callback,
+                            gpointer data)
+{
+  create_session_full (portal, type, devices, outputs, multiple, NULL, callback, data);
+}
+
+XdpSession *
+_xdp_portal_create_session_finish (XdpPortal *portal,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /**
  * xdp_portal_create_screencast_session:
  * @portal: a #XdpPortal
@@ -335,19 +441,10 @@ xdp_portal_create_screencast_session (XdpPortal *portal,
                                       GAsyncReadyCallback  callback,
                                       gpointer data)
 {
-  CreateCall *call;
-
   g_return_if_fail (XDP_IS_PORTAL (portal));
 
-  call = g_new0 (CreateCall, 1);
-  call->portal = g_object_ref (portal);
-  call->type = XDP_SESSION_SCREENCAST;
-  call->devices = XDP_DEVICE_NONE;
-  call->outputs = outputs;
-  call->multiple = multiple;
-  call->task = g_task_new (portal, cancellable, callback, data);
-
-  create_session (call);
+  create_or_take_session (portal, XDP_SESSION_SCREENCAST, XDP_DEVICE_NONE, outputs, multiple,
+                          cancellable, callback, data);
 }
 
 /**
@@ -395,19 +492,10 @@ xdp_portal_create_remote_desktop_session (XdpPortal *portal,
                                           GAsyncReadyCallback  callback,
                                           gpointer data)
 {
-  CreateCall *call;
-
   g_return_if_fail (XDP_IS_PORTAL (portal));
 
-  call = g_new0 (CreateCall, 1);
-  call->portal = g_object_ref (portal);
-  call->type = XDP_SESSION_REMOTE_DESKTOP;
-  call->devices = devices;
-  call->outputs = outputs;
-  call->multiple = multiple;
-  call->task = g_task_new (portal, cancellable, callback, data);
-
-  create_session (call);
+  create_or_take_session (portal, XDP_SESSION_REMOTE_DESKTOP, devices, outputs, multiple,
+                          cancellable, callback, data);
 }
 
 /**
@@ -487,11 +575,17 @@ session_started (GDBusConnection *bus,
     {
       guint32 devices;
       GVariant *streams;
+      const char *restore_token;
+      gboolean clipboard_enabled = FALSE;
 
       if (g_variant_lookup (ret, "devices", "u", &devices))
         _xdp_session_set_devices (call->session, devices);
       if (g_variant_lookup (ret, "streams", "@a(ua{sv})", &streams))
         _xdp_session_set_streams (call->session, streams);
+      if (g_variant_lookup (ret, "restore_token", "&s", &restore_token))
+        _xdp_session_set_restore_token (call->session, restore_token);
+      if (g_variant_lookup (ret, "clipboard_enabled", "b", &clipboard_enabled))
+        call->session->clipboard_enabled = clipboard_enabled;
 
       g_task_return_boolean (call->task, TRUE);
     }
@@ -500,8 +594,10 @@ session_started (GDBusConnection *bus,
   else if (response == 2)
     g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_FAILED, "Screencast failed");
 
-  _xdp_session_set_session_state (call->session, response == 0 ? XDP_SESSION_ACTIVE
-                                                               : XDP_SESSION_CLOSED);
+  /* The application may have closed the session in the meantime */
+  if (call->session->state != XDP_SESSION_CLOSED)
+    _xdp_session_set_session_state (call->session, response == 0 ? XDP_SESSION_ACTIVE
+                                                                 : XDP_SESSION_CLOSED);
  
   start_call_free (call);
 }
@@ -540,7 +636,7 @@ static void
 start_session (StartCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   GCancellable *cancellable;
 
   if (call->parent_handle == NULL)
@@ -549,8 +645,7 @@ start_session (StartCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->request_path = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -644,6 +739,118 @@ xdp_session_start_finish (XdpSession *session,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+static void
+close_reconnected_session (XdpSession *session)
+{
+  g_dbus_connection_call (session->portal->bus,
+                          PORTAL_BUS_NAME,
+                          session->id,
+                          SESSION_INTERFACE,
+                          "Close",
+                          NULL,
+                          NULL, 0, -1, NULL, NULL, NULL);
+}
+
+static void
+reconnect_started (GObject *source,
+                   GAsyncResult *result,
+                   gpointer data)
+{
+  XdpSession *session = XDP_SESSION (source);
+  g_autoptr(GTask) task = data;
+  GError *error = NULL;
+
+  if (!xdp_session_start_finish (session, result, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* The application closed the session while it was being started */
+  if (session->state == XDP_SESSION_CLOSED)
+    {
+      close_reconnected_session (session);
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Session closed");
+      return;
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+reconnect_created (GObject *source,
+                   GAsyncResult *result,
+                   gpointer data)
+{
+  XdpSession *session = XDP_SESSION (source);
+  g_autoptr(GTask) task = data;
+  GError *error = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* The application closed the session while we were busy */
+  if (session->state == XDP_SESSION_CLOSED)
+    {
+      close_reconnected_session (session);
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Session closed");
+      return;
+    }
+
+  if (session->clipboard_requested)
+    _xdp_session_request_clipboard (session);
+
+  xdp_session_start (session, NULL, NULL, reconnect_started, g_steal_pointer (&task));
+}
+
+void
+_xdp_session_reconnect (XdpSession *session,
+                        GAsyncReadyCallback callback,
+                        gpointer data)
+{
+  CreateCall *call;
+
+  call = g_new0 (CreateCall, 1);
+  call->portal = g_object_ref (session->portal);
+  call->session = g_object_ref (session);
+  call->type = session->type;
+  call->devices = session->requested_devices;
+  call->outputs = session->outputs;
+  call->multiple = session->multiple;
+  call->restore_token = g_strdup (session->restore_token);
+  call->task = g_task_new (session, NULL, reconnect_created, g_task_new (session, NULL, callback, data));
+
+  create_session (call);
+}
+
+gboolean
+_xdp_session_reconnect_finish (XdpSession *session,
+                               GAsyncResult *result,
+                               GError **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+void
+_xdp_session_replay_input_state (XdpSession *session)
+{
+  guint i;
+
+  _xdp_session_replay_held_keys (session);
+
+  for (i = 0; session->pressed_buttons && i < session->pressed_buttons->len; i++)
+    {
+      InputEvent event = { INPUT_POINTER_BUTTON, };
+
+      event.value = g_array_index (session->pressed_buttons, int, i);
+      event.state = XDP_BUTTON_PRESSED;
+      _xdp_session_dispatch_input (session, &event);
+    }
+}
+
 /**
  * xdp_session_close:
  * @session: an active #XdpSession
@@ -714,6 +921,114 @@ xdp_session_open_pipewire_remote (XdpSession *session)
   return g_unix_fd_list_get (fd_list, fd_out, NULL);
 }
 
+static GVariant *
+empty_options (void)
+{
+  static gsize options = 0;
+
+  if (g_once_init_enter (&options))
+    {
+      GVariant *empty = g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0);
+      g_once_init_leave (&options, (gsize) g_variant_ref_sink (empty));
+    }
+
+  return (GVariant *) options;
+}
+
+/* Input events are frequent, so the arguments are put together
+ * directly instead of going through format strings and builders.
+ */
+void
+_xdp_session_send_input (XdpSession *session,
+                         const InputEvent *event)
+{
+  GVariant *args[6];
+  gsize n_args = 2;
+  GVariant *finish;
+  const char *method;
+
+  /* The old session is gone, and the new one is not started yet */
+  if (session->reconnecting)
+    return;
+
+  args[0] = session->id_path;
+  args[1] = empty_options ();
+
+  switch (event->type)
+    {
+    case INPUT_POINTER_MOTION:
+      method = "NotifyPointerMotion";
+      args[n_args++] = g_variant_new_double (event->x);
+      args[n_args++] = g_variant_new_double (event->y);
+      break;
+    case INPUT_POINTER_POSITION:
+      method = "NotifyPointerMotionAbsolute";
+      args[n_args++] = g_variant_new_uint32 (event->stream);
+      args[n_args++] = g_variant_new_double (event->x);
+      args[n_args++] = g_variant_new_double (event->y);
+      break;
+    case INPUT_POINTER_BUTTON:
+      method = "NotifyPointerButton";
+      args[n_args++] = g_variant_new_int32 (event->value);
+      args[n_args++] = g_variant_new_uint32 (event->state);
+      break;
+    case INPUT_POINTER_AXIS:
+      method = "NotifyPointerAxis";
+      finish = g_variant_new_dict_entry (g_variant_new_string ("finish"),
+                                         g_variant_new_variant (g_variant_new_boolean (event->finish)));
+      args[1] = g_variant_new_array (G_VARIANT_TYPE ("{sv}"), &finish, 1);
+      args[n_args++] = g_variant_new_double (event->x);
+      args[n_args++] = g_variant_new_double (event->y);
+      break;
+    case INPUT_POINTER_AXIS_DISCRETE:
+      method = "NotifyPointerAxisDiscrete";
+      args[n_args++] = g_variant_new_uint32 (event->state);
+      args[n_args++] = g_variant_new_int32 (event->value);
+      break;
+    case INPUT_KEYBOARD_KEYCODE:
+      method = "NotifyKeyboardKeycode";
+      args[n_args++] = g_variant_new_int32 (event->value);
+      args[n_args++] = g_variant_new_uint32 (event->state);
+      break;
+    case INPUT_KEYBOARD_KEYSYM:
+      method = "NotifyKeyboardKeysym";
+      args[n_args++] = g_variant_new_int32 (event->value);
+      args[n_args++] = g_variant_new_uint32 (event->state);
+      break;
+    case INPUT_TOUCH_DOWN:
+      method = "NotifyTouchDown";
+      args[n_args++] = g_variant_new_uint32 (event->stream);
+      args[n_args++] = g_variant_new_uint32 (event->slot);
+      args[n_args++] = g_variant_new_double (event->x);
+      args[n_args++] = g_variant_new_double (event->y);
+      break;
+    case INPUT_TOUCH_MOTION:
+      method = "NotifyTouchMotion";
+      args[n_args++] = g_variant_new_uint32 (event->stream);
+      args[n_args++] = g_variant_new_uint32 (event->slot);
+      args[n_args++] = g_variant_new_double (event->x);
+      args[n_args++] = g_variant_new_double (event->y);
+      break;
+    case INPUT_TOUCH_UP:
+      method = "NotifyTouchUp";
+      args[n_args++] = g_variant_new_uint32 (event->slot);
+      break;
+    default:
+      g_return_if_reached ();
+    }
+
+  g_dbus_connection_call (session->portal->bus,
+                          PORTAL_BUS_NAME,
+                          PORTAL_OBJECT_PATH,
+                          "org.freedesktop.portal.RemoteDesktop",
+                          method,
+                          g_variant_new_tuple (args, n_args),
+                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+
+  if (event->marker != 0)
+    _xdp_session_latency_marker_sent (session, event->marker);
+}
+
 /**
  * xdp_session_pointer_motion:
  * @session: a #XdpSession
@@ -730,21 +1045,16 @@ xdp_session_pointer_motion (XdpSession *session,
                             double dx,
                             double dy)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_POINTER_MOTION, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_POINTER) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyPointerMotion",
-                          g_variant_new ("(oa{sv}dd)", session->id, &options, dx, dy),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  event.x = dx;
+  event.y = dy;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -766,21 +1076,39 @@ xdp_session_pointer_position (XdpSession *session,
                               double x,
                               double y)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_POINTER_POSITION, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_POINTER) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyPointerMotionAbsolute",
-                          g_variant_new ("(oa{sv}udd)", session->id, &options, stream, x, y),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  event.stream = stream;
+  event.x = x;
+  event.y = y;
+  _xdp_session_dispatch_input (session, &event);
+}
+
+static void
+track_button (XdpSession *session,
+              int button,
+              XdpButtonState state)
+{
+  guint i;
+
+  if (session->pressed_buttons == NULL)
+    session->pressed_buttons = g_array_new (FALSE, FALSE, sizeof (int));
+
+  for (i = 0; i < session->pressed_buttons->len; i++)
+    {
+      if (g_array_index (session->pressed_buttons, int, i) == button)
+        break;
+    }
+
+  if (state == XDP_BUTTON_PRESSED && i == session->pressed_buttons->len)
+    g_array_append_val (session->pressed_buttons, button);
+  else if (state == XDP_BUTTON_RELEASED && i < session->pressed_buttons->len)
+    g_array_remove_index_fast (session->pressed_buttons, i);
 }
 
 /**
@@ -799,21 +1127,18 @@ xdp_session_pointer_button (XdpSession *session,
                             int button,
                             XdpButtonState state)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_POINTER_BUTTON, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_POINTER) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyPointerButton",
-                          g_variant_new ("(oa{sv}iu)", session->id, &options, button, state),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  track_button (session, button, state);
+
+  event.value = button;
+  event.state = state;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -836,22 +1161,17 @@ xdp_session_pointer_axis (XdpSession *session,
                           double dx,
                           double dy)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_POINTER_AXIS, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_POINTER) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_variant_builder_add (&options, "{sv}", "finish", g_variant_new_boolean (finish));
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyPointerAxis",
-                          g_variant_new ("(oa{sv}dd)", session->id, &options, dx, dy),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  event.finish = finish;
+  event.x = dx;
+  event.y = dy;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -870,21 +1190,16 @@ xdp_session_pointer_axis_discrete (XdpSession *session,
                                    XdpDiscreteAxis axis,
                                    int steps)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_POINTER_AXIS_DISCRETE, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_POINTER) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyPointerAxisDiscrete",
-                          g_variant_new ("(oa{sv}ui)", session->id, &options, axis, steps),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  event.state = axis;
+  event.value = steps;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -896,6 +1211,9 @@ xdp_session_pointer_axis_discrete (XdpSession *session,
  * 
  * Changes the state of the key to @state.
  *
+ * How repeated presses of a held key are handled can be
+ * changed with xdp_session_set_key_repeat().
+ *
  * May only be called on a remote desktop session
  * with %XDP_DEVICE_KEYBOARD access.
  */
@@ -905,21 +1223,20 @@ xdp_session_keyboard_key (XdpSession *session,
                           int key,
                           XdpKeyState state)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_KEYBOARD_KEYCODE, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_KEYBOARD) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          keysym ? "NotifyKeyboardKeysym" : "NotifyKeyboardKeycode",
-                          g_variant_new ("(oa{sv}iu)", session->id, &options, key, state),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  if (_xdp_session_handle_key (session, keysym, key, state))
+    return;
+
+  event.type = keysym ? INPUT_KEYBOARD_KEYSYM : INPUT_KEYBOARD_KEYCODE;
+  event.value = key;
+  event.state = state;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -944,21 +1261,21 @@ xdp_session_touch_down (XdpSession *session,
                         double x,
                         double y)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_TOUCH_DOWN, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_TOUCHSCREEN) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyTouchDown",
-                          g_variant_new ("(oa{sv}uudd)", session->id, &options, stream, slot, x, y),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  if (slot < 32)
+    session->touch_slots |= 1u << slot;
+
+  event.stream = stream;
+  event.slot = slot;
+  event.x = x;
+  event.y = y;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -983,21 +1300,18 @@ xdp_session_touch_position (XdpSession *session,
                             double x,
                             double y)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_TOUCH_MOTION, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_TOUCHSCREEN) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyTouchMotion",
-                          g_variant_new ("(oa{sv}uudd)", session->id, &options, stream, slot, x, y),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  event.stream = stream;
+  event.slot = slot;
+  event.x = x;
+  event.y = y;
+  _xdp_session_dispatch_input (session, &event);
 }
 
 /**
@@ -1014,19 +1328,16 @@ void
 xdp_session_touch_up (XdpSession *session,
                       guint slot)
 {
-  GVariantBuilder options;
+  InputEvent event = { INPUT_TOUCH_UP, };
 
   g_return_if_fail (XDP_IS_SESSION (session) &&
                     session->type == XDP_SESSION_REMOTE_DESKTOP &&
                     session->state == XDP_SESSION_ACTIVE &&
                     ((session->devices & XDP_DEVICE_TOUCHSCREEN) != 0));
 
-  g_variant_builder_init (&options, G_VARIANT_TYPE_VARDICT);
-  g_dbus_connection_call (session->portal->bus,
-                          PORTAL_BUS_NAME,
-                          PORTAL_OBJECT_PATH,
-                          "org.freedesktop.portal.RemoteDesktop",
-                          "NotifyTouchMotion",
-                          g_variant_new ("(oa{sv}u)", session->id, &options, slot),
-                          NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+  if (slot < 32)
+    session->touch_slots &= ~(1u << slot);
+
+  event.slot = slot;
+  _xdp_session_dispatch_input (session, &event);
 }
@@ -17,6 +17,11 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
 #include "portal-private.h"
 #include "utils-private.h"
 
@@ -26,6 +31,15 @@
  * @short_description: take a screenshot
  *
  * These functions let the application take a screenshot or pick a color.
+ *
+ * The image file of a screenshot is written by the portal backend, and
+ * stays where the backend put it. With xdp_portal_set_screenshot_storage(),
+ * libportal takes ownership of the files instead: each new screenshot is
+ * moved into a directory of the application's choosing, and the oldest
+ * screenshots are deleted when there are too many of them, or they take
+ * too much space. Screenshots that are no longer needed can be deleted
+ * with xdp_portal_release_screenshot(), or read into memory and deleted
+ * with xdp_portal_read_screenshot().
  * 
  * The underlying portal is org.freedesktop.portal.Screenshot.
  */
@@ -67,6 +81,215 @@ screenshot_call_free (ScreenshotCall *call)
   g_free (call);
 }
 
+typedef struct {
+  char *path;
+  guint64 size;
+} StoredScreenshot;
+
+static void
+stored_screenshot_free (StoredScreenshot *stored)
+{
+  g_free (stored->path);
+  g_free (stored);
+}
+
+static void
+evict_screenshots (XdpPortal *portal)
+{
+  /* The newest screenshot is kept, it has just been handed out */
+  while (portal->screenshots.length > 1 &&
+         ((portal->screenshot_max_files > 0 &&
+           portal->screenshots.length > portal->screenshot_max_files) ||
+          (portal->screenshot_max_bytes > 0 &&
+           portal->screenshot_bytes > portal->screenshot_max_bytes)))
+    {
+      StoredScreenshot *stored = g_queue_pop_head (&portal->screenshots);
+
+      if (portal->shared_screenshots)
+        g_hash_table_remove (portal->shared_screenshots, stored->path);
+
+      if (g_unlink (stored->path) != 0 && errno != ENOENT)
+        g_warning ("Failed to remove screenshot %s: %s", stored->path, g_strerror (errno));
+
+      portal->screenshot_bytes -= stored->size;
+      portal->screenshots_evicted++;
+      portal->screenshot_bytes_evicted += stored->size;
+
+      stored_screenshot_free (stored);
+    }
+}
+
+static StoredScreenshot *
+forget_screenshot (XdpPortal *portal,
+                   const char *path)
+{
+  GList *l;
+
+  for (l = portal->screenshots.head; l; l = l->next)
+    {
+      StoredScreenshot *stored = l->data;
+
+      if (strcmp (stored->path, path) == 0)
+        {
+          g_queue_delete_link (&portal->screenshots, l);
+          portal->screenshot_bytes -= stored->size;
+          return stored;
+        }
+    }
+
+  return NULL;
+}
+
+void
+_xdp_portal_free_screenshot_storage (XdpPortal *portal)
+{
+  /* The files stay, their URIs may still be in use */
+  g_queue_clear_full (&portal->screenshots, (GDestroyNotify) stored_screenshot_free);
+  g_free (portal->screenshot_dir);
+  g_clear_pointer (&portal->shared_screenshots, g_hash_table_unref);
+}
+
+/* A screenshot that several requests share is deleted once
+ * the last of them releases it. Only the number of holders
+ * beyond the first is kept.
+ */
+static void
+share_screenshot (XdpPortal *portal,
+                  gpointer value,
+                  guint n_waiters)
+{
+  g_autofree char *path = NULL;
+
+  if (n_waiters < 2)
+    return;
+
+  path = g_filename_from_uri (value, NULL, NULL);
+  if (path == NULL)
+    return;
+
+  if (portal->shared_screenshots == NULL)
+    portal->shared_screenshots = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_hash_table_insert (portal->shared_screenshots,
+                       g_steal_pointer (&path),
+                       GUINT_TO_POINTER (n_waiters - 1));
+}
+
+static gboolean
+unshare_screenshot (XdpPortal *portal,
+                    const char *path)
+{
+  guint others;
+
+  if (portal->shared_screenshots == NULL)
+    return FALSE;
+
+  others = GPOINTER_TO_UINT (g_hash_table_lookup (portal->shared_screenshots, path));
+  if (others == 0)
+    return FALSE;
+
+  if (others > 1)
+    g_hash_table_insert (portal->shared_screenshots, g_strdup (path), GUINT_TO_POINTER (others - 1));
+  else
+    g_hash_table_remove (portal->shared_screenshots, path);
+
+  return TRUE;
+}
+
+typedef struct {
+  GFile *source;
+  StoredScreenshot *stored;
+} MoveData;
+
+static void
+move_data_free (MoveData *move)
+{
+  g_object_unref (move->source);
+  if (move->stored)
+    stored_screenshot_free (move->stored);
+  g_free (move);
+}
+
+/* Runs in a worker thread, the move is a copy across file systems */
+static void
+move_screenshot (GTask *task,
+                 gpointer source_object,
+                 gpointer task_data,
+                 GCancellable *cancellable)
+{
+  MoveData *move = task_data;
+  g_autoptr(GFile) dest = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+  GError *error = NULL;
+
+  dest = g_file_new_for_path (move->stored->path);
+
+  if (!g_file_move (move->source, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  info = g_file_query_info (dest, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  if (info)
+    move->stored->size = g_file_info_get_size (info);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+screenshot_moved (GObject *source,
+                  GAsyncResult *result,
+                  gpointer data)
+{
+  XdpPortal *portal = XDP_PORTAL (source);
+  MoveData *move = g_task_get_task_data (G_TASK (result));
+  g_autoptr(GTask) task = data;
+  g_autoptr(GError) error = NULL;
+  StoredScreenshot *stored;
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+      /* The screenshot is still usable where the backend put it */
+      g_warning ("Failed to move screenshot to %s: %s", portal->screenshot_dir, error->message);
+      g_task_return_pointer (task, g_file_get_uri (move->source), g_free);
+      return;
+    }
+
+  stored = g_steal_pointer (&move->stored);
+  g_queue_push_tail (&portal->screenshots, stored);
+  portal->screenshot_bytes += stored->size;
+  evict_screenshots (portal);
+
+  g_task_return_pointer (task, g_filename_to_uri (stored->path, NULL, NULL), g_free);
+}
+
+static void
+store_screenshot (XdpPortal *portal,
+                  GTask *task,
+                  const char *uri)
+{
+  g_autoptr(GTask) move_task = NULL;
+  g_autofree char *basename = NULL;
+  g_autofree char *name = NULL;
+  MoveData *move;
+
+  move = g_new0 (MoveData, 1);
+  move->source = g_file_new_for_uri (uri);
+
+  /* Backends may reuse names, keep every screenshot apart */
+  basename = g_file_get_basename (move->source);
+  name = g_strdup_printf ("%" G_GINT64_FORMAT "-%u-%s",
+                          g_get_real_time (), portal->screenshot_serial++, basename);
+
+  move->stored = g_new0 (StoredScreenshot, 1);
+  move->stored->path = g_build_filename (portal->screenshot_dir, name, NULL);
+
+  move_task = g_task_new (portal, NULL, screenshot_moved, g_object_ref (task));
+  g_task_set_task_data (move_task, move, (GDestroyNotify) move_data_free);
+  g_task_run_in_thread (move_task, move_screenshot);
+}
+
 static void
 response_received (GDBusConnection *bus,
                    const char *sender_name,
@@ -103,7 +326,9 @@ response_received (GDBusConnection *bus,
         {
           const char *uri;
           g_variant_lookup (ret, "uri", "&s", &uri);
-          if (uri)
+          if (uri && call->portal->screenshot_dir)
+            store_screenshot (call->portal, call->task, uri);
+          else if (uri)
             g_task_return_pointer (call->task, g_strdup (uri), g_free);
           else
             g_task_return_new_error (call->task, G_IO_ERROR, G_IO_ERROR_FAILED, "Screenshot not received");
@@ -151,7 +376,7 @@ static void
 take_screenshot (ScreenshotCall *call)
 {
   GVariantBuilder options;
-  g_autofree char *token = NULL;
+  const char *token;
   GCancellable *cancellable;
 
   if (call->parent_handle == NULL)
@@ -160,8 +385,7 @@ take_screenshot (ScreenshotCall *call)
       return;
     }
 
-  token = g_strdup_printf ("portal%d", g_random_int_range (0, G_MAXINT));
-  call->request_path = g_strconcat (REQUEST_PATH_PREFIX, call->portal->sender, "/", token, NULL);
+  call->request_path = _xdp_portal_new_handle (call->portal, REQUEST_PATH_PREFIX, &token);
   call->signal_id = g_dbus_connection_signal_subscribe (call->portal->bus,
                                                         PORTAL_BUS_NAME,
                                                         REQUEST_INTERFACE,
@@ -210,6 +434,11 @@ take_screenshot (ScreenshotCall *call)
  * @data: (closure): data to pass to @callback
  *
  * Takes a screenshot.
+ *
+ * Non-interactive screenshots without a parent window that are
+ * requested while another one is in progress share its result.
+ * The image file of a shared screenshot is only deleted by
+ * xdp_portal_release_screenshot() once every request has released it.
  * 
  * When the request is done, @callback will be called. You can then
  * call xdp_portal_take_screenshot_finish() to get the results.
@@ -224,9 +453,24 @@ xdp_portal_take_screenshot (XdpPortal *portal,
                             gpointer data)
 {
   ScreenshotCall *call;
+  GTask *task;
 
   g_return_if_fail (XDP_IS_PORTAL (portal));
 
+  task = g_task_new (portal, cancellable, callback, data);
+
+  if (parent == NULL && !interactive)
+    {
+      task = _xdp_portal_join_flight (portal,
+                                      modal ? "screenshot-modal" : "screenshot",
+                                      task,
+                                      (GBoxedCopyFunc) g_strdup,
+                                      g_free,
+                                      share_screenshot);
+      if (task == NULL)
+        return;
+    }
+
   call = g_new0 (ScreenshotCall, 1);
   call->color = FALSE;
   call->portal = g_object_ref (portal);
@@ -236,7 +480,7 @@ xdp_portal_take_screenshot (XdpPortal *portal,
     call->parent_handle = g_strdup ("");
   call->modal = modal;
   call->interactive = interactive;
-  call->task = g_task_new (portal, cancellable, callback, data);
+  call->task = task;
 
   take_screenshot (call);
 }
@@ -250,6 +494,9 @@ xdp_portal_take_screenshot (XdpPortal *portal,
  * Finishes a screenshot request, and returns
  * the result in the form of a URI pointing to an image file.
  *
+ * If a directory was set with xdp_portal_set_screenshot_storage(),
+ * the file has been moved there and is owned by libportal.
+ *
  * Returns: (transfer full): URI pointing to an image file
  */
 char *
@@ -324,3 +571,157 @@ xdp_portal_pick_color_finish (XdpPortal *portal,
   ret = (GVariant *) g_task_propagate_pointer (G_TASK (result), error);
   return ret ? g_variant_ref (ret) : NULL; 
 }
+
+/**
+ * xdp_portal_set_screenshot_storage:
+ * @portal: a #XdpPortal
+ * @directory: (nullable): the directory to move screenshots to, or %NULL
+ *     to leave new screenshots where the portal put them
+ * @max_files: the number of screenshots to keep, or 0 for no limit
+ * @max_bytes: the total size of the screenshots to keep, or 0 for no limit
+ *
+ * Lets libportal take ownership of the image files of screenshots.
+ *
+ * Once a directory is set, the file of each screenshot taken with
+ * xdp_portal_take_screenshot() is moved into @directory, and
+ * xdp_portal_take_screenshot_finish() returns its new location. The
+ * directory is created if it does not exist. A directory on a tmpfs
+ * keeps screenshots out of persistent storage.
+ *
+ * When a new screenshot exceeds @max_files or @max_bytes, the oldest
+ * screenshots are deleted until both limits are met again. The newest
+ * screenshot is never deleted this way. Changing the limits applies
+ * them right away.
+ *
+ * Screenshots that are shared by several requests, as described for
+ * xdp_portal_take_screenshot(), are stored once. Eviction deletes
+ * them regardless of how many requests still hold them.
+ */
+void
+xdp_portal_set_screenshot_storage (XdpPortal  *portal,
+                                   const char *directory,
+                                   guint       max_files,
+                                   guint64     max_bytes)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+
+  if (directory && g_mkdir_with_parents (directory, 0700) != 0)
+    g_warning ("Failed to create screenshot directory %s: %s", directory, g_strerror (errno));
+
+  g_free (portal->screenshot_dir);
+  portal->screenshot_dir = g_strdup (directory);
+  portal->screenshot_max_files = max_files;
+  portal->screenshot_max_bytes = max_bytes;
+
+  evict_screenshots (portal);
+}
+
+/**
+ * xdp_portal_get_screenshot_storage_stats:
+ * @portal: a #XdpPortal
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Obtains statistics about the screenshots that libportal owns,
+ * see xdp_portal_set_screenshot_storage().
+ */
+void
+xdp_portal_get_screenshot_storage_stats (XdpPortal                  *portal,
+                                         XdpScreenshotStorageStats  *stats)
+{
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (stats != NULL);
+
+  stats->n_files = portal->screenshots.length;
+  stats->n_bytes = portal->screenshot_bytes;
+  stats->n_evicted = portal->screenshots_evicted;
+  stats->n_evicted_bytes = portal->screenshot_bytes_evicted;
+}
+
+/**
+ * xdp_portal_release_screenshot:
+ * @portal: a #XdpPortal
+ * @uri: the URI of a screenshot, as returned by xdp_portal_take_screenshot_finish()
+ * @error: return location for an error
+ *
+ * Deletes the image file of a screenshot that is no longer needed.
+ * This works for any screenshot, whether libportal owns it or not.
+ *
+ * If the screenshot was shared by several requests, the file is
+ * kept until each of them has released it.
+ *
+ * Returns: %TRUE if the file was deleted, or is kept for
+ *     another request that shares it
+ */
+gboolean
+xdp_portal_release_screenshot (XdpPortal   *portal,
+                               const char  *uri,
+                               GError     **error)
+{
+  g_autofree char *path = NULL;
+  StoredScreenshot *stored;
+  int saved_errno;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), FALSE);
+  g_return_val_if_fail (uri != NULL, FALSE);
+
+  path = g_filename_from_uri (uri, NULL, error);
+  if (path == NULL)
+    return FALSE;
+
+  if (unshare_screenshot (portal, path))
+    return TRUE;
+
+  stored = forget_screenshot (portal, path);
+  if (stored)
+    stored_screenshot_free (stored);
+
+  if (g_unlink (path) != 0)
+    {
+      saved_errno = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                   "Failed to remove %s: %s", path, g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * xdp_portal_read_screenshot:
+ * @portal: a #XdpPortal
+ * @uri: the URI of a screenshot, as returned by xdp_portal_take_screenshot_finish()
+ * @error: return location for an error
+ *
+ * Reads the image file of a screenshot into memory and deletes it,
+ * like xdp_portal_release_screenshot(). This is useful when the image
+ * is sent elsewhere and should not stay on disk.
+ *
+ * Returns: (transfer full): the contents of the image file
+ */
+GBytes *
+xdp_portal_read_screenshot (XdpPortal   *portal,
+                            const char  *uri,
+                            GError     **error)
+{
+  g_autofree char *path = NULL;
+  char *contents;
+  gsize length;
+
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  path = g_filename_from_uri (uri, NULL, error);
+  if (path == NULL)
+    return NULL;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  if (!xdp_portal_release_screenshot (portal, uri, error))
+    {
+      g_free (contents);
+      return NULL;
+    }
+
+  return g_bytes_new_take (contents, length);
+}
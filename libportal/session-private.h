@@ -19,23 +19,133 @@
 
 #include "portal.h"
 
+typedef enum {
+  INPUT_POINTER_MOTION,
+  INPUT_POINTER_POSITION,
+  INPUT_POINTER_BUTTON,
+  INPUT_POINTER_AXIS,
+  INPUT_POINTER_AXIS_DISCRETE,
+  INPUT_KEYBOARD_KEYCODE,
+  INPUT_KEYBOARD_KEYSYM,
+  INPUT_TOUCH_DOWN,
+  INPUT_TOUCH_MOTION,
+  INPUT_TOUCH_UP
+} InputEventType;
+
+/* The arguments of a single Notify call on the RemoteDesktop portal.
+ * @value holds the button, key or number of steps, @state holds the
+ * button or key state or the axis. @marker is the ID of the latency
+ * marker that the event carries, or 0.
+ */
+typedef struct {
+  InputEventType type;
+  guint stream;
+  guint slot;
+  int value;
+  guint state;
+  gboolean finish;
+  double x;
+  double y;
+  guint marker;
+} InputEvent;
+
+typedef struct _JitterBuffer JitterBuffer;
+
+/* The signals of XdpSession. Some are emitted by the files
+ * of the portals they belong to.
+ */
+enum {
+  SESSION_CLOSED,
+  SESSION_RECONNECTED,
+  SESSION_SELECTION_OWNER_CHANGED,
+  SESSION_SELECTION_TRANSFER,
+  SESSION_ACTIVATED,
+  SESSION_DEACTIVATED,
+  SESSION_DISABLED,
+  SESSION_ZONES_CHANGED,
+  SESSION_SHORTCUTS_CHANGED,
+  SESSION_LAST_SIGNAL
+};
+
+extern guint _xdp_session_signals[SESSION_LAST_SIGNAL];
+
 struct _XdpSession {
   GObject parent_instance;
 
   XdpPortal *portal;
   char *id;
+  GVariant *id_path;
   XdpSessionType type;
   XdpSessionState state;
   XdpDeviceType devices;
   GVariant *streams;
 
   guint signal_id;
+
+  GQueue *latency_markers;
+  GArray *latency_samples;
+  guint latency_oldest;
+  guint latency_serial;
+  guint latency_lost;
+
+  gint64 input_time;
+  JitterBuffer *jitter;
+
+  XdpKeyRepeatMode key_repeat_mode;
+  guint key_repeat_delay;
+  guint key_repeat_interval;
+  GHashTable *held_keys;
+
+  guint32 touch_slots;
+  GArray *pressed_buttons;
+
+  XdpDeviceType requested_devices;
+  XdpOutputType outputs;
+  gboolean multiple;
+  char *restore_token;
+
+  gboolean auto_reconnect;
+  gboolean reconnecting;
+  gint64 closed_time;
+
+  gboolean clipboard_requested;
+  gboolean clipboard_enabled;
+  guint clipboard_signal_id;
+
+#if XDP_HAS_INPUTCAPTURE
+  XdpInputCapability capabilities;
+  GVariant *zones;
+  guint zone_set;
+  guint activation_id;
+  guint input_capture_signal_id;
+#endif
+
+#if XDP_HAS_GLOBALSHORTCUTS
+  GHashTable *shortcuts;
+  guint shortcuts_signal_id;
+#endif
 };
 
 XdpSession * _xdp_session_new (XdpPortal *portal,
                                const char *id,
                                XdpSessionType type);
 
+void         _xdp_session_set_id (XdpSession *session,
+                                  const char *id);
+
+void         _xdp_session_set_restore_token (XdpSession *session,
+                                             const char *token);
+
+void         _xdp_session_reconnect (XdpSession          *session,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             data);
+
+gboolean     _xdp_session_reconnect_finish (XdpSession    *session,
+                                            GAsyncResult  *result,
+                                            GError       **error);
+
+void         _xdp_session_replay_input_state (XdpSession *session);
+
 void         _xdp_session_set_session_state (XdpSession *session,
                                              XdpSessionState state);
 
@@ -44,3 +154,37 @@ void         _xdp_session_set_devices (XdpSession *session,
 
 void         _xdp_session_set_streams (XdpSession *session,
                                        GVariant   *streams);
+
+void         _xdp_session_clear_latency (XdpSession *session);
+
+void         _xdp_session_latency_marker_sent (XdpSession *session,
+                                               guint       marker);
+
+void         _xdp_session_send_input (XdpSession       *session,
+                                      const InputEvent *event);
+
+void         _xdp_session_dispatch_input (XdpSession       *session,
+                                          const InputEvent *event);
+
+GMainContext *_xdp_session_get_input_context (XdpSession *session);
+
+void         _xdp_session_flush_jitter_buffer (XdpSession *session);
+
+void         _xdp_session_clear_jitter_buffer (XdpSession *session);
+
+gboolean     _xdp_session_handle_key (XdpSession  *session,
+                                      gboolean     keysym,
+                                      int          key,
+                                      XdpKeyState  state);
+
+void         _xdp_session_clear_held_keys (XdpSession *session);
+
+void         _xdp_session_replay_held_keys (XdpSession *session);
+
+void         _xdp_session_subscribe_clipboard (XdpSession *session);
+
+void         _xdp_session_request_clipboard (XdpSession *session);
+
+void         _xdp_session_subscribe_input_capture (XdpSession *session);
+
+void         _xdp_session_refresh_zones (XdpSession *session);
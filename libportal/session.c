@@ -35,13 +35,12 @@
  *
  * All sessions start in an initial state. They can be made active by calling
  * xdp_session_start(), and ended by calling xdp_session_close().
+ *
+ * The sessions that have been created with an #XdpPortal can be enumerated
+ * with xdp_portal_get_sessions(), and closed all at once with
+ * xdp_portal_close_all_sessions().
  */
-enum {
-  CLOSED,
-  LAST_SIGNAL
-};
-
-static guint signals[LAST_SIGNAL];
+guint _xdp_session_signals[SESSION_LAST_SIGNAL];
 
 G_DEFINE_TYPE (XdpSession, xdp_session, G_TYPE_OBJECT)
 
@@ -52,10 +51,34 @@ xdp_session_finalize (GObject *object)
 
   if (session->signal_id)
     g_dbus_connection_signal_unsubscribe (session->portal->bus, session->signal_id);
+  if (session->clipboard_signal_id)
+    g_dbus_connection_signal_unsubscribe (session->portal->bus, session->clipboard_signal_id);
+#if XDP_HAS_INPUTCAPTURE
+  if (session->input_capture_signal_id)
+    g_dbus_connection_signal_unsubscribe (session->portal->bus, session->input_capture_signal_id);
+#endif
+#if XDP_HAS_GLOBALSHORTCUTS
+  if (session->shortcuts_signal_id)
+    g_dbus_connection_signal_unsubscribe (session->portal->bus, session->shortcuts_signal_id);
+#endif
+
+  _xdp_portal_remove_session (session->portal, session);
 
   g_clear_object (&session->portal);
   g_free (session->id);
+  g_clear_pointer (&session->id_path, g_variant_unref);
   g_clear_pointer (&session->streams, g_variant_unref);
+  _xdp_session_clear_latency (session);
+  _xdp_session_clear_jitter_buffer (session);
+  g_clear_pointer (&session->held_keys, g_hash_table_unref);
+  g_clear_pointer (&session->pressed_buttons, g_array_unref);
+  g_free (session->restore_token);
+#if XDP_HAS_INPUTCAPTURE
+  g_clear_pointer (&session->zones, g_variant_unref);
+#endif
+#if XDP_HAS_GLOBALSHORTCUTS
+  g_clear_pointer (&session->shortcuts, g_hash_table_unref);
+#endif
 
   G_OBJECT_CLASS (xdp_session_parent_class)->finalize (object);
 }
@@ -72,7 +95,7 @@ xdp_session_class_init (XdpSessionClass *klass)
    *
    * The ::closed signal is emitted when a session is closed externally.
    */
-  signals[CLOSED] =
+  _xdp_session_signals[SESSION_CLOSED] =
     g_signal_new ("closed",
                   G_TYPE_FROM_CLASS (object_class),
                   G_SIGNAL_RUN_CLEANUP | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
@@ -80,6 +103,166 @@ xdp_session_class_init (XdpSessionClass *klass)
                   NULL, NULL,
                   NULL,
                   G_TYPE_NONE, 0);
+
+  /**
+   * XdpSession::reconnected:
+   * @session: the #XdpSession
+   * @downtime: the time between the session being closed and
+   *     being active again, in microseconds
+   *
+   * The ::reconnected signal is emitted when a session that was closed
+   * externally has been recreated and started again, see
+   * xdp_session_set_auto_reconnect().
+   */
+  _xdp_session_signals[SESSION_RECONNECTED] =
+    g_signal_new ("reconnected",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_INT64);
+
+  /**
+   * XdpSession::selection-owner-changed:
+   * @session: the #XdpSession
+   * @mime_types: (array zero-terminated=1): the mime types of the new selection
+   * @session_is_owner: whether @session owns the selection
+   *
+   * The ::selection-owner-changed signal is emitted when the
+   * clipboard contents change, see xdp_session_request_clipboard().
+   */
+  _xdp_session_signals[SESSION_SELECTION_OWNER_CHANGED] =
+    g_signal_new ("selection-owner-changed",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_STRV,
+                  G_TYPE_BOOLEAN);
+
+  /**
+   * XdpSession::selection-transfer:
+   * @session: the #XdpSession
+   * @mime_type: the requested mime type
+   * @serial: the serial to pass to xdp_session_selection_write()
+   *
+   * The ::selection-transfer signal is emitted when data from the
+   * selection that is owned by @session is pasted. Handlers must
+   * eventually call xdp_session_selection_write() or
+   * xdp_session_selection_write_done() with @serial.
+   */
+  _xdp_session_signals[SESSION_SELECTION_TRANSFER] =
+    g_signal_new ("selection-transfer",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 2,
+                  G_TYPE_STRING,
+                  G_TYPE_UINT);
+
+  /**
+   * XdpSession::activated:
+   * @session: the #XdpSession
+   * @activation_id: the ID of this activation
+   * @barrier_id: the barrier that was hit
+   * @x: the x coordinate of the pointer
+   * @y: the y coordinate of the pointer
+   *
+   * The ::activated signal is emitted when an input capture session
+   * starts capturing input.
+   */
+  _xdp_session_signals[SESSION_ACTIVATED] =
+    g_signal_new ("activated",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 4,
+                  G_TYPE_UINT,
+                  G_TYPE_UINT,
+                  G_TYPE_DOUBLE,
+                  G_TYPE_DOUBLE);
+
+  /**
+   * XdpSession::deactivated:
+   * @session: the #XdpSession
+   * @activation_id: the ID of the activation that ended
+   * @x: the x coordinate of the pointer
+   * @y: the y coordinate of the pointer
+   *
+   * The ::deactivated signal is emitted when an input capture session
+   * stops capturing input.
+   */
+  _xdp_session_signals[SESSION_DEACTIVATED] =
+    g_signal_new ("deactivated",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 3,
+                  G_TYPE_UINT,
+                  G_TYPE_DOUBLE,
+                  G_TYPE_DOUBLE);
+
+  /**
+   * XdpSession::disabled:
+   * @session: the #XdpSession
+   *
+   * The ::disabled signal is emitted when input capture was disabled
+   * by the compositor. It needs to be enabled again before more input
+   * is captured.
+   */
+  _xdp_session_signals[SESSION_DISABLED] =
+    g_signal_new ("disabled",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 0);
+
+  /**
+   * XdpSession::zones-changed:
+   * @session: the #XdpSession
+   *
+   * The ::zones-changed signal is emitted when the zones of an input
+   * capture session have changed, and xdp_session_get_zones() returns
+   * the new zones. The pointer barriers need to be set up again.
+   */
+  _xdp_session_signals[SESSION_ZONES_CHANGED] =
+    g_signal_new ("zones-changed",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 0);
+
+  /**
+   * XdpSession::shortcuts-changed:
+   * @session: the #XdpSession
+   * @shortcuts: the bound shortcuts, as a #GVariant of type `a(sa{sv})`
+   *
+   * The ::shortcuts-changed signal is emitted when the user changes
+   * the key combinations of the shortcuts of a global shortcuts session.
+   */
+  _xdp_session_signals[SESSION_SHORTCUTS_CHANGED] =
+    g_signal_new ("shortcuts-changed",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_VARIANT);
 }
 
 static void
@@ -87,6 +270,31 @@ xdp_session_init (XdpSession *session)
 {
 }
 
+static void
+session_reconnected (GObject *source,
+                     GAsyncResult *result,
+                     gpointer data)
+{
+  XdpSession *session = XDP_SESSION (source);
+  g_autoptr(GError) error = NULL;
+
+  session->reconnecting = FALSE;
+
+  if (!_xdp_session_reconnect_finish (session, result, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Failed to reconnect session: %s", error->message);
+      if (session->state != XDP_SESSION_CLOSED)
+        _xdp_session_set_session_state (session, XDP_SESSION_CLOSED);
+      return;
+    }
+
+  _xdp_session_replay_input_state (session);
+
+  g_signal_emit (session, _xdp_session_signals[SESSION_RECONNECTED], 0,
+                 g_get_monotonic_time () - session->closed_time);
+}
+
 static void
 session_closed (GDBusConnection *bus,
                 const char *sender_name,
@@ -98,23 +306,40 @@ session_closed (GDBusConnection *bus,
 {
   XdpSession *session = data;
 
+  if (session->auto_reconnect &&
+      session->state == XDP_SESSION_ACTIVE &&
+      !session->reconnecting)
+    {
+      /* The session stays active from the applications point of view,
+       * input is dropped until the new session has been started.
+       */
+      session->reconnecting = TRUE;
+      session->closed_time = g_get_monotonic_time ();
+      _xdp_session_reconnect (session, session_reconnected, NULL);
+      return;
+    }
+
   _xdp_session_set_session_state (session, XDP_SESSION_CLOSED);
 }
 
-XdpSession *
-_xdp_session_new (XdpPortal *portal,
-                  const char *id,
-                  XdpSessionType type)
+void
+_xdp_session_set_id (XdpSession *session,
+                     const char *id)
 {
-  XdpSession *session;
+  if (session->signal_id)
+    g_dbus_connection_signal_unsubscribe (session->portal->bus, session->signal_id);
+
+  if (session->id)
+    {
+      _xdp_portal_remove_session (session->portal, session);
+      g_free (session->id);
+      g_variant_unref (session->id_path);
+    }
 
-  session = g_object_new (XDP_TYPE_SESSION, NULL);
-  session->portal = g_object_ref (portal);
   session->id = g_strdup (id);
-  session->type = type;
-  session->state = XDP_SESSION_INITIAL;
+  session->id_path = g_variant_ref_sink (g_variant_new_object_path (id));
 
-  session->signal_id = g_dbus_connection_signal_subscribe (portal->bus,
+  session->signal_id = g_dbus_connection_signal_subscribe (session->portal->bus,
                                                            PORTAL_BUS_NAME,
                                                            SESSION_INTERFACE,
                                                            "Closed",
@@ -124,9 +349,86 @@ _xdp_session_new (XdpPortal *portal,
                                                            session_closed,
                                                            session,
                                                            NULL);
+
+  if (session->clipboard_requested)
+    _xdp_session_subscribe_clipboard (session);
+
+  _xdp_portal_add_session (session->portal, session);
+}
+
+XdpSession *
+_xdp_session_new (XdpPortal *portal,
+                  const char *id,
+                  XdpSessionType type)
+{
+  XdpSession *session;
+
+  session = g_object_new (XDP_TYPE_SESSION, NULL);
+  session->portal = g_object_ref (portal);
+  session->type = type;
+  session->state = XDP_SESSION_INITIAL;
+
+  _xdp_session_set_id (session, id);
+
   return session;
 }
 
+/**
+ * xdp_session_set_auto_reconnect:
+ * @session: a #XdpSession
+ * @auto_reconnect: whether to reconnect the session automatically
+ *
+ * Sets whether @session should be recreated when it is closed externally,
+ * for example because the portal backend restarted.
+ *
+ * When this is enabled and an active session is closed externally, the
+ * session is created again with the same parameters and started, using
+ * restore data from the previous start if the portal provided any. Input
+ * sent while this is happening is dropped, and keys and buttons that were
+ * held down are pressed again once the session is active. Keys are only
+ * tracked when key repeat handling is enabled with xdp_session_set_key_repeat().
+ *
+ * When the session is active again, the #XdpSession::reconnected signal
+ * is emitted. The pipewire streams of the new session are different, so
+ * applications need to call xdp_session_open_pipewire_remote() and
+ * xdp_session_get_streams() again. If the session can not be recreated,
+ * it is closed and #XdpSession::closed is emitted.
+ */
+void
+xdp_session_set_auto_reconnect (XdpSession *session,
+                                gboolean auto_reconnect)
+{
+  g_return_if_fail (XDP_IS_SESSION (session));
+  g_return_if_fail (session->type == XDP_SESSION_SCREENCAST ||
+                    session->type == XDP_SESSION_REMOTE_DESKTOP);
+
+  session->auto_reconnect = auto_reconnect;
+}
+
+/**
+ * xdp_session_get_auto_reconnect:
+ * @session: a #XdpSession
+ *
+ * Returns whether @session is recreated when it is closed externally.
+ *
+ * Returns: %TRUE if the session reconnects automatically
+ */
+gboolean
+xdp_session_get_auto_reconnect (XdpSession *session)
+{
+  g_return_val_if_fail (XDP_IS_SESSION (session), FALSE);
+
+  return session->auto_reconnect;
+}
+
+void
+_xdp_session_set_restore_token (XdpSession *session,
+                                const char *token)
+{
+  g_free (session->restore_token);
+  session->restore_token = g_strdup (token);
+}
+
 /**
  * xdp_session_get_session_type:
  * @session: an #XdpSession
@@ -165,8 +467,6 @@ void
 _xdp_session_set_session_state (XdpSession *session,
                                 XdpSessionState state)
 {
-  session->state = state;
-
   if (state == XDP_SESSION_INITIAL && session->state != XDP_SESSION_INITIAL)
     {
       g_warning ("Can't move a session back to initial state");
@@ -178,8 +478,13 @@ _xdp_session_set_session_state (XdpSession *session,
       return;
     }
 
+  session->state = state;
+
   if (state == XDP_SESSION_CLOSED)
-    g_signal_emit (session, signals[CLOSED], 0);
+    {
+      _xdp_session_clear_held_keys (session);
+      g_signal_emit (session, _xdp_session_signals[SESSION_CLOSED], 0);
+    }
 }
 
 /**
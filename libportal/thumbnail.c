@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "portal-private.h"
+
+/**
+ * SECTION:thumbnail
+ * @title: Screenshot processing
+ * @short_description: crop and scale screenshots
+ *
+ * xdp_portal_process_screenshot() turns the image file of a screenshot
+ * into pixel buffers in memory: it crops the image and scales it to any
+ * number of sizes, such as the thumbnails shown in a user interface.
+ *
+ * The image is decoded once, and all work happens in a worker thread.
+ * Images are only scaled down, with a box filter that averages all
+ * source pixels covered by a destination pixel. Each size is scaled
+ * from the smallest larger result that is at least twice as big, so
+ * producing several sizes costs little more than producing the largest.
+ */
+
+/* Pixels are RGBA, 8 bits per channel, without padding between rows.
+ * If the image has an alpha channel, the color is premultiplied,
+ * so that transparent pixels do not bleed into their neighbors.
+ */
+typedef struct {
+  int width;
+  int height;
+  GBytes *pixels;
+} Image;
+
+typedef struct {
+  char *path;
+  int x;
+  int y;
+  int width;
+  int height;
+  guint *sizes;
+  gsize n_sizes;
+} ProcessData;
+
+static void
+image_free (Image *image)
+{
+  g_bytes_unref (image->pixels);
+  g_free (image);
+}
+
+static void
+process_data_free (ProcessData *data)
+{
+  g_free (data->path);
+  g_free (data->sizes);
+  g_free (data);
+}
+
+static Image *
+image_new_from_pixbuf (GdkPixbuf *pixbuf)
+{
+  Image *image;
+  const guchar *src;
+  guchar *pixels;
+  int n_channels;
+  int rowstride;
+  int x, y;
+
+  image = g_new0 (Image, 1);
+  image->width = gdk_pixbuf_get_width (pixbuf);
+  image->height = gdk_pixbuf_get_height (pixbuf);
+
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  src = gdk_pixbuf_read_pixels (pixbuf);
+
+  pixels = g_malloc ((gsize) image->width * image->height * 4);
+
+  for (y = 0; y < image->height; y++)
+    {
+      const guchar *s = src + (gsize) y * rowstride;
+      guchar *d = pixels + (gsize) y * image->width * 4;
+
+      if (n_channels == 4)
+        {
+          for (x = 0; x < image->width; x++, s += 4, d += 4)
+            {
+              d[0] = (s[0] * s[3] + 127) / 255;
+              d[1] = (s[1] * s[3] + 127) / 255;
+              d[2] = (s[2] * s[3] + 127) / 255;
+              d[3] = s[3];
+            }
+        }
+      else
+        {
+          for (x = 0; x < image->width; x++, s += 3, d += 4)
+            {
+              d[0] = s[0];
+              d[1] = s[1];
+              d[2] = s[2];
+              d[3] = 255;
+            }
+        }
+    }
+
+  image->pixels = g_bytes_new_take (pixels, (gsize) image->width * image->height * 4);
+
+  return image;
+}
+
+/* Computes the contribution of each source pixel to each destination
+ * pixel along one axis. Destination pixel i covers the source range
+ * [i * scale, (i + 1) * scale), and each source pixel is weighted by
+ * how much of it lies in that range. The weights of i are stored at
+ * i * taps, the first source pixel is start[i].
+ */
+static float *
+box_weights (int  src_len,
+             int  dst_len,
+             int *start,
+             int *count,
+             int *taps)
+{
+  double scale = (double) src_len / dst_len;
+  float *weights;
+  int i, j;
+
+  *taps = (int) ceil (scale) + 1;
+  weights = g_new0 (float, (gsize) dst_len * *taps);
+
+  for (i = 0; i < dst_len; i++)
+    {
+      double lo = i * scale;
+      double hi = (i + 1) * scale;
+      int first = (int) floor (lo);
+      int last = MIN ((int) ceil (hi), src_len);
+
+      start[i] = first;
+      count[i] = last - first;
+
+      for (j = first; j < last; j++)
+        weights[i * *taps + j - first] = (MIN (hi, j + 1) - MAX (lo, j)) / scale;
+    }
+
+  return weights;
+}
+
+static Image *
+image_scale (const Image *src,
+             int          width,
+             int          height)
+{
+  const guchar *pixels;
+  Image *image;
+  guchar *out;
+  float *tmp;
+  float *acc;
+  float *hweights, *vweights;
+  int *hstart, *hcount, *vstart, *vcount;
+  int htaps, vtaps;
+  int row_len = width * 4;
+  int x, y, i, k;
+
+  pixels = g_bytes_get_data (src->pixels, NULL);
+
+  hstart = g_new (int, width);
+  hcount = g_new (int, width);
+  vstart = g_new (int, height);
+  vcount = g_new (int, height);
+  hweights = box_weights (src->width, width, hstart, hcount, &htaps);
+  vweights = box_weights (src->height, height, vstart, vcount, &vtaps);
+
+  /* Scale each row horizontally into floats first, then combine rows */
+  tmp = g_new (float, (gsize) src->height * row_len);
+
+  for (y = 0; y < src->height; y++)
+    {
+      const guchar *row = pixels + (gsize) y * src->width * 4;
+      float *t = tmp + (gsize) y * row_len;
+
+      for (x = 0; x < width; x++)
+        {
+          const guchar *p = row + hstart[x] * 4;
+          const float *w = hweights + x * htaps;
+          float r = 0, g = 0, b = 0, a = 0;
+
+          for (k = 0; k < hcount[x]; k++, p += 4)
+            {
+              r += w[k] * p[0];
+              g += w[k] * p[1];
+              b += w[k] * p[2];
+              a += w[k] * p[3];
+            }
+
+          t[x * 4] = r;
+          t[x * 4 + 1] = g;
+          t[x * 4 + 2] = b;
+          t[x * 4 + 3] = a;
+        }
+    }
+
+  out = g_malloc ((gsize) height * row_len);
+  acc = g_new (float, row_len);
+
+  for (y = 0; y < height; y++)
+    {
+      guchar *d = out + (gsize) y * row_len;
+
+      memset (acc, 0, sizeof (float) * row_len);
+
+      for (k = 0; k < vcount[y]; k++)
+        {
+          const float *t = tmp + (gsize) (vstart[y] + k) * row_len;
+          float w = vweights[y * vtaps + k];
+
+          /* Plain loop over a whole row, simple for the compiler to vectorize */
+          for (i = 0; i < row_len; i++)
+            acc[i] += w * t[i];
+        }
+
+      for (i = 0; i < row_len; i++)
+        d[i] = (guchar) CLAMP (acc[i] + 0.5f, 0.f, 255.f);
+    }
+
+  g_free (acc);
+  g_free (tmp);
+  g_free (hweights);
+  g_free (vweights);
+  g_free (hstart);
+  g_free (hcount);
+  g_free (vstart);
+  g_free (vcount);
+
+  image = g_new0 (Image, 1);
+  image->width = width;
+  image->height = height;
+  image->pixels = g_bytes_new_take (out, (gsize) height * row_len);
+
+  return image;
+}
+
+static GVariant *
+image_serialize (const Image *image,
+                 gboolean     has_alpha)
+{
+  GBytes *bytes;
+  GVariant *pixels;
+  gsize size;
+
+  if (has_alpha)
+    {
+      const guchar *s = g_bytes_get_data (image->pixels, &size);
+      guchar *d = g_malloc (size);
+      gsize i;
+
+      for (i = 0; i < size; i += 4)
+        {
+          guint a = s[i + 3];
+
+          if (a == 0)
+            {
+              memset (d + i, 0, 4);
+              continue;
+            }
+
+          d[i] = MIN ((s[i] * 255 + a / 2) / a, 255);
+          d[i + 1] = MIN ((s[i + 1] * 255 + a / 2) / a, 255);
+          d[i + 2] = MIN ((s[i + 2] * 255 + a / 2) / a, 255);
+          d[i + 3] = a;
+        }
+
+      bytes = g_bytes_new_take (d, size);
+    }
+  else
+    bytes = g_bytes_ref (image->pixels);
+
+  pixels = g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, bytes, TRUE);
+  g_bytes_unref (bytes);
+
+  return g_variant_new ("(iii@ay)", image->width, image->height, image->width * 4, pixels);
+}
+
+static int
+compare_sizes (gconstpointer a,
+               gconstpointer b,
+               gpointer      data)
+{
+  const guint *sizes = data;
+  guint sa = sizes[*(const guint *) a];
+  guint sb = sizes[*(const guint *) b];
+
+  /* 0 means full size and goes first */
+  if (sa == sb)
+    return 0;
+  if (sa == 0)
+    return -1;
+  if (sb == 0)
+    return 1;
+
+  return sa > sb ? -1 : 1;
+}
+
+static void
+process_thread (GTask        *task,
+                gpointer      source_object,
+                gpointer      task_data,
+                GCancellable *cancellable)
+{
+  ProcessData *data = task_data;
+  g_autoptr(GdkPixbuf) pixbuf = NULL;
+  g_autoptr(GdkPixbuf) cropped = NULL;
+  g_autoptr(GPtrArray) images = NULL;
+  g_autofree guint *order = NULL;
+  g_autofree GVariant **results = NULL;
+  GVariantBuilder builder;
+  GError *error = NULL;
+  Image *crop;
+  gboolean has_alpha;
+  int x, y, width, height;
+  gsize i, j;
+
+  pixbuf = gdk_pixbuf_new_from_file (data->path, &error);
+  if (pixbuf == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  x = MAX (data->x, 0);
+  y = MAX (data->y, 0);
+  width = gdk_pixbuf_get_width (pixbuf) - x;
+  height = gdk_pixbuf_get_height (pixbuf) - y;
+  if (data->width > 0)
+    width = MIN (width, data->x + data->width - x);
+  if (data->height > 0)
+    height = MIN (height, data->y + data->height - y);
+
+  if (width <= 0 || height <= 0)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                               "Crop area lies outside of the %dx%d screenshot",
+                               gdk_pixbuf_get_width (pixbuf),
+                               gdk_pixbuf_get_height (pixbuf));
+      return;
+    }
+
+  has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  cropped = gdk_pixbuf_new_subpixbuf (pixbuf, x, y, width, height);
+  crop = image_new_from_pixbuf (cropped);
+  g_clear_object (&cropped);
+  g_clear_object (&pixbuf);
+
+  /* Largest first, so that smaller sizes can start from a larger result */
+  images = g_ptr_array_new_with_free_func ((GDestroyNotify) image_free);
+  g_ptr_array_add (images, crop);
+
+  order = g_new (guint, data->n_sizes);
+  for (i = 0; i < data->n_sizes; i++)
+    order[i] = i;
+  g_qsort_with_data (order, data->n_sizes, sizeof (guint), compare_sizes, data->sizes);
+
+  results = g_new0 (GVariant *, data->n_sizes);
+
+  for (i = 0; i < data->n_sizes; i++)
+    {
+      guint size = data->sizes[order[i]];
+      Image *source = crop;
+      Image *image;
+      int w, h;
+
+      if (g_task_return_error_if_cancelled (task))
+        goto out;
+
+      if (size == 0 || (crop->width <= size && crop->height <= size))
+        {
+          results[order[i]] = image_serialize (crop, has_alpha);
+          continue;
+        }
+
+      if (crop->width >= crop->height)
+        {
+          w = size;
+          h = MAX (1, (int) round ((double) crop->height * size / crop->width));
+        }
+      else
+        {
+          h = size;
+          w = MAX (1, (int) round ((double) crop->width * size / crop->height));
+        }
+
+      for (j = 0; j < images->len; j++)
+        {
+          Image *candidate = g_ptr_array_index (images, j);
+
+          if (candidate->width >= 2 * w && candidate->height >= 2 * h)
+            source = candidate;
+        }
+
+      image = image_scale (source, w, h);
+      g_ptr_array_add (images, image);
+
+      results[order[i]] = image_serialize (image, has_alpha);
+    }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(iiiay)"));
+  for (i = 0; i < data->n_sizes; i++)
+    g_variant_builder_add_value (&builder, g_steal_pointer (&results[i]));
+
+  g_task_return_pointer (task,
+                         g_variant_ref_sink (g_variant_builder_end (&builder)),
+                         (GDestroyNotify) g_variant_unref);
+
+out:
+  for (i = 0; i < data->n_sizes; i++)
+    if (results[i])
+      g_variant_unref (g_variant_ref_sink (results[i]));
+}
+
+/**
+ * xdp_portal_process_screenshot:
+ * @portal: a #XdpPortal
+ * @uri: the URI of a screenshot, as returned by xdp_portal_take_screenshot_finish()
+ * @x: the left edge of the area to keep
+ * @y: the top edge of the area to keep
+ * @width: the width of the area to keep, or 0 to keep everything right of @x
+ * @height: the height of the area to keep, or 0 to keep everything below @y
+ * @sizes: (array length=n_sizes): the maximum width and height of each result
+ * @n_sizes: the number of elements in @sizes
+ * @cancellable: (nullable): optional #GCancellable
+ * @callback: (scope async): a callback to call when the request is done
+ * @data: (closure): data to pass to @callback
+ *
+ * Crops a screenshot and scales it to each of @sizes in a worker thread.
+ *
+ * Each result is scaled down to fit into a square of the given size,
+ * keeping the aspect ratio of the cropped area. Images that already fit
+ * are not scaled up. A size of 0 returns the cropped area at full size.
+ *
+ * When the request is done, @callback will be called. You can then
+ * call xdp_portal_process_screenshot_finish() to get the results.
+ */
+void
+xdp_portal_process_screenshot (XdpPortal           *portal,
+                               const char          *uri,
+                               int                  x,
+                               int                  y,
+                               int                  width,
+                               int                  height,
+                               const guint         *sizes,
+                               gsize                n_sizes,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  ProcessData *process;
+  char *path;
+
+  g_return_if_fail (XDP_IS_PORTAL (portal));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (sizes != NULL || n_sizes == 0);
+
+  task = g_task_new (portal, cancellable, callback, data);
+
+  path = g_filename_from_uri (uri, NULL, &error);
+  if (path == NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  process = g_new0 (ProcessData, 1);
+  process->path = path;
+  process->x = x;
+  process->y = y;
+  process->width = width;
+  process->height = height;
+  process->sizes = g_new (guint, n_sizes);
+  memcpy (process->sizes, sizes, sizeof (guint) * n_sizes);
+  process->n_sizes = n_sizes;
+  g_task_set_task_data (task, process, (GDestroyNotify) process_data_free);
+
+  g_task_run_in_thread (task, process_thread);
+}
+
+/**
+ * xdp_portal_process_screenshot_finish:
+ * @portal: a #XdpPortal
+ * @result: a #GAsyncResult
+ * @error: return location for an error
+ *
+ * Finishes a screenshot processing request, and returns the results
+ * in the form of a GVariant of type a(iiiay), with one element for each
+ * requested size, in the same order. Each element contains the width,
+ * height and rowstride of the image, followed by its pixels in RGBA
+ * format with 8 bits per channel and non-premultiplied alpha.
+ *
+ * The pixels can be wrapped without copying, for example with
+ * g_variant_get_data_as_bytes() and gdk_pixbuf_new_from_bytes().
+ *
+ * Returns: (transfer full): a GVariant containing the images
+ */
+GVariant *
+xdp_portal_process_screenshot_finish (XdpPortal     *portal,
+                                      GAsyncResult  *result,
+                                      GError       **error)
+{
+  g_return_val_if_fail (XDP_IS_PORTAL (portal), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, portal), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -1,11 +1,23 @@
+#include <string.h>
+
 #include <gtk/gtk.h>
 #include <gst/gst.h>
 
 #include "portal-test-app.h"
+#include "portal-test-bench.h"
 
 int
 main (int argc, char *argv[])
 {
+  int i;
+
+  /* Benchmarks run without a window */
+  for (i = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "--bench") == 0)
+        return portal_test_bench (argc, argv);
+    }
+
   gst_init (&argc, &argv);
 
   g_message ("Starting org.gnome.PortalTest");
@@ -0,0 +1,553 @@
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libportal/portal.h"
+
+#include "portal-test-bench.h"
+
+/* Headless benchmarks. Each scenario runs a fixed amount of work
+ * against whatever provides the portal on the session bus, which can
+ * be the real one or portal-replay on a private bus, and reports
+ * latency percentiles and throughput.
+ */
+
+typedef struct {
+  char *name;
+  GArray *samples;
+  guint64 ops;
+  gint64 first_start;
+  gint64 last_end;
+  guint failures;
+} Stats;
+
+typedef struct _Bench Bench;
+
+typedef void (* ScenarioFunc) (Bench *bench);
+
+struct _Bench {
+  XdpPortal *portal;
+  GMainLoop *loop;
+  char **scenarios;
+  guint scenario;
+  int count;
+  int rate;
+  int burst;
+  int done;
+  int in_flight;
+  gint64 op_start;
+  guint timeout_id;
+  XdpSession *session;
+  GPtrArray *stats;
+};
+
+static void
+stats_free (Stats *stats)
+{
+  g_free (stats->name);
+  g_array_unref (stats->samples);
+  g_free (stats);
+}
+
+static Stats *
+get_stats (Bench *bench,
+           const char *name)
+{
+  Stats *stats;
+  guint i;
+
+  for (i = 0; i < bench->stats->len; i++)
+    {
+      stats = g_ptr_array_index (bench->stats, i);
+      if (strcmp (stats->name, name) == 0)
+        return stats;
+    }
+
+  stats = g_new0 (Stats, 1);
+  stats->name = g_strdup (name);
+  stats->samples = g_array_new (FALSE, FALSE, sizeof (gint64));
+  g_ptr_array_add (bench->stats, stats);
+
+  return stats;
+}
+
+static void
+add_sample (Bench *bench,
+            const char *name,
+            gint64 start,
+            guint64 ops)
+{
+  Stats *stats = get_stats (bench, name);
+  gint64 now = g_get_monotonic_time ();
+  gint64 sample = now - start;
+
+  if (stats->samples->len == 0)
+    stats->first_start = start;
+  stats->last_end = now;
+  stats->ops += ops;
+
+  g_array_append_val (stats->samples, sample);
+}
+
+static void
+add_failure (Bench *bench,
+             const char *name,
+             GError *error)
+{
+  get_stats (bench, name)->failures++;
+  g_printerr ("%s failed: %s\n", name, error->message);
+}
+
+static int
+compare_samples (gconstpointer a,
+                 gconstpointer b)
+{
+  gint64 sa = *(const gint64 *) a;
+  gint64 sb = *(const gint64 *) b;
+
+  return (sa > sb) - (sa < sb);
+}
+
+static double
+percentile (GArray *samples,
+            double p)
+{
+  guint i;
+
+  i = (guint) (p * (samples->len - 1) + 0.5);
+  return g_array_index (samples, gint64, i) / 1000.0;
+}
+
+static void
+print_stats (Bench *bench)
+{
+  guint i;
+
+  g_print ("%-16s %7s %7s %9s %9s %9s %9s %10s\n",
+           "scenario", "count", "failed", "p50 ms", "p90 ms", "p99 ms", "max ms", "ops/s");
+
+  for (i = 0; i < bench->stats->len; i++)
+    {
+      Stats *stats = g_ptr_array_index (bench->stats, i);
+      double elapsed;
+
+      if (stats->samples->len == 0)
+        {
+          g_print ("%-16s %7u %7u\n", stats->name, 0, stats->failures);
+          continue;
+        }
+
+      g_array_sort (stats->samples, compare_samples);
+      elapsed = (stats->last_end - stats->first_start) / (double) G_USEC_PER_SEC;
+
+      g_print ("%-16s %7u %7u %9.2f %9.2f %9.2f %9.2f %10.1f\n",
+               stats->name,
+               stats->samples->len,
+               stats->failures,
+               percentile (stats->samples, 0.5),
+               percentile (stats->samples, 0.9),
+               percentile (stats->samples, 0.99),
+               percentile (stats->samples, 1.0),
+               elapsed > 0 ? stats->ops / elapsed : 0);
+    }
+}
+
+static void next_scenario (Bench *bench);
+
+/* Screenshots */
+
+static void take_screenshot (Bench *bench);
+
+static void
+screenshot_taken (GObject *source,
+                  GAsyncResult *result,
+                  gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *uri = NULL;
+
+  uri = xdp_portal_take_screenshot_finish (bench->portal, result, &error);
+  if (uri)
+    {
+      g_autoptr(GFile) file = g_file_new_for_uri (uri);
+
+      add_sample (bench, "screenshot", bench->op_start, 1);
+      g_file_delete (file, NULL, NULL);
+    }
+  else
+    add_failure (bench, "screenshot", error);
+
+  take_screenshot (bench);
+}
+
+static void
+take_screenshot (Bench *bench)
+{
+  if (bench->done == bench->count)
+    {
+      next_scenario (bench);
+      return;
+    }
+
+  bench->done++;
+  bench->op_start = g_get_monotonic_time ();
+  xdp_portal_take_screenshot (bench->portal, NULL, FALSE, FALSE, NULL, screenshot_taken, bench);
+}
+
+/* Notifications */
+
+typedef struct {
+  Bench *bench;
+  char *id;
+  gint64 start;
+} NotificationOp;
+
+static void
+notification_delivered (GObject *source,
+                        GAsyncResult *result,
+                        gpointer data)
+{
+  NotificationOp *op = data;
+  Bench *bench = op->bench;
+  g_autoptr(GError) error = NULL;
+
+  if (xdp_portal_flush_finish (bench->portal, result, &error))
+    add_sample (bench, "notification", op->start, 1);
+  else
+    add_failure (bench, "notification", error);
+
+  xdp_portal_remove_notification (bench->portal, op->id);
+
+  g_free (op->id);
+  g_free (op);
+
+  if (--bench->in_flight == 0 && bench->timeout_id == 0)
+    next_scenario (bench);
+}
+
+static gboolean
+send_notification (gpointer data)
+{
+  Bench *bench = data;
+  NotificationOp *op;
+  GVariantBuilder notification;
+
+  if (bench->done == bench->count)
+    {
+      bench->timeout_id = 0;
+      if (bench->in_flight == 0)
+        next_scenario (bench);
+      return G_SOURCE_REMOVE;
+    }
+
+  op = g_new0 (NotificationOp, 1);
+  op->bench = bench;
+  op->id = g_strdup_printf ("bench%d", bench->done++);
+  op->start = g_get_monotonic_time ();
+
+  g_variant_builder_init (&notification, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&notification, "{sv}", "title", g_variant_new_string ("Benchmark"));
+  g_variant_builder_add (&notification, "{sv}", "body", g_variant_new_string (op->id));
+  xdp_portal_add_notification (bench->portal, op->id, g_variant_builder_end (&notification));
+
+  /* A notification has arrived when the calls before the flush have */
+  bench->in_flight++;
+  xdp_portal_flush (bench->portal, -1, NULL, notification_delivered, op);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Sessions */
+
+static void cycle_session (Bench *bench);
+
+static void
+session_closed (GObject *source,
+                GAsyncResult *result,
+                gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+
+  if (xdp_portal_flush_finish (bench->portal, result, &error))
+    add_sample (bench, "session-close", bench->op_start, 1);
+  else
+    add_failure (bench, "session-close", error);
+
+  cycle_session (bench);
+}
+
+static void
+session_started (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+
+  if (xdp_session_start_finish (bench->session, result, &error))
+    {
+      add_sample (bench, "session-start", bench->op_start, 1);
+
+      bench->op_start = g_get_monotonic_time ();
+      xdp_session_close (bench->session);
+      g_clear_object (&bench->session);
+      xdp_portal_flush (bench->portal, -1, NULL, session_closed, bench);
+      return;
+    }
+
+  add_failure (bench, "session-start", error);
+  g_clear_object (&bench->session);
+  cycle_session (bench);
+}
+
+static void
+session_created (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+
+  bench->session = xdp_portal_create_remote_desktop_session_finish (bench->portal, result, &error);
+  if (bench->session == NULL)
+    {
+      add_failure (bench, "session-create", error);
+      cycle_session (bench);
+      return;
+    }
+
+  add_sample (bench, "session-create", bench->op_start, 1);
+
+  bench->op_start = g_get_monotonic_time ();
+  xdp_session_start (bench->session, NULL, NULL, session_started, bench);
+}
+
+static void
+cycle_session (Bench *bench)
+{
+  if (bench->done == bench->count)
+    {
+      next_scenario (bench);
+      return;
+    }
+
+  bench->done++;
+  bench->op_start = g_get_monotonic_time ();
+  xdp_portal_create_remote_desktop_session (bench->portal,
+                                            XDP_DEVICE_POINTER | XDP_DEVICE_KEYBOARD,
+                                            XDP_OUTPUT_MONITOR,
+                                            FALSE,
+                                            NULL,
+                                            session_created,
+                                            bench);
+}
+
+/* Input */
+
+static void send_burst (Bench *bench);
+
+static void
+burst_delivered (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+
+  if (xdp_portal_flush_finish (bench->portal, result, &error))
+    add_sample (bench, "input-burst", bench->op_start, bench->burst);
+  else
+    add_failure (bench, "input-burst", error);
+
+  send_burst (bench);
+}
+
+static void
+send_burst (Bench *bench)
+{
+  int i;
+
+  if (bench->done == bench->count)
+    {
+      xdp_session_close (bench->session);
+      g_clear_object (&bench->session);
+      next_scenario (bench);
+      return;
+    }
+
+  bench->done++;
+  bench->op_start = g_get_monotonic_time ();
+  for (i = 0; i < bench->burst; i++)
+    xdp_session_pointer_motion (bench->session, i % 2 ? 1 : -1, 0);
+
+  xdp_portal_flush (bench->portal, -1, NULL, burst_delivered, bench);
+}
+
+static void
+input_session_started (GObject *source,
+                       GAsyncResult *result,
+                       gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+
+  if (!xdp_session_start_finish (bench->session, result, &error))
+    {
+      add_failure (bench, "input-burst", error);
+      g_clear_object (&bench->session);
+      next_scenario (bench);
+      return;
+    }
+
+  send_burst (bench);
+}
+
+static void
+input_session_created (GObject *source,
+                       GAsyncResult *result,
+                       gpointer data)
+{
+  Bench *bench = data;
+  g_autoptr(GError) error = NULL;
+
+  bench->session = xdp_portal_create_remote_desktop_session_finish (bench->portal, result, &error);
+  if (bench->session == NULL)
+    {
+      add_failure (bench, "input-burst", error);
+      next_scenario (bench);
+      return;
+    }
+
+  xdp_session_start (bench->session, NULL, NULL, input_session_started, bench);
+}
+
+static void
+start_input (Bench *bench)
+{
+  xdp_portal_create_remote_desktop_session (bench->portal,
+                                            XDP_DEVICE_POINTER,
+                                            XDP_OUTPUT_MONITOR,
+                                            FALSE,
+                                            NULL,
+                                            input_session_created,
+                                            bench);
+}
+
+static void
+start_screenshots (Bench *bench)
+{
+  take_screenshot (bench);
+}
+
+static void
+start_notifications (Bench *bench)
+{
+  bench->timeout_id = g_timeout_add (MAX (1000 / bench->rate, 1), send_notification, bench);
+}
+
+static void
+start_sessions (Bench *bench)
+{
+  cycle_session (bench);
+}
+
+static const struct {
+  const char *name;
+  ScenarioFunc start;
+} scenarios[] = {
+  { "screenshot", start_screenshots },
+  { "notification", start_notifications },
+  { "session", start_sessions },
+  { "input", start_input },
+};
+
+static void
+next_scenario (Bench *bench)
+{
+  const char *name;
+  guint i;
+
+  name = bench->scenarios[bench->scenario];
+  if (name == NULL)
+    {
+      g_main_loop_quit (bench->loop);
+      return;
+    }
+
+  bench->scenario++;
+  bench->done = 0;
+
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++)
+    {
+      if (strcmp (scenarios[i].name, name) == 0)
+        {
+          scenarios[i].start (bench);
+          return;
+        }
+    }
+
+  g_printerr ("Unknown scenario %s\n", name);
+  next_scenario (bench);
+}
+
+int
+portal_test_bench (int argc,
+                   char *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *list = NULL;
+  gboolean bench_mode = FALSE;
+  Bench bench = { 0, };
+  guint failures = 0;
+  guint i;
+  GOptionEntry entries[] = {
+    { "bench", 0, 0, G_OPTION_ARG_NONE, &bench_mode, "Run benchmarks instead of the test window", NULL },
+    { "scenarios", 0, 0, G_OPTION_ARG_STRING, &list, "Comma-separated scenarios: screenshot, notification, session, input", "LIST" },
+    { "count", 0, 0, G_OPTION_ARG_INT, &bench.count, "Iterations per scenario", "N" },
+    { "rate", 0, 0, G_OPTION_ARG_INT, &bench.rate, "Notifications per second", "M" },
+    { "burst", 0, 0, G_OPTION_ARG_INT, &bench.burst, "Input events per burst", "K" },
+    { NULL }
+  };
+
+  bench.count = 20;
+  bench.rate = 50;
+  bench.burst = 100;
+
+  context = g_option_context_new ("- benchmark portal calls");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  if (bench.count <= 0 || bench.rate <= 0 || bench.burst <= 0)
+    {
+      g_printerr ("--count, --rate and --burst must be positive\n");
+      return 1;
+    }
+
+  bench.scenarios = g_strsplit (list ? list : "screenshot,notification,session,input", ",", -1);
+  bench.stats = g_ptr_array_new_with_free_func ((GDestroyNotify) stats_free);
+  bench.loop = g_main_loop_new (NULL, FALSE);
+  bench.portal = xdp_portal_new ();
+
+  next_scenario (&bench);
+  g_main_loop_run (bench.loop);
+
+  print_stats (&bench);
+
+  for (i = 0; i < bench.stats->len; i++)
+    failures += ((Stats *) g_ptr_array_index (bench.stats, i))->failures;
+
+  g_object_unref (bench.portal);
+  g_main_loop_unref (bench.loop);
+  g_ptr_array_unref (bench.stats);
+  g_strfreev (bench.scenarios);
+
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <glib.h>
+
+int portal_test_bench (int argc, char *argv[]);
@@ -319,6 +319,34 @@ save_dialog (GtkWidget *button, PortalTestWin *win)
   g_object_unref (dialog);
 }
 
+#if XDP_HAS_SCREENSHOT_PROCESSING
+static void
+processed (GObject *source,
+           GAsyncResult *result,
+           gpointer data)
+{
+  PortalTestWin *win = data;
+  g_autoptr(GVariant) ret = NULL;
+  g_autoptr(GVariant) pixels = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GdkPixbuf) pixbuf = NULL;
+  g_autoptr(GError) error = NULL;
+  int width, height, stride;
+
+  ret = xdp_portal_process_screenshot_finish (win->portal, result, &error);
+  if (ret == NULL)
+    {
+      g_warning ("Failed to scale screenshot: %s", error->message);
+      return;
+    }
+
+  g_variant_get_child (ret, 0, "(iii@ay)", &width, &height, &stride, &pixels);
+  bytes = g_variant_get_data_as_bytes (pixels);
+  pixbuf = gdk_pixbuf_new_from_bytes (bytes, GDK_COLORSPACE_RGB, TRUE, 8, width, height, stride);
+  gtk_image_set_from_pixbuf (GTK_IMAGE (win->image), pixbuf);
+}
+#endif
+
 static void
 taken (GObject *source,
        GAsyncResult *result,
@@ -326,12 +354,19 @@ taken (GObject *source,
 {
   PortalTestWin *win = data;
   g_autofree char *uri = NULL;
-  g_autoptr(GdkPixbuf) pixbuf = NULL;
   g_autoptr(GError) error = NULL;
 
   uri = xdp_portal_take_screenshot_finish (win->portal, result, &error);
   if (uri != NULL)
     {
+#if XDP_HAS_SCREENSHOT_PROCESSING
+      static const guint sizes[] = { 60 };
+
+      /* Scale in a worker thread instead of decoding here */
+      xdp_portal_process_screenshot (win->portal, uri, 0, 0, 0, 0,
+                                     sizes, G_N_ELEMENTS (sizes),
+                                     NULL, processed, win);
+#else
       g_autofree char *path = NULL;
       g_autoptr(GdkPixbuf) pixbuf = NULL;
       g_autoptr(GError) error = NULL;
@@ -342,6 +377,7 @@ taken (GObject *source,
         g_warning ("Failed to load screenshot from %s: %s", uri, error->message);
       else
         gtk_image_set_from_pixbuf (GTK_IMAGE (win->image), pixbuf);
+#endif
     }
   else
     g_warning ("Failed to load screenshot: %s", error->message);
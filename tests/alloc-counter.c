@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Counts the heap allocations of the whole process, including those
+ * of libportal, GLib and the GDBus worker thread. The allocator
+ * functions defined here take precedence over the ones in libc for
+ * every library, and hand on to glibc's own implementation.
+ *
+ * GLib no longer lets applications replace its allocator, and
+ * g_malloc() ends up in malloc() anyway, so this sees everything.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-counter.h"
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+extern void  __libc_free (void *ptr);
+
+static int counting;
+static uint64_t allocations;
+static uint64_t bytes;
+
+static void
+count (size_t size)
+{
+  if (__atomic_load_n (&counting, __ATOMIC_RELAXED))
+    {
+      __atomic_fetch_add (&allocations, 1, __ATOMIC_RELAXED);
+      __atomic_fetch_add (&bytes, size, __ATOMIC_RELAXED);
+    }
+}
+
+void *
+malloc (size_t size)
+{
+  count (size);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n,
+        size_t size)
+{
+  count (n * size);
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+  /* Shrinking or freeing does not cost anything */
+  if (ptr == NULL || size > 0)
+    count (size);
+  return __libc_realloc (ptr, size);
+}
+
+int
+posix_memalign (void   **ptr,
+                size_t   alignment,
+                size_t   size)
+{
+  void *mem;
+
+  count (size);
+  mem = __libc_memalign (alignment, size);
+  if (mem == NULL)
+    return ENOMEM;
+
+  *ptr = mem;
+  return 0;
+}
+
+void *
+aligned_alloc (size_t alignment,
+               size_t size)
+{
+  count (size);
+  return __libc_memalign (alignment, size);
+}
+
+void *
+memalign (size_t alignment,
+          size_t size)
+{
+  count (size);
+  return __libc_memalign (alignment, size);
+}
+
+void
+free (void *ptr)
+{
+  __libc_free (ptr);
+}
+
+void
+alloc_counter_start (void)
+{
+  __atomic_store_n (&allocations, 0, __ATOMIC_RELAXED);
+  __atomic_store_n (&bytes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n (&counting, 1, __ATOMIC_SEQ_CST);
+}
+
+void
+alloc_counter_stop (uint64_t *n_allocations,
+                    uint64_t *n_bytes)
+{
+  __atomic_store_n (&counting, 0, __ATOMIC_SEQ_CST);
+  *n_allocations = __atomic_load_n (&allocations, __ATOMIC_RELAXED);
+  *n_bytes = __atomic_load_n (&bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,1004 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Counts the allocations that the public API makes, and compares them
+ * with the budgets that are checked in next to this file.
+ *
+ * Each scenario runs against portal-replay --repeat, which answers from
+ * the recording of the same name. After one warm-up run, which is not
+ * counted so that one-time setup such as type registration does not
+ * show up, ITERATIONS runs are counted. The numbers are per run, and
+ * include the allocations of GLib and of the GDBus worker thread on
+ * behalf of libportal. Then the growth of the resident set over
+ * RSS_ITERATIONS more runs is measured, to catch leaks.
+ *
+ * With --update, the measured numbers are written to the budget file
+ * instead, with some headroom. Scenarios whose budget is "-" have not
+ * been measured yet; they are reported, and the test is skipped unless
+ * another scenario fails.
+ *
+ * With --record, each scenario runs once against the portal of the
+ * session, and its recording is written with LIBPORTAL_RECORD. This
+ * shows the dialogs of the portal, which have to be accepted.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "libportal/portal.h"
+
+#include "alloc-counter.h"
+
+#define PORTAL_BUS_NAME "org.freedesktop.portal.Desktop"
+
+#define ITERATIONS 5
+#define RSS_ITERATIONS 500
+#define INPUT_BURST 100
+
+/* Percent added on top of measured numbers by --update */
+#define HEADROOM 10
+
+/* kB added on top of the measured growth of the resident set by
+ * --update, since it grows by whole pages and arenas
+ */
+#define RSS_SLACK 256
+
+/* meson treats this exit status as a skipped test */
+#define EXIT_SKIP 77
+
+typedef struct {
+  guint64 allocations;
+  guint64 bytes;
+  guint64 rss;
+} Usage;
+
+typedef struct _Test Test;
+
+typedef void (* StepFunc) (Test *test);
+
+struct _Test {
+  XdpPortal *portal;
+  XdpSession *session;
+  gboolean close_session;
+  GVariant *notification;
+  GVariant *print_settings;
+  gboolean done;
+  GError *error;
+};
+
+static void
+step_done (Test *test,
+           GError *error)
+{
+  if (error)
+    g_propagate_error (&test->error, error);
+  test->done = TRUE;
+}
+
+/* Calls that get no answer hang here until meson's test timeout */
+static gboolean
+run_step (Test *test,
+          StepFunc step)
+{
+  test->done = FALSE;
+  step (test);
+
+  while (!test->done)
+    g_main_context_iteration (NULL, TRUE);
+
+  return test->error == NULL;
+}
+
+static void
+flushed (GObject *source,
+         GAsyncResult *result,
+         gpointer data)
+{
+  Test *test = data;
+  GError *error = NULL;
+
+  xdp_portal_flush_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+/* Calls without a callback have arrived when the calls before
+ * the flush have
+ */
+static void
+flush (Test *test)
+{
+  xdp_portal_flush (test->portal, -1, NULL, flushed, test);
+}
+
+#if XDP_HAS_FILECHOOSER
+
+/* File chooser */
+
+static void
+file_opened (GObject *source,
+             GAsyncResult *result,
+             gpointer data)
+{
+  Test *test = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = xdp_portal_open_file_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+open_file (Test *test)
+{
+  xdp_portal_open_file (test->portal, NULL, "Allocations", FALSE, FALSE, NULL, NULL, NULL, file_opened, test);
+}
+
+static void
+file_saved (GObject *source,
+            GAsyncResult *result,
+            gpointer data)
+{
+  Test *test = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = xdp_portal_save_file_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+save_file (Test *test)
+{
+  xdp_portal_save_file (test->portal, NULL, "Allocations", FALSE, "allocations.txt", NULL, NULL, NULL, NULL, NULL, file_saved, test);
+}
+
+#endif /* XDP_HAS_FILECHOOSER */
+
+#if XDP_HAS_SCREENSHOT
+
+/* Screenshots */
+
+static void
+screenshot_taken (GObject *source,
+                  GAsyncResult *result,
+                  gpointer data)
+{
+  Test *test = data;
+  g_autofree char *uri = NULL;
+  GError *error = NULL;
+
+  uri = xdp_portal_take_screenshot_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+take_screenshot (Test *test)
+{
+  xdp_portal_take_screenshot (test->portal, NULL, FALSE, FALSE, NULL, screenshot_taken, test);
+}
+
+static void
+color_picked (GObject *source,
+              GAsyncResult *result,
+              gpointer data)
+{
+  Test *test = data;
+  g_autoptr(GVariant) color = NULL;
+  GError *error = NULL;
+
+  color = xdp_portal_pick_color_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+pick_color (Test *test)
+{
+  xdp_portal_pick_color (test->portal, NULL, NULL, color_picked, test);
+}
+
+#endif /* XDP_HAS_SCREENSHOT */
+
+#if XDP_HAS_NOTIFICATION
+
+/* Notifications, built once so that only libportal is counted */
+
+static void
+prepare_notification (Test *test)
+{
+  GVariantBuilder notification;
+
+  g_variant_builder_init (&notification, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&notification, "{sv}", "title", g_variant_new_string ("Allocations"));
+  g_variant_builder_add (&notification, "{sv}", "body", g_variant_new_string ("Counting"));
+  test->notification = g_variant_ref_sink (g_variant_builder_end (&notification));
+
+  step_done (test, NULL);
+}
+
+static void
+add_notification (Test *test)
+{
+  xdp_portal_add_notification (test->portal, "allocations", test->notification);
+  xdp_portal_remove_notification (test->portal, "allocations");
+  flush (test);
+}
+
+#endif /* XDP_HAS_NOTIFICATION */
+
+#if XDP_HAS_EMAIL
+
+/* Email */
+
+static void
+email_composed (GObject *source,
+                GAsyncResult *result,
+                gpointer data)
+{
+  Test *test = data;
+  GError *error = NULL;
+
+  xdp_portal_compose_email_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+compose_email (Test *test)
+{
+  xdp_portal_compose_email (test->portal, NULL, "someone@example.org", "Allocations", "Counting", NULL, NULL, email_composed, test);
+}
+
+#endif /* XDP_HAS_EMAIL */
+
+#if XDP_HAS_ACCOUNT
+
+/* Account */
+
+static void
+user_information_received (GObject *source,
+                           GAsyncResult *result,
+                           gpointer data)
+{
+  Test *test = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = xdp_portal_get_user_information_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+get_user_information (Test *test)
+{
+  xdp_portal_get_user_information (test->portal, NULL, "Allocations", NULL, user_information_received, test);
+}
+
+#endif /* XDP_HAS_ACCOUNT */
+
+#if XDP_HAS_INHIBIT
+
+/* Inhibit */
+
+static void
+inhibit (Test *test)
+{
+  xdp_portal_inhibit (test->portal, NULL, XDP_INHIBIT_IDLE, "Allocations", "allocations");
+  xdp_portal_uninhibit (test->portal, "allocations");
+  flush (test);
+}
+
+#endif /* XDP_HAS_INHIBIT */
+
+#if XDP_HAS_OPENURI
+
+/* Open URI, with a URI that is not a local file */
+
+static void
+open_uri (Test *test)
+{
+  xdp_portal_open_uri (test->portal, NULL, "https://example.org/allocations", FALSE);
+  flush (test);
+}
+
+#endif /* XDP_HAS_OPENURI */
+
+#if XDP_HAS_PRINT
+
+/* Print, with empty settings and page setup built once */
+
+static void
+prepare_print_settings (Test *test)
+{
+  test->print_settings = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0));
+
+  step_done (test, NULL);
+}
+
+static void
+print_prepared (GObject *source,
+                GAsyncResult *result,
+                gpointer data)
+{
+  Test *test = data;
+  g_autoptr(GVariant) ret = NULL;
+  GError *error = NULL;
+
+  ret = xdp_portal_prepare_print_finish (test->portal, result, &error);
+  step_done (test, error);
+}
+
+static void
+prepare_print (Test *test)
+{
+  xdp_portal_prepare_print (test->portal, NULL, "Allocations", FALSE,
+                            test->print_settings, test->print_settings,
+                            NULL, print_prepared, test);
+}
+
+#endif /* XDP_HAS_PRINT */
+
+#if XDP_HAS_REMOTE
+
+/* Sessions */
+
+static void
+session_started (GObject *source,
+                 GAsyncResult *result,
+                 gpointer data)
+{
+  Test *test = data;
+  GError *error = NULL;
+
+  if (!xdp_session_start_finish (test->session, result, &error) || !test->close_session)
+    {
+      step_done (test, error);
+      return;
+    }
+
+  xdp_session_close (test->session);
+  g_clear_object (&test->session);
+  flush (test);
+}
+
+static void
+start_created_session (Test *test,
+                       GError *error)
+{
+  if (test->session == NULL)
+    {
+      step_done (test, error);
+      return;
+    }
+
+  xdp_session_start (test->session, NULL, NULL, session_started, test);
+}
+
+static void
+screencast_session_created (GObject *source,
+                            GAsyncResult *result,
+                            gpointer data)
+{
+  Test *test = data;
+  GError *error = NULL;
+
+  test->session = xdp_portal_create_screencast_session_finish (test->portal, result, &error);
+  start_created_session (test, error);
+}
+
+static void
+remote_desktop_session_created (GObject *source,
+                                GAsyncResult *result,
+                                gpointer data)
+{
+  Test *test = data;
+  GError *error = NULL;
+
+  test->session = xdp_portal_create_remote_desktop_session_finish (test->portal, result, &error);
+  start_created_session (test, error);
+}
+
+static void
+screencast_session (Test *test)
+{
+  test->close_session = TRUE;
+  xdp_portal_create_screencast_session (test->portal,
+                                        XDP_OUTPUT_MONITOR,
+                                        FALSE,
+                                        NULL,
+                                        screencast_session_created,
+                                        test);
+}
+
+static void
+remote_desktop_session (Test *test)
+{
+  test->close_session = TRUE;
+  xdp_portal_create_remote_desktop_session (test->portal,
+                                            XDP_DEVICE_KEYBOARD | XDP_DEVICE_POINTER,
+                                            XDP_OUTPUT_NONE,
+                                            FALSE,
+                                            NULL,
+                                            remote_desktop_session_created,
+                                            test);
+}
+
+/* Input, into a session that stays open */
+
+static void
+start_session (Test *test)
+{
+  xdp_portal_create_remote_desktop_session (test->portal,
+                                            XDP_DEVICE_KEYBOARD | XDP_DEVICE_POINTER | XDP_DEVICE_TOUCHSCREEN,
+                                            XDP_OUTPUT_NONE,
+                                            FALSE,
+                                            NULL,
+                                            remote_desktop_session_created,
+                                            test);
+}
+
+static void
+move_pointer (Test *test)
+{
+  int i;
+
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_pointer_motion (test->session, i % 2 ? 1 : -1, 0);
+
+  flush (test);
+}
+
+static void
+position_pointer (Test *test)
+{
+  int i;
+
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_pointer_position (test->session, 0, i, i);
+
+  flush (test);
+}
+
+static void
+click_pointer (Test *test)
+{
+  int i;
+
+  /* BTN_LEFT */
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_pointer_button (test->session, 0x110, i % 2 ? XDP_BUTTON_RELEASED : XDP_BUTTON_PRESSED);
+
+  flush (test);
+}
+
+static void
+scroll_pointer (Test *test)
+{
+  int i;
+
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_pointer_axis (test->session, i % 10 == 9, 0, 1);
+
+  flush (test);
+}
+
+static void
+scroll_pointer_discrete (Test *test)
+{
+  int i;
+
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_pointer_axis_discrete (test->session, XDP_AXIS_VERTICAL_SCROLL, 1);
+
+  flush (test);
+}
+
+static void
+type_keycodes (Test *test)
+{
+  int i;
+
+  /* KEY_A */
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_keyboard_key (test->session, FALSE, 30, i % 2 ? XDP_KEY_RELEASED : XDP_KEY_PRESSED);
+
+  flush (test);
+}
+
+static void
+type_keysyms (Test *test)
+{
+  int i;
+
+  /* XK_a */
+  for (i = 0; i < INPUT_BURST; i++)
+    xdp_session_keyboard_key (test->session, TRUE, 0x61, i % 2 ? XDP_KEY_RELEASED : XDP_KEY_PRESSED);
+
+  flush (test);
+}
+
+static void
+touch (Test *test)
+{
+  int i;
+
+  for (i = 0; i < INPUT_BURST / 4; i++)
+    {
+      xdp_session_touch_down (test->session, 0, 0, i, i);
+      xdp_session_touch_position (test->session, 0, 0, i + 1, i);
+      xdp_session_touch_position (test->session, 0, 0, i + 2, i);
+      xdp_session_touch_up (test->session, 0);
+    }
+
+  flush (test);
+}
+
+#endif /* XDP_HAS_REMOTE */
+
+static const struct {
+  const char *name;
+  StepFunc setup;
+  StepFunc run;
+} scenarios[] = {
+#if XDP_HAS_FILECHOOSER
+  { "open-file", NULL, open_file },
+  { "save-file", NULL, save_file },
+#endif
+#if XDP_HAS_SCREENSHOT
+  { "screenshot", NULL, take_screenshot },
+  { "pick-color", NULL, pick_color },
+#endif
+#if XDP_HAS_NOTIFICATION
+  { "notification", prepare_notification, add_notification },
+#endif
+#if XDP_HAS_EMAIL
+  { "email", NULL, compose_email },
+#endif
+#if XDP_HAS_ACCOUNT
+  { "account", NULL, get_user_information },
+#endif
+#if XDP_HAS_INHIBIT
+  { "inhibit", NULL, inhibit },
+#endif
+#if XDP_HAS_OPENURI
+  { "open-uri", NULL, open_uri },
+#endif
+#if XDP_HAS_PRINT
+  { "print", prepare_print_settings, prepare_print },
+#endif
+#if XDP_HAS_REMOTE
+  { "screencast-session", NULL, screencast_session },
+  { "remote-desktop-session", NULL, remote_desktop_session },
+  { "pointer-motion", start_session, move_pointer },
+  { "pointer-position", start_session, position_pointer },
+  { "pointer-button", start_session, click_pointer },
+  { "pointer-axis", start_session, scroll_pointer },
+  { "pointer-axis-discrete", start_session, scroll_pointer_discrete },
+  { "keyboard-keycode", start_session, type_keycodes },
+  { "keyboard-keysym", start_session, type_keysyms },
+  { "touch", start_session, touch },
+#endif
+};
+
+static void
+test_clear (Test *test)
+{
+#if XDP_HAS_REMOTE
+  if (test->session)
+    {
+      xdp_session_close (test->session);
+      g_object_unref (test->session);
+    }
+#endif
+  g_clear_pointer (&test->notification, g_variant_unref);
+  g_clear_pointer (&test->print_settings, g_variant_unref);
+  g_object_unref (test->portal);
+}
+
+static char *
+recording_path (const char *recordings,
+                guint scenario)
+{
+  g_autofree char *filename = NULL;
+
+  filename = g_strconcat (scenarios[scenario].name, ".recording", NULL);
+
+  return g_build_filename (recordings, filename, NULL);
+}
+
+static void
+name_appeared (GDBusConnection *bus,
+               const char *name,
+               const char *owner,
+               gpointer data)
+{
+  *(int *) data = TRUE;
+}
+
+static void
+name_vanished (GDBusConnection *bus,
+               const char *name,
+               gpointer data)
+{
+  *(int *) data = FALSE;
+}
+
+static void
+wait_for_portal (gboolean owned)
+{
+  int state = -1;
+  guint watch_id;
+
+  watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION,
+                               PORTAL_BUS_NAME,
+                               G_BUS_NAME_WATCHER_FLAGS_NONE,
+                               name_appeared,
+                               name_vanished,
+                               &state,
+                               NULL);
+
+  while (state != owned)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_bus_unwatch_name (watch_id);
+}
+
+/* In kB, or 0 if it is not known */
+static guint64
+read_rss (void)
+{
+  g_autofree char *status = NULL;
+  const char *line;
+
+  if (!g_file_get_contents ("/proc/self/status", &status, NULL, NULL))
+    return 0;
+
+  line = strstr (status, "\nVmRSS:");
+  if (line == NULL)
+    return 0;
+
+  return g_ascii_strtoull (line + strlen ("\nVmRSS:"), NULL, 10);
+}
+
+static gboolean
+measure (Test *test,
+         guint scenario,
+         Usage *usage)
+{
+  guint64 rss;
+  guint i;
+
+  if (scenarios[scenario].setup && !run_step (test, scenarios[scenario].setup))
+    return FALSE;
+
+  if (!run_step (test, scenarios[scenario].run))
+    return FALSE;
+
+  alloc_counter_start ();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      if (!run_step (test, scenarios[scenario].run))
+        break;
+    }
+  alloc_counter_stop (&usage->allocations, &usage->bytes);
+
+  usage->allocations = (usage->allocations + ITERATIONS - 1) / ITERATIONS;
+  usage->bytes = (usage->bytes + ITERATIONS - 1) / ITERATIONS;
+
+  rss = read_rss ();
+  for (i = 0; i < RSS_ITERATIONS && test->error == NULL; i++)
+    run_step (test, scenarios[scenario].run);
+  usage->rss = MAX (read_rss (), rss) - rss;
+
+  return test->error == NULL;
+}
+
+static gboolean
+run_scenario (const char *replay,
+              const char *recordings,
+              guint scenario,
+              Usage *usage,
+              GError **error)
+{
+  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autofree char *recording = NULL;
+  Test test = { 0, };
+  gboolean ret;
+
+  recording = recording_path (recordings, scenario);
+
+  subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, error,
+                                 replay, "--speed=1000", "--repeat", recording, NULL);
+  if (subprocess == NULL)
+    return FALSE;
+
+  wait_for_portal (TRUE);
+
+  test.portal = xdp_portal_new ();
+  ret = measure (&test, scenario, usage);
+  test_clear (&test);
+
+  g_subprocess_force_exit (subprocess);
+  g_subprocess_wait (subprocess, NULL, NULL);
+
+  /* The next scenario has to talk to its own replay */
+  wait_for_portal (FALSE);
+
+  if (!ret)
+    g_propagate_error (error, test.error);
+
+  return ret;
+}
+
+/* Runs in a process of its own, since LIBPORTAL_RECORD is only
+ * looked at once per process
+ */
+static int
+record_scenario (const char *name)
+{
+  Test test = { 0, };
+  guint scenario;
+
+  for (scenario = 0; scenario < G_N_ELEMENTS (scenarios); scenario++)
+    {
+      if (strcmp (scenarios[scenario].name, name) == 0)
+        break;
+    }
+
+  if (scenario == G_N_ELEMENTS (scenarios))
+    {
+      g_printerr ("No scenario %s\n", name);
+      return 1;
+    }
+
+  test.portal = xdp_portal_new ();
+  if (scenarios[scenario].setup == NULL || run_step (&test, scenarios[scenario].setup))
+    run_step (&test, scenarios[scenario].run);
+  test_clear (&test);
+
+  if (test.error)
+    {
+      g_printerr ("%s: %s\n", name, test.error->message);
+      g_error_free (test.error);
+      return 1;
+    }
+
+  return 0;
+}
+
+static gboolean
+record_scenarios (const char *recordings,
+                  GError **error)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++)
+    {
+      g_autoptr(GSubprocessLauncher) launcher = NULL;
+      g_autoptr(GSubprocess) subprocess = NULL;
+      g_autofree char *recording = NULL;
+      g_autofree char *option = NULL;
+
+      g_print ("Recording %s\n", scenarios[i].name);
+
+      recording = recording_path (recordings, i);
+      option = g_strconcat ("--record-scenario=", scenarios[i].name, NULL);
+
+      launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+      g_subprocess_launcher_setenv (launcher, "LIBPORTAL_RECORD", recording, TRUE);
+      subprocess = g_subprocess_launcher_spawn (launcher, error, "/proc/self/exe", option, NULL);
+      if (subprocess == NULL || !g_subprocess_wait_check (subprocess, NULL, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Scenarios that have not been measured yet have no budget */
+static GHashTable *
+load_budgets (const char *filename,
+              GError **error)
+{
+  g_autoptr(GHashTable) budgets = NULL;
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    return NULL;
+
+  budgets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      char name[64];
+      char first[64];
+      Usage *budget;
+
+      if (lines[i][0] == '\0' || lines[i][0] == '#')
+        continue;
+
+      if (sscanf (lines[i], "%63s %63s", name, first) == 2 && strcmp (first, "-") == 0)
+        {
+          g_hash_table_insert (budgets, g_strdup (name), NULL);
+          continue;
+        }
+
+      budget = g_new0 (Usage, 1);
+      if (sscanf (lines[i], "%63s %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT,
+                  name, &budget->allocations, &budget->bytes, &budget->rss) != 4)
+        {
+          g_free (budget);
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "%s:%u: Expected a scenario and three numbers, or -", filename, i + 1);
+          return NULL;
+        }
+
+      g_hash_table_insert (budgets, g_strdup (name), budget);
+    }
+
+  return g_steal_pointer (&budgets);
+}
+
+static gboolean
+save_budgets (const char *filename,
+              const Usage *usage,
+              GError **error)
+{
+  g_autoptr(GString) contents = NULL;
+  guint i;
+
+  contents = g_string_new ("# Allocations per run of each scenario in test-allocations.c,\n"
+                           "# the bytes they request in total, and the kB that the resident\n"
+                           "# set may grow by over many runs. The test fails when a run\n"
+                           "# needs more. Scenarios with a budget of - are not measured yet.\n"
+                           "# Regenerate with: ninja update-allocation-budgets\n"
+                           "#\n"
+                           "# scenario\tallocations\tbytes\trss\n");
+
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++)
+    g_string_append_printf (contents, "%s\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\n",
+                            scenarios[i].name,
+                            usage[i].allocations + usage[i].allocations * HEADROOM / 100,
+                            usage[i].bytes + usage[i].bytes * HEADROOM / 100,
+                            usage[i].rss + usage[i].rss * HEADROOM / 100 + RSS_SLACK);
+
+  return g_file_set_contents (filename, contents->str, contents->len, error);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GHashTable) budgets = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *record_name = NULL;
+  Usage usage[G_N_ELEMENTS (scenarios)];
+  gboolean update = FALSE;
+  gboolean record = FALSE;
+  int failures = 0;
+  int unmeasured = 0;
+  guint i;
+  GOptionEntry entries[] = {
+    { "update", 0, 0, G_OPTION_ARG_NONE, &update, "Write the measured numbers to BUDGETS", NULL },
+    { "record", 0, 0, G_OPTION_ARG_NONE, &record, "Record the scenarios into RECORDINGS, against the portal of the session", NULL },
+    { "record-scenario", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &record_name, NULL, NULL },
+    { NULL }
+  };
+
+  context = g_option_context_new ("PORTAL-REPLAY RECORDINGS BUDGETS - check allocation budgets");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  if (record_name)
+    return record_scenario (record_name);
+
+  if (record)
+    {
+      if (argc != 2)
+        {
+          g_printerr ("Usage: %s --record RECORDINGS\n", g_get_prgname ());
+          return 1;
+        }
+
+      if (!record_scenarios (argv[1], &error))
+        {
+          g_printerr ("Failed to record: %s\n", error->message);
+          return 1;
+        }
+
+      return 0;
+    }
+
+  if (argc != 4)
+    {
+      g_printerr ("Usage: %s [--update] PORTAL-REPLAY RECORDINGS BUDGETS\n", g_get_prgname ());
+      return 1;
+    }
+
+  if (!update)
+    {
+      budgets = load_budgets (argv[3], &error);
+      if (budgets == NULL)
+        {
+          g_printerr ("Failed to load budgets: %s\n", error->message);
+          return 1;
+        }
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (scenarios); i++)
+    {
+      const char *name = scenarios[i].name;
+      Usage *budget;
+
+      if (!run_scenario (argv[1], argv[2], i, &usage[i], &error))
+        {
+          g_printerr ("%s: %s\n", name, error->message);
+          return 1;
+        }
+
+      g_print ("%s: %" G_GUINT64_FORMAT " allocations, %" G_GUINT64_FORMAT " bytes, %" G_GUINT64_FORMAT " kB growth\n",
+               name, usage[i].allocations, usage[i].bytes, usage[i].rss);
+
+      if (update)
+        continue;
+
+      if (!g_hash_table_lookup_extended (budgets, name, NULL, (gpointer *) &budget))
+        {
+          g_printerr ("%s: No budget\n", name);
+          failures++;
+        }
+      else if (budget == NULL)
+        {
+          g_printerr ("%s: Not measured yet\n", name);
+          unmeasured++;
+        }
+      else if (usage[i].allocations > budget->allocations ||
+               usage[i].bytes > budget->bytes ||
+               usage[i].rss > budget->rss)
+        {
+          g_printerr ("%s: Over budget of %" G_GUINT64_FORMAT " allocations, %" G_GUINT64_FORMAT " bytes, %" G_GUINT64_FORMAT " kB growth\n",
+                      name, budget->allocations, budget->bytes, budget->rss);
+          failures++;
+        }
+    }
+
+  if (update && !save_budgets (argv[3], usage, &error))
+    {
+      g_printerr ("Failed to save budgets: %s\n", error->message);
+      return 1;
+    }
+
+  if (failures > 0)
+    return 1;
+
+  if (unmeasured > 0)
+    {
+      g_printerr ("Run update-allocation-budgets to measure the remaining scenarios\n");
+      return EXIT_SKIP;
+    }
+
+  return 0;
+}
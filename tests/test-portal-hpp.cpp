@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Builds portal.hpp as C++20, and checks that co_await on a call
+ * resumes the coroutine with the result, or throws its error.
+ *
+ * Runs on a private bus. The Ping of xdp_portal_flush() fails while
+ * nobody owns the portal name, and GDBus answers it itself once the
+ * test owns the name.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+
+#include <gio/gio.h>
+
+#include "libportal/portal.hpp"
+
+#define PORTAL_BUS_NAME "org.freedesktop.portal.Desktop"
+
+namespace {
+
+/* A coroutine that runs until its first co_await right away */
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object () noexcept { return {}; }
+    std::suspend_never initial_suspend () noexcept { return {}; }
+    std::suspend_never final_suspend () noexcept { return {}; }
+    void return_void () noexcept {}
+    void unhandled_exception () noexcept { std::terminate (); }
+  };
+};
+
+struct Outcome
+{
+  bool done = false;
+  bool failed = false;
+  GQuark domain = 0;
+  int code = 0;
+};
+
+Task
+flush (XdpPortal *portal,
+       Outcome &outcome)
+{
+  try
+    {
+      co_await xdp::flush (portal, 5000);
+    }
+  catch (const xdp::Error &error)
+    {
+      outcome.failed = true;
+      outcome.domain = error.domain ();
+      outcome.code = error.code ();
+    }
+  outcome.done = true;
+}
+
+void
+wait_for (const Outcome &outcome)
+{
+  while (!outcome.done)
+    g_main_context_iteration (nullptr, TRUE);
+}
+
+} // namespace
+
+int
+main ()
+{
+  GError *error = nullptr;
+  GDBusConnection *bus;
+  GVariant *ret;
+  xdp::Portal portal = xdp::make_portal ();
+  Outcome missing;
+  Outcome owned;
+
+  flush (portal, missing);
+  wait_for (missing);
+  if (!missing.failed || missing.domain != G_DBUS_ERROR || missing.code != G_DBUS_ERROR_SERVICE_UNKNOWN)
+    {
+      fprintf (stderr, "Flushing without a portal did not throw the expected error\n");
+      return 1;
+    }
+
+  /* xdp_portal_new() uses the shared session bus connection as well */
+  bus = g_bus_get_sync (G_BUS_TYPE_SESSION, nullptr, &error);
+  if (bus == nullptr)
+    {
+      fprintf (stderr, "Failed to connect to the bus: %s\n", error->message);
+      return 1;
+    }
+
+  ret = g_dbus_connection_call_sync (bus,
+                                     "org.freedesktop.DBus",
+                                     "/org/freedesktop/DBus",
+                                     "org.freedesktop.DBus",
+                                     "RequestName",
+                                     g_variant_new ("(su)", PORTAL_BUS_NAME, 0),
+                                     G_VARIANT_TYPE ("(u)"),
+                                     G_DBUS_CALL_FLAGS_NONE,
+                                     -1,
+                                     nullptr,
+                                     &error);
+  if (ret == nullptr)
+    {
+      fprintf (stderr, "Failed to own %s: %s\n", PORTAL_BUS_NAME, error->message);
+      return 1;
+    }
+  g_variant_unref (ret);
+
+  flush (portal, owned);
+  wait_for (owned);
+  if (owned.failed)
+    {
+      fprintf (stderr, "Flushing failed\n");
+      return 1;
+    }
+
+  g_object_unref (bus);
+
+  return 0;
+}
@@ -0,0 +1,620 @@
+/*
+ * Copyright (C) 2018, Matthias Clasen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* portal-replay answers portal calls from a recording that libportal
+ * made with LIBPORTAL_RECORD, with the recorded replies, signals and
+ * timing. Run it on a private bus, e.g. with dbus-run-session, together
+ * with the application under test.
+ *
+ * Each call is matched with the next recorded call of the same method.
+ * With --repeat, the recorded calls of a method are used again from the
+ * first one once all of them have been used, so that a recording of one
+ * run can answer any number of runs. Request and session paths are
+ * translated from the recorded tokens to the live ones. File descriptors
+ * in replies are replaced with /dev/null.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#define PORTAL_BUS_NAME "org.freedesktop.portal.Desktop"
+#define REQUEST_PATH_PREFIX "/org/freedesktop/portal/desktop/request/"
+#define SESSION_PATH_PREFIX "/org/freedesktop/portal/desktop/session/"
+
+typedef struct {
+  gint64 time;
+  char *kind;
+  guint32 serial;
+  guint32 reply_serial;
+  char *path;
+  char *interface;
+  char *member;
+  char *error_name;
+  guint n_fds;
+  GVariant *body;
+  gboolean used;
+  int reply;
+  int owner;
+} Record;
+
+static GPtrArray *records;
+static char *recorded_sender;
+static GHashTable *path_map;
+static GDBusConnection *bus;
+static double speed = 1.0;
+static gboolean repeat = FALSE;
+
+static void
+record_free (Record *record)
+{
+  g_free (record->kind);
+  g_free (record->path);
+  g_free (record->interface);
+  g_free (record->member);
+  g_free (record->error_name);
+  g_variant_unref (record->body);
+  g_free (record);
+}
+
+static gboolean
+mentions (GVariant *value,
+          const char *path)
+{
+  if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING) ||
+      g_variant_is_of_type (value, G_VARIANT_TYPE_OBJECT_PATH))
+    return strcmp (g_variant_get_string (value, NULL), path) == 0;
+
+  if (g_variant_is_container (value))
+    {
+      gsize i;
+
+      for (i = 0; i < g_variant_n_children (value); i++)
+        {
+          g_autoptr(GVariant) child = g_variant_get_child_value (value, i);
+
+          if (mentions (child, path))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static const char *
+lookup_token (GVariant *body,
+              const char *name)
+{
+  gsize i;
+
+  for (i = 0; i < g_variant_n_children (body); i++)
+    {
+      g_autoptr(GVariant) child = g_variant_get_child_value (body, i);
+      const char *token;
+
+      if (g_variant_is_of_type (child, G_VARIANT_TYPE_VARDICT) &&
+          g_variant_lookup (child, name, "&s", &token))
+        return token;
+    }
+
+  return NULL;
+}
+
+/* Calls that expect no reply, which is how libportal makes requests,
+ * have no recorded return that mentions the request path, so the path
+ * is also derived from the token the call passed.
+ */
+static gboolean
+owns_path (Record *call,
+           Record *reply,
+           const char *path)
+{
+  const char *token;
+
+  if (mentions (call->body, path) ||
+      (reply && mentions (reply->body, path)))
+    return TRUE;
+
+  token = lookup_token (call->body, "handle_token");
+  if (token)
+    {
+      g_autofree char *request_path = NULL;
+
+      request_path = g_strconcat (REQUEST_PATH_PREFIX, recorded_sender, "/", token, NULL);
+      if (strcmp (request_path, path) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+load_recording (const char *filename,
+                GError **error)
+{
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  g_autoptr(GVariant) header = NULL;
+  g_autoptr(GHashTable) calls = NULL;
+  guint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, error))
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  header = g_variant_parse (G_VARIANT_TYPE_VARDICT, lines[0], NULL, NULL, error);
+  if (header == NULL)
+    return FALSE;
+
+  if (!g_variant_lookup (header, "sender", "s", &recorded_sender))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Recording has no sender");
+      return FALSE;
+    }
+
+  records = g_ptr_array_new_with_free_func ((GDestroyNotify) record_free);
+  calls = g_hash_table_new (NULL, NULL);
+
+  for (i = 1; lines[i] != NULL; i++)
+    {
+      g_autoptr(GVariant) line = NULL;
+      g_autoptr(GVariant) fds = NULL;
+      Record *record;
+      guint64 time;
+
+      if (lines[i][0] == '\0')
+        continue;
+
+      line = g_variant_parse (G_VARIANT_TYPE ("(tsuussssa(st)v)"), lines[i], NULL, NULL, error);
+      if (line == NULL)
+        {
+          g_prefix_error (error, "Line %u: ", i + 1);
+          return FALSE;
+        }
+
+      record = g_new0 (Record, 1);
+      g_variant_get (line, "(tsuussss@a(st)v)",
+                     &time,
+                     &record->kind,
+                     &record->serial,
+                     &record->reply_serial,
+                     &record->path,
+                     &record->interface,
+                     &record->member,
+                     &record->error_name,
+                     &fds,
+                     &record->body);
+      record->time = time;
+      record->n_fds = g_variant_n_children (fds);
+      record->reply = -1;
+      record->owner = -1;
+      g_ptr_array_add (records, record);
+
+      if (strcmp (record->kind, "call") == 0)
+        {
+          g_hash_table_insert (calls, GUINT_TO_POINTER (record->serial), GINT_TO_POINTER (records->len));
+        }
+      else if (strcmp (record->kind, "signal") == 0)
+        {
+          int j;
+
+          /* A signal belongs to the last call that mentions its object */
+          for (j = records->len - 2; j >= 0; j--)
+            {
+              Record *call = g_ptr_array_index (records, j);
+
+              if (strcmp (call->kind, "call") != 0)
+                continue;
+
+              if (owns_path (call,
+                             call->reply != -1 ? g_ptr_array_index (records, call->reply) : NULL,
+                             record->path))
+                {
+                  record->owner = j;
+                  break;
+                }
+            }
+        }
+      else
+        {
+          /* Indices are stored off by one, so that 0 means absent */
+          int call = GPOINTER_TO_INT (g_hash_table_lookup (calls, GUINT_TO_POINTER (record->reply_serial)));
+
+          if (call > 0)
+            ((Record *) g_ptr_array_index (records, call - 1))->reply = records->len - 1;
+        }
+    }
+
+  return TRUE;
+}
+
+static char *
+escape_sender (const char *sender)
+{
+  char *escaped;
+  int i;
+
+  escaped = g_strdup (sender + 1);
+  for (i = 0; escaped[i]; i++)
+    if (escaped[i] == '.')
+      escaped[i] = '_';
+
+  return escaped;
+}
+
+static void
+map_path (const char *prefix,
+          const char *name,
+          GVariant *recorded,
+          GVariant *live,
+          const char *live_sender)
+{
+  const char *old_token;
+  const char *new_token;
+
+  old_token = lookup_token (recorded, name);
+  new_token = lookup_token (live, name);
+  if (old_token == NULL || new_token == NULL)
+    return;
+
+  g_hash_table_insert (path_map,
+                       g_strconcat (prefix, recorded_sender, "/", old_token, NULL),
+                       g_strconcat (prefix, live_sender, "/", new_token, NULL));
+}
+
+static GVariant *
+rewrite_value (GVariant *value)
+{
+  if (g_variant_is_of_type (value, G_VARIANT_TYPE_STRING) ||
+      g_variant_is_of_type (value, G_VARIANT_TYPE_OBJECT_PATH))
+    {
+      const char *path = g_hash_table_lookup (path_map, g_variant_get_string (value, NULL));
+
+      if (path == NULL)
+        return g_variant_ref (value);
+
+      if (g_variant_is_of_type (value, G_VARIANT_TYPE_OBJECT_PATH))
+        return g_variant_ref_sink (g_variant_new_object_path (path));
+      else
+        return g_variant_ref_sink (g_variant_new_string (path));
+    }
+
+  if (g_variant_is_container (value))
+    {
+      GVariantBuilder builder;
+      gsize i;
+
+      g_variant_builder_init (&builder, g_variant_get_type (value));
+      for (i = 0; i < g_variant_n_children (value); i++)
+        {
+          g_autoptr(GVariant) child = g_variant_get_child_value (value, i);
+          g_autoptr(GVariant) rewritten = rewrite_value (child);
+
+          g_variant_builder_add_value (&builder, rewritten);
+        }
+
+      return g_variant_ref_sink (g_variant_builder_end (&builder));
+    }
+
+  return g_variant_ref (value);
+}
+
+static GUnixFDList *
+dummy_fds (guint n_fds)
+{
+  GUnixFDList *fd_list;
+  guint i;
+
+  if (n_fds == 0)
+    return NULL;
+
+  fd_list = g_unix_fd_list_new ();
+  for (i = 0; i < n_fds; i++)
+    {
+      int fd = open ("/dev/null", O_RDWR | O_CLOEXEC);
+
+      g_unix_fd_list_append (fd_list, fd, NULL);
+      close (fd);
+    }
+
+  return fd_list;
+}
+
+static guint
+delay_ms (Record *from,
+          Record *to)
+{
+  return (guint) (MAX (to->time - from->time, 0) / 1000 / speed);
+}
+
+typedef struct {
+  GDBusMessage *call;
+  Record *record;
+} Pending;
+
+static gboolean
+send_reply (gpointer data)
+{
+  Pending *pending = data;
+  g_autoptr(GDBusMessage) reply = NULL;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  g_autoptr(GVariant) body = NULL;
+
+  if (strcmp (pending->record->kind, "error") == 0)
+    {
+      const char *message = "";
+
+      if (g_variant_is_of_type (pending->record->body, G_VARIANT_TYPE ("(s)")))
+        g_variant_get (pending->record->body, "(&s)", &message);
+
+      reply = g_dbus_message_new_method_error_literal (pending->call,
+                                                       pending->record->error_name,
+                                                       message);
+    }
+  else
+    {
+      body = rewrite_value (pending->record->body);
+      reply = g_dbus_message_new_method_reply (pending->call);
+      g_dbus_message_set_body (reply, body);
+
+      fd_list = dummy_fds (pending->record->n_fds);
+      if (fd_list)
+        g_dbus_message_set_unix_fd_list (reply, fd_list);
+    }
+
+  g_dbus_connection_send_message (bus, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+
+  g_object_unref (pending->call);
+  g_free (pending);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+send_signal (gpointer data)
+{
+  Pending *pending = data;
+  g_autoptr(GDBusMessage) signal = NULL;
+  g_autoptr(GUnixFDList) fd_list = NULL;
+  g_autoptr(GVariant) body = NULL;
+  const char *path;
+
+  path = g_hash_table_lookup (path_map, pending->record->path);
+  if (path == NULL)
+    path = pending->record->path;
+
+  signal = g_dbus_message_new_signal (path, pending->record->interface, pending->record->member);
+  g_dbus_message_set_destination (signal, g_dbus_message_get_sender (pending->call));
+
+  body = rewrite_value (pending->record->body);
+  g_dbus_message_set_body (signal, body);
+
+  fd_list = dummy_fds (pending->record->n_fds);
+  if (fd_list)
+    g_dbus_message_set_unix_fd_list (signal, fd_list);
+
+  g_dbus_connection_send_message (bus, signal, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+
+  g_object_unref (pending->call);
+  g_free (pending);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule (GSourceFunc func,
+          guint delay,
+          GDBusMessage *call,
+          Record *record)
+{
+  Pending *pending;
+
+  pending = g_new0 (Pending, 1);
+  pending->call = g_object_ref (call);
+  pending->record = record;
+
+  g_timeout_add (delay, func, pending);
+}
+
+static gboolean
+is_call_of (Record *record,
+            const char *interface,
+            const char *member)
+{
+  return strcmp (record->kind, "call") == 0 &&
+         g_strcmp0 (record->interface, interface) == 0 &&
+         g_strcmp0 (record->member, member) == 0;
+}
+
+static int
+find_call (const char *interface,
+           const char *member)
+{
+  guint i;
+
+  for (i = 0; i < records->len; i++)
+    {
+      Record *record = g_ptr_array_index (records, i);
+
+      if (!record->used && is_call_of (record, interface, member))
+        return i;
+    }
+
+  return -1;
+}
+
+static gboolean
+handle_call (gpointer data)
+{
+  g_autoptr(GDBusMessage) message = data;
+  g_autofree char *live_sender = NULL;
+  const char *interface;
+  const char *member;
+  GVariant *body;
+  Record *call;
+  int call_index;
+  guint i;
+
+  interface = g_dbus_message_get_interface (message);
+  member = g_dbus_message_get_member (message);
+  body = g_dbus_message_get_body (message);
+
+  call_index = find_call (interface, member);
+  if (call_index == -1 && repeat)
+    {
+      for (i = 0; i < records->len; i++)
+        {
+          Record *record = g_ptr_array_index (records, i);
+
+          if (is_call_of (record, interface, member))
+            record->used = FALSE;
+        }
+
+      call_index = find_call (interface, member);
+    }
+
+  if (call_index == -1)
+    {
+      g_autoptr(GDBusMessage) reply = NULL;
+
+      if (g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED)
+        return G_SOURCE_REMOVE;
+
+      g_message ("No recorded call for %s.%s", interface, member);
+      reply = g_dbus_message_new_method_error (message,
+                                               "org.freedesktop.DBus.Error.Failed",
+                                               "No recorded call for %s.%s",
+                                               interface, member);
+      g_dbus_connection_send_message (bus, reply, G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+      return G_SOURCE_REMOVE;
+    }
+
+  call = g_ptr_array_index (records, call_index);
+  call->used = TRUE;
+
+  live_sender = escape_sender (g_dbus_message_get_sender (message));
+  if (body)
+    {
+      map_path (REQUEST_PATH_PREFIX, "handle_token", call->body, body, live_sender);
+      map_path (SESSION_PATH_PREFIX, "session_handle_token", call->body, body, live_sender);
+    }
+
+  if (call->reply != -1)
+    {
+      Record *reply = g_ptr_array_index (records, call->reply);
+      schedule (send_reply, delay_ms (call, reply), message, reply);
+    }
+
+  for (i = call_index + 1; i < records->len; i++)
+    {
+      Record *record = g_ptr_array_index (records, i);
+
+      if (record->owner == call_index)
+        schedule (send_signal, delay_ms (call, record), message, record);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Runs in the GDBus worker thread */
+static GDBusMessage *
+call_filter (GDBusConnection *connection,
+             GDBusMessage *message,
+             gboolean incoming,
+             gpointer data)
+{
+  if (!incoming ||
+      g_dbus_message_get_message_type (message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL ||
+      g_strcmp0 (g_dbus_message_get_destination (message), PORTAL_BUS_NAME) != 0)
+    return message;
+
+  g_main_context_invoke (NULL, handle_call, message);
+
+  return NULL;
+}
+
+static void
+name_lost (GDBusConnection *connection,
+           const char *name,
+           gpointer data)
+{
+  g_printerr ("Could not own %s\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  g_autoptr(GError) error = NULL;
+  GOptionEntry entries[] = {
+    { "speed", 0, 0, G_OPTION_ARG_DOUBLE, &speed, "Replay faster or slower by this factor", "FACTOR" },
+    { "repeat", 0, 0, G_OPTION_ARG_NONE, &repeat, "Start over with the first recorded call of a method once all are used", NULL },
+    { NULL }
+  };
+
+  context = g_option_context_new ("RECORDING - replay recorded portal traffic");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  if (argc != 2 || speed <= 0)
+    {
+      g_printerr ("Usage: %s [--speed=FACTOR] [--repeat] RECORDING\n", g_get_prgname ());
+      return 1;
+    }
+
+  if (!load_recording (argv[1], &error))
+    {
+      g_printerr ("Failed to load %s: %s\n", argv[1], error->message);
+      return 1;
+    }
+
+  path_map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  bus = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  if (bus == NULL)
+    {
+      g_printerr ("Failed to connect to the session bus: %s\n", error->message);
+      return 1;
+    }
+
+  g_dbus_connection_add_filter (bus, call_filter, NULL, NULL);
+  g_bus_own_name_on_connection (bus,
+                                PORTAL_BUS_NAME,
+                                G_BUS_NAME_OWNER_FLAGS_NONE,
+                                NULL,
+                                name_lost,
+                                NULL,
+                                NULL);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_main_loop_run (loop);
+
+  return 0;
+}